@@ -0,0 +1,176 @@
+#include <cstdlib>
+#include <cstdint>
+#include <mutex>
+#include "arena.h"
+
+// every allocation is prefixed by a header saying where it came from, so that
+// arena_free() can tell arena memory from heap memory; 16 bytes keeps the
+// returned memory 16-byte aligned
+#define ALLOC_HEADER 16
+#define ALLOC_ALIGN 16
+#define TAG_HEAP 0x68656170u
+#define TAG_ARENA 0x6172656eu
+
+bool Arena::enabled = false;
+
+// registry of every thread's Arena, for Arena::ResetAll()
+static std::mutex registry_lock;
+static std::vector<Arena*> registry;
+static thread_local Arena* local = nullptr;
+static thread_local bool bypass = false;
+
+Arena::Arena(size_t chunk_size)
+{
+	this->chunk_size = chunk_size;
+	offset = chunk_size;
+}
+
+Arena::~Arena()
+{
+	Reset();
+}
+
+void* Arena::Allocate(size_t size)
+{
+	size = (size + ALLOC_ALIGN - 1) & ~((size_t)ALLOC_ALIGN - 1);
+
+	// allocations that don't fit in a chunk get a chunk of their own, placed
+	// before the current one so that it keeps being bumped
+	if (size > chunk_size)
+	{
+		char* big = (char*)malloc(size);
+		if (chunks.empty())
+		{
+			chunks.push_back(big);
+			offset = chunk_size;
+		}
+		else
+		{
+			chunks.insert(chunks.end() - 1, big);
+		}
+		return big;
+	}
+
+	if (offset + size > chunk_size)
+	{
+		chunks.push_back((char*)malloc(chunk_size));
+		offset = 0;
+	}
+
+	void* mem = chunks.back() + offset;
+	offset += size;
+	return mem;
+}
+
+void Arena::Reset()
+{
+	for (char* chunk : chunks)
+	{
+		free(chunk);
+	}
+	chunks.clear();
+	offset = chunk_size;
+}
+
+// [ASSUME] oversized allocations are rare enough that counting them as a
+// chunk each is close enough
+size_t Arena::Capacity()
+{
+	return chunks.size() * chunk_size;
+}
+
+Arena* Arena::Local()
+{
+	if (!local)
+	{
+		local = new Arena();
+		std::lock_guard<std::mutex> guard(registry_lock);
+		registry.push_back(local);
+	}
+	return local;
+}
+
+void Arena::ResetAll()
+{
+	std::lock_guard<std::mutex> guard(registry_lock);
+	for (Arena* arena : registry)
+	{
+		arena->Reset();
+	}
+}
+
+size_t Arena::CapacityAll()
+{
+	std::lock_guard<std::mutex> guard(registry_lock);
+	size_t total = 0;
+	for (Arena* arena : registry)
+	{
+		total += arena->Capacity();
+	}
+	return total;
+}
+
+ArenaBypass::ArenaBypass()
+{
+	bypassed = bypass;
+	bypass = true;
+}
+
+ArenaBypass::~ArenaBypass()
+{
+	bypass = bypassed;
+}
+
+void* arena_alloc(size_t size)
+{
+	char* mem;
+	uint32_t tag;
+	if (Arena::enabled && !bypass)
+	{
+		mem = (char*)Arena::Local()->Allocate(size + ALLOC_HEADER);
+		tag = TAG_ARENA;
+	}
+	else
+	{
+		mem = (char*)malloc(size + ALLOC_HEADER);
+		tag = TAG_HEAP;
+	}
+
+	if (!mem)
+	{
+		throw std::bad_alloc();
+	}
+
+	*(uint32_t*)mem = tag;
+	return mem + ALLOC_HEADER;
+}
+
+void arena_free(void* mem)
+{
+	if (!mem)
+	{
+		return;
+	}
+
+	char* base = (char*)mem - ALLOC_HEADER;
+	if (*(uint32_t*)base == TAG_HEAP)
+	{
+		free(base);
+	}
+	// arena memory is released all at once by Arena::Reset()
+}
+
+#ifdef B2_USER_SETTINGS
+#include "box2d/box2d.h"
+
+// Box2D allocation hooks declared in b2_user_settings.h
+void* b2Alloc(int32 size)
+{
+	return arena_alloc(size);
+}
+
+void b2Free(void* mem)
+{
+	arena_free(mem);
+}
+#endif
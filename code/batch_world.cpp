@@ -0,0 +1,903 @@
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include "box2d/box2d.h"
+#include "walker.h"
+#include "batch_world.h"
+#include "termination.h"
+#include "config.h"
+
+// Box2D's tuning constants (see b2_common.h), so that a BatchWorld settles
+// the way a b2World does
+#define LINEAR_SLOP 0.005f
+#define ANGULAR_SLOP (2.0f / 180.0f * b2_pi)
+#define POLYGON_RADIUS (2.0f * LINEAR_SLOP)
+#define BAUMGARTE 0.2f
+#define MAX_LINEAR_CORRECTION 0.2f
+#define MAX_ANGULAR_CORRECTION (8.0f / 180.0f * b2_pi)
+#define MAX_TRANSLATION 2.0f
+#define MAX_ROTATION (0.5f * b2_pi)
+#define TIME_TO_SLEEP 0.5f
+#define LINEAR_SLEEP_TOLERANCE 0.01f
+#define ANGULAR_SLEEP_TOLERANCE (2.0f / 180.0f * b2_pi)
+
+// b2FixtureDef's default, which the ground keeps
+#define GROUND_FRICTION 0.2f
+
+#define N_BODIES (1 + N_LEG_PARAMS)
+#define N_CORNERS 4
+#define N_CONTACTS (N_BODIES * N_CORNERS)
+
+// the rows of a BatchWorld, each holding one float per lane
+enum
+{
+	// bodies (head, then legs): position (of the center), angle, its sine and
+	// cosine, velocities, time spent slow enough to sleep
+	ROW_X = 0,
+	ROW_Y = ROW_X + N_BODIES,
+	ROW_A = ROW_Y + N_BODIES,
+	ROW_SIN = ROW_A + N_BODIES,
+	ROW_COS = ROW_SIN + N_BODIES,
+	ROW_VX = ROW_COS + N_BODIES,
+	ROW_VY = ROW_VX + N_BODIES,
+	ROW_W = ROW_VY + N_BODIES,
+	ROW_SLEEP = ROW_W + N_BODIES,
+
+	// joints: motor speed, angle and anchors (relative to the bodies' centers)
+	// at the start of the step, accumulated impulses
+	ROW_SPEED = ROW_SLEEP + N_BODIES,
+	ROW_ANGLE = ROW_SPEED + N_LEG_PARAMS,
+	ROW_RAX = ROW_ANGLE + N_LEG_PARAMS,
+	ROW_RAY = ROW_RAX + N_LEG_PARAMS,
+	ROW_RBX = ROW_RAY + N_LEG_PARAMS,
+	ROW_RBY = ROW_RBX + N_LEG_PARAMS,
+	ROW_JX = ROW_RBY + N_LEG_PARAMS,
+	ROW_JY = ROW_JX + N_LEG_PARAMS,
+	ROW_MOTOR = ROW_JY + N_LEG_PARAMS,
+	ROW_LOWER = ROW_MOTOR + N_LEG_PARAMS,
+	ROW_UPPER = ROW_LOWER + N_LEG_PARAMS,
+
+	// ground contacts, one per body corner: 1 if touching this step, contact
+	// point (relative to the body's center), effective masses, accumulated
+	// impulses
+	ROW_TOUCH = ROW_UPPER + N_LEG_PARAMS,
+	ROW_RX = ROW_TOUCH + N_CONTACTS,
+	ROW_RY = ROW_RX + N_CONTACTS,
+	ROW_NMASS = ROW_RY + N_CONTACTS,
+	ROW_TMASS = ROW_NMASS + N_CONTACTS,
+	ROW_NORMAL = ROW_TMASS + N_CONTACTS,
+	ROW_TANGENT = ROW_NORMAL + N_CONTACTS,
+
+	// lanes, as 0 or 1: a Walker that isn't terminated, awake, both (so
+	// stepped), still correcting positions, positions corrected this step,
+	// head touched the ground; and the stall predicate's state
+	ROW_ACTIVE = ROW_TANGENT + N_CONTACTS,
+	ROW_AWAKE,
+	ROW_LIVE,
+	ROW_SOLVING,
+	ROW_SOLVED,
+	ROW_CONTACT,
+	ROW_STALL_X,
+	ROW_STALL_STEPS,
+
+	// scratch: smallest contact separation and largest joint error (squared,
+	// relative to the slops) of a position iteration, shortest time slow enough to
+	// sleep
+	ROW_SEPARATION,
+	ROW_JOINT_ERROR,
+	ROW_MIN_SLEEP,
+
+	N_ROWS
+};
+
+bool parse_backend(const std::string& name, PhysicsBackend& backend)
+{
+	if (name == "box2d") backend = BACKEND_BOX2D;
+	else if (name == "batch") backend = BACKEND_BATCH;
+	else return false;
+	return true;
+}
+
+const char* backend_name(PhysicsBackend backend)
+{
+	return backend == BACKEND_BATCH ? "batch" : "box2d";
+}
+
+// sine and cosine in a form that vectorizes, which libm's don't (short of
+// -ffast-math): Cody-Waite reduction to [-pi/4, pi/4] and Cephes' sinf/cosf
+// polynomials, good to a couple of ulp for the angles Walkers reach
+static inline void rotation(float a, float& s, float& c)
+{
+	float k = a * (2.0f / b2_pi);
+	int q = (int)(k + (k >= 0.0f ? 0.5f : -0.5f));
+	float r = a - q * 1.5703125f;
+	r -= q * 4.837512969970703125e-4f;
+	r -= q * 7.54978995489188216e-8f;
+
+	float r2 = r * r;
+	float sr = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f
+				+ r2 * -1.9515295891e-4f));
+	float cr = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f
+				+ r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+	// rotate by the quadrant
+	int quadrant = q & 3;
+	s = quadrant == 0 ? sr : quadrant == 1 ? cr : quadrant == 2 ? -sr : -cr;
+	c = quadrant == 0 ? cr : quadrant == 1 ? -sr : quadrant == 2 ? -cr : sr;
+}
+
+BatchWorld::BatchWorld(Walker* const* lanes, int count)
+{
+	n = (count + BATCH_WIDTH - 1) / BATCH_WIDTH * BATCH_WIDTH;
+	block.assign(N_ROWS * n + BATCH_WIDTH, 0.0f);
+	uintptr_t align = BATCH_WIDTH * sizeof(float);
+	rows = (float*)(((uintptr_t)block.data() + align - 1) / align * align);
+	walkers.assign(n, nullptr);
+
+	// [ASSUME] WalkerParameters are the same for every Walker in a run, as
+	// WalkerPool assumes
+	Bodies(count > 0 ? lanes[0] : nullptr);
+
+	for (int l = 0; l < count; l++)
+	{
+		if (!lanes[l]->adopted) Load(l, lanes[l]);
+	}
+}
+
+// masses and joint geometry, as Walker::Build() makes them
+void BatchWorld::Bodies(Walker* w)
+{
+	WalkerParameters wp = w ? w->params : defaultParameters;
+	b2Vec2 size[N_BODIES] = { wp.head_size,
+								wp.upper_leg_size, wp.upper_leg_size,
+								wp.lower_leg_size, wp.lower_leg_size };
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		float x = size[b].x, y = size[b].y;
+		float mass = wp.mass_density * x * y;
+		inv_mass[b] = 1.0f / mass;
+		inv_inertia[b] = 12.0f / (mass * (x * x + y * y));
+		half_x[b] = x / 2;
+		half_y[b] = y / 2;
+	}
+
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		body_b[j] = 1 + j;
+		if (is_upper_leg(j))
+		{
+			body_a[j] = 0;
+			anchor_ax[j] = ((j % 2) * wp.head_size.x / 2) - wp.head_size.x / 4;
+			anchor_ay[j] = -wp.head_size.y / 2;
+			anchor_by[j] = wp.upper_leg_size.y / 2;
+		}
+		else
+		{
+			body_a[j] = 1 + (j - 2);
+			anchor_ax[j] = 0.0f;
+			anchor_ay[j] = -wp.upper_leg_size.y / 2;
+			anchor_by[j] = wp.lower_leg_size.y / 2;
+		}
+		anchor_bx[j] = 0.0f;
+		axial_mass[j] = 1.0f / (inv_inertia[body_a[j]] +
+								inv_inertia[body_b[j]]);
+	}
+
+	max_torque = wp.max_torque;
+
+	// b2MixFriction()
+	friction = std::sqrt(config.friction * GROUND_FRICTION);
+}
+
+// take a Walker's state from its bodies, relative to its lane's origin
+void BatchWorld::Load(int lane, Walker* w)
+{
+	walkers[lane] = w;
+	WalkerSnapshot snap(w);
+	const BodySnapshot* bodies[N_BODIES] = { &snap.head, &snap.legs[0],
+												&snap.legs[1], &snap.legs[2],
+												&snap.legs[3] };
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		Row(ROW_X + b)[lane] = bodies[b]->position.x;
+		Row(ROW_Y + b)[lane] = bodies[b]->position.y;
+		Row(ROW_A + b)[lane] = bodies[b]->angle;
+		Row(ROW_VX + b)[lane] = bodies[b]->linearVelocity.x;
+		Row(ROW_VY + b)[lane] = bodies[b]->linearVelocity.y;
+		Row(ROW_W + b)[lane] = bodies[b]->angularVelocity;
+	}
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		Row(ROW_SPEED + j)[lane] = snap.mspeeds[j];
+	}
+	max_torque = snap.max_torque;
+
+	Row(ROW_ACTIVE)[lane] = 1.0f;
+	Row(ROW_AWAKE)[lane] = snap.awake ? 1.0f : 0.0f;
+	Row(ROW_CONTACT)[lane] = w->head_contact ? 1.0f : 0.0f;
+	Row(ROW_STALL_X)[lane] = w->stall_x - w->origin.x;
+	Row(ROW_STALL_STEPS)[lane] = w->stall_steps;
+}
+
+// put a lane's state back into its Walker's bodies and record it
+void BatchWorld::Store(int lane)
+{
+	Walker* w = walkers[lane];
+	WalkerSnapshot snap(w);
+	BodySnapshot* bodies[N_BODIES] = { &snap.head, &snap.legs[0],
+										&snap.legs[1], &snap.legs[2],
+										&snap.legs[3] };
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		bodies[b]->position.Set(Row(ROW_X + b)[lane], Row(ROW_Y + b)[lane]);
+		bodies[b]->angle = Row(ROW_A + b)[lane];
+		bodies[b]->linearVelocity.Set(Row(ROW_VX + b)[lane],
+										Row(ROW_VY + b)[lane]);
+		bodies[b]->angularVelocity = Row(ROW_W + b)[lane];
+	}
+	snap.awake = Row(ROW_AWAKE)[lane] != 0.0f;
+	snap.Restore(w);
+
+	w->head_contact = Row(ROW_CONTACT)[lane] != 0.0f;
+	w->stall_x = Row(ROW_STALL_X)[lane] + w->origin.x;
+	w->stall_steps = (int)Row(ROW_STALL_STEPS)[lane];
+	if (Row(ROW_ACTIVE)[lane] == 0.0f)
+	{
+		w->Terminate();
+	}
+	w->Record();
+}
+
+// the lanes to step: active and awake; returns how many there are
+int BatchWorld::Live()
+{
+	const float* active = Row(ROW_ACTIVE);
+	const float* awake = Row(ROW_AWAKE);
+	float* live = Row(ROW_LIVE);
+	int count = 0;
+#pragma omp simd reduction(+:count)
+	for (int l = 0; l < n; l++)
+	{
+		live[l] = active[l] * awake[l];
+		count += live[l] != 0.0f;
+	}
+	return count;
+}
+
+// find the box corners within the contact skin of the ground and prepare
+// their constraints (b2CollidePolygons() and
+// b2ContactSolver::InitializeVelocityConstraints()); a corner that just
+// started touching starts from no impulse, others keep theirs
+void BatchWorld::Collide()
+{
+	const float* live = Row(ROW_LIVE);
+	float* head_contact = Row(ROW_CONTACT);
+
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		const float* y = Row(ROW_Y + b);
+		const float* a = Row(ROW_A + b);
+		float* sin = Row(ROW_SIN + b);
+		float* cos = Row(ROW_COS + b);
+		float im = inv_mass[b], ii = inv_inertia[b];
+
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			rotation(a[l], sin[l], cos[l]);
+		}
+
+		for (int k = 0; k < N_CORNERS; k++)
+		{
+			int c = b * N_CORNERS + k;
+			float lx = (k & 1) ? half_x[b] : -half_x[b];
+			float ly = (k & 2) ? half_y[b] : -half_y[b];
+			float* touch = Row(ROW_TOUCH + c);
+			float* rx = Row(ROW_RX + c);
+			float* ry = Row(ROW_RY + c);
+			float* nmass = Row(ROW_NMASS + c);
+			float* tmass = Row(ROW_TMASS + c);
+			float* normal = Row(ROW_NORMAL + c);
+			float* tangent = Row(ROW_TANGENT + c);
+
+#pragma omp simd
+			for (int l = 0; l < n; l++)
+			{
+				// the contact point is halfway between the corner and the
+				// ground
+				float cx = cos[l] * lx - sin[l] * ly;
+				float cy = sin[l] * lx + cos[l] * ly;
+				float gap = y[l] + cy - GROUND_Y;
+				float t = (gap <= 2.0f * POLYGON_RADIUS ? 1.0f : 0.0f) * live[l];
+
+				rx[l] = cx;
+				ry[l] = cy - gap / 2;
+				nmass[l] = 1.0f / (im + ii * rx[l] * rx[l]);
+				tmass[l] = 1.0f / (im + ii * ry[l] * ry[l]);
+				normal[l] = touch[l] * t * normal[l];
+				tangent[l] = touch[l] * t * tangent[l];
+				touch[l] = t;
+				if (b == 0) head_contact[l] = t > head_contact[l] ?
+												t : head_contact[l];
+			}
+		}
+	}
+}
+
+void BatchWorld::IntegrateVelocities(float dt)
+{
+	const float* live = Row(ROW_LIVE);
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		float* vy = Row(ROW_VY + b);
+		float dv = dt * config.gravity;
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			vy[l] += live[l] * dv;
+		}
+	}
+}
+
+// apply the previous step's impulses: the contacts', then the joints', whose
+// anchors and angles are taken here (b2ContactSolver::WarmStart() and
+// b2RevoluteJoint::InitVelocityConstraints())
+void BatchWorld::WarmStart()
+{
+	const float* live = Row(ROW_LIVE);
+
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		float* vx = Row(ROW_VX + b);
+		float* vy = Row(ROW_VY + b);
+		float* w = Row(ROW_W + b);
+		float im = inv_mass[b], ii = inv_inertia[b];
+		for (int k = 0; k < N_CORNERS; k++)
+		{
+			int c = b * N_CORNERS + k;
+			const float* rx = Row(ROW_RX + c);
+			const float* ry = Row(ROW_RY + c);
+			const float* normal = Row(ROW_NORMAL + c);
+			const float* tangent = Row(ROW_TANGENT + c);
+#pragma omp simd
+			for (int l = 0; l < n; l++)
+			{
+				vx[l] += im * tangent[l];
+				vy[l] += im * normal[l];
+				w[l] += ii * (rx[l] * normal[l] - ry[l] * tangent[l]);
+			}
+		}
+	}
+
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		int A = body_a[j], B = body_b[j];
+		const float* sa = Row(ROW_SIN + A);
+		const float* ca = Row(ROW_COS + A);
+		const float* sb = Row(ROW_SIN + B);
+		const float* cb = Row(ROW_COS + B);
+		const float* aa = Row(ROW_A + A);
+		const float* ab = Row(ROW_A + B);
+		float* vxa = Row(ROW_VX + A);
+		float* vya = Row(ROW_VY + A);
+		float* wa = Row(ROW_W + A);
+		float* vxb = Row(ROW_VX + B);
+		float* vyb = Row(ROW_VY + B);
+		float* wb = Row(ROW_W + B);
+		float* angle = Row(ROW_ANGLE + j);
+		float* rax = Row(ROW_RAX + j);
+		float* ray = Row(ROW_RAY + j);
+		float* rbx = Row(ROW_RBX + j);
+		float* rby = Row(ROW_RBY + j);
+		const float* px = Row(ROW_JX + j);
+		const float* py = Row(ROW_JY + j);
+		const float* motor = Row(ROW_MOTOR + j);
+		const float* lower = Row(ROW_LOWER + j);
+		const float* upper = Row(ROW_UPPER + j);
+		float ima = inv_mass[A], iia = inv_inertia[A];
+		float imb = inv_mass[B], iib = inv_inertia[B];
+		float lax = anchor_ax[j], lay = anchor_ay[j];
+		float lbx = anchor_bx[j], lby = anchor_by[j];
+
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			rax[l] = ca[l] * lax - sa[l] * lay;
+			ray[l] = sa[l] * lax + ca[l] * lay;
+			rbx[l] = cb[l] * lbx - sb[l] * lby;
+			rby[l] = sb[l] * lbx + cb[l] * lby;
+			angle[l] = ab[l] - aa[l];
+
+			float x = live[l] * px[l], y = live[l] * py[l];
+			float axial = live[l] * (motor[l] + lower[l] - upper[l]);
+			vxa[l] -= ima * x;
+			vya[l] -= ima * y;
+			wa[l] -= iia * (rax[l] * y - ray[l] * x + axial);
+			vxb[l] += imb * x;
+			vyb[l] += imb * y;
+			wb[l] += iib * (rbx[l] * y - rby[l] * x + axial);
+		}
+	}
+}
+
+// one velocity iteration: every joint (b2RevoluteJoint::
+// SolveVelocityConstraints()), then every contact, friction first
+// (b2ContactSolver::SolveVelocityConstraints())
+void BatchWorld::SolveVelocities(float inv_dt, float max_impulse)
+{
+	const float* live = Row(ROW_LIVE);
+	float lower_angle = MIN_JOINT_ANGLE, upper_angle = MAX_JOINT_ANGLE;
+
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		int A = body_a[j], B = body_b[j];
+		float* vxa = Row(ROW_VX + A);
+		float* vya = Row(ROW_VY + A);
+		float* wa = Row(ROW_W + A);
+		float* vxb = Row(ROW_VX + B);
+		float* vyb = Row(ROW_VY + B);
+		float* wb = Row(ROW_W + B);
+		const float* speed = Row(ROW_SPEED + j);
+		const float* angle = Row(ROW_ANGLE + j);
+		const float* rax = Row(ROW_RAX + j);
+		const float* ray = Row(ROW_RAY + j);
+		const float* rbx = Row(ROW_RBX + j);
+		const float* rby = Row(ROW_RBY + j);
+		float* px = Row(ROW_JX + j);
+		float* py = Row(ROW_JY + j);
+		float* motor = Row(ROW_MOTOR + j);
+		float* lower = Row(ROW_LOWER + j);
+		float* upper = Row(ROW_UPPER + j);
+		float ima = inv_mass[A], iia = inv_inertia[A];
+		float imb = inv_mass[B], iib = inv_inertia[B];
+		float axial_m = axial_mass[j];
+
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			float m = live[l];
+
+			// motor
+			float cdot = wb[l] - wa[l] - speed[l];
+			float old = motor[l];
+			float total = old - axial_m * cdot;
+			total = total < -max_impulse ? -max_impulse :
+					total > max_impulse ? max_impulse : total;
+			float impulse = m * (total - old);
+			motor[l] = old + impulse;
+			wa[l] -= iia * impulse;
+			wb[l] += iib * impulse;
+
+			// lower limit
+			float c = angle[l] - lower_angle;
+			cdot = wb[l] - wa[l];
+			old = lower[l];
+			total = old - axial_m * (cdot + (c > 0.0f ? c : 0.0f) * inv_dt);
+			total = total > 0.0f ? total : 0.0f;
+			impulse = m * (total - old);
+			lower[l] = old + impulse;
+			wa[l] -= iia * impulse;
+			wb[l] += iib * impulse;
+
+			// upper limit
+			c = upper_angle - angle[l];
+			cdot = wa[l] - wb[l];
+			old = upper[l];
+			total = old - axial_m * (cdot + (c > 0.0f ? c : 0.0f) * inv_dt);
+			total = total > 0.0f ? total : 0.0f;
+			impulse = m * (total - old);
+			upper[l] = old + impulse;
+			wa[l] += iia * impulse;
+			wb[l] -= iib * impulse;
+
+			// anchors; every body has mass, so K is never singular
+			float cx = vxb[l] - wb[l] * rby[l] - vxa[l] + wa[l] * ray[l];
+			float cy = vyb[l] + wb[l] * rbx[l] - vya[l] - wa[l] * rax[l];
+			float k11 = ima + imb + ray[l] * ray[l] * iia + rby[l] * rby[l] * iib;
+			float k12 = -ray[l] * rax[l] * iia - rby[l] * rbx[l] * iib;
+			float k22 = ima + imb + rax[l] * rax[l] * iia + rbx[l] * rbx[l] * iib;
+			float det = 1.0f / (k11 * k22 - k12 * k12);
+			float x = m * det * (k22 * -cx - k12 * -cy);
+			float y = m * det * (k11 * -cy - k12 * -cx);
+			px[l] += x;
+			py[l] += y;
+			vxa[l] -= ima * x;
+			vya[l] -= ima * y;
+			wa[l] -= iia * (rax[l] * y - ray[l] * x);
+			vxb[l] += imb * x;
+			vyb[l] += imb * y;
+			wb[l] += iib * (rbx[l] * y - rby[l] * x);
+		}
+	}
+
+	// the ground's normal is +y and its tangent +x; corners that aren't
+	// touching have touch = 0 and no impulse
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		float* vx = Row(ROW_VX + b);
+		float* vy = Row(ROW_VY + b);
+		float* w = Row(ROW_W + b);
+		float im = inv_mass[b], ii = inv_inertia[b];
+
+		for (int k = 0; k < N_CORNERS; k++)
+		{
+			int c = b * N_CORNERS + k;
+			const float* touch = Row(ROW_TOUCH + c);
+			const float* ry = Row(ROW_RY + c);
+			const float* tmass = Row(ROW_TMASS + c);
+			float* normal = Row(ROW_NORMAL + c);
+			float* tangent = Row(ROW_TANGENT + c);
+
+#pragma omp simd
+			for (int l = 0; l < n; l++)
+			{
+				float vt = vx[l] - w[l] * ry[l];
+				float limit = friction * normal[l];
+				float total = tangent[l] - tmass[l] * vt;
+				total = total < -limit ? -limit :
+						total > limit ? limit : total;
+				float impulse = touch[l] * (total - tangent[l]);
+				tangent[l] += impulse;
+				vx[l] += im * impulse;
+				w[l] -= ii * ry[l] * impulse;
+			}
+		}
+
+		for (int k = 0; k < N_CORNERS; k++)
+		{
+			int c = b * N_CORNERS + k;
+			const float* touch = Row(ROW_TOUCH + c);
+			const float* rx = Row(ROW_RX + c);
+			const float* nmass = Row(ROW_NMASS + c);
+			float* normal = Row(ROW_NORMAL + c);
+
+#pragma omp simd
+			for (int l = 0; l < n; l++)
+			{
+				float vn = vy[l] + w[l] * rx[l];
+				float total = normal[l] - nmass[l] * vn;
+				total = total > 0.0f ? total : 0.0f;
+				float impulse = touch[l] * (total - normal[l]);
+				normal[l] += impulse;
+				vy[l] += im * impulse;
+				w[l] += ii * rx[l] * impulse;
+			}
+		}
+	}
+}
+
+// move the bodies, no further than Box2D lets them in one step
+void BatchWorld::IntegratePositions(float dt)
+{
+	const float* live = Row(ROW_LIVE);
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		float* x = Row(ROW_X + b);
+		float* y = Row(ROW_Y + b);
+		float* a = Row(ROW_A + b);
+		float* vx = Row(ROW_VX + b);
+		float* vy = Row(ROW_VY + b);
+		float* w = Row(ROW_W + b);
+
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			float h = live[l] * dt;
+			float tx = h * vx[l], ty = h * vy[l];
+			float t = std::sqrt(tx * tx + ty * ty);
+			// (a division by zero only gives an infinity, clamped away)
+			float ratio = MAX_TRANSLATION / t;
+			ratio = ratio < 1.0f ? ratio : 1.0f;
+			vx[l] *= ratio;
+			vy[l] *= ratio;
+
+			float spin = MAX_ROTATION / std::fabs(h * w[l]);
+			w[l] *= spin < 1.0f ? spin : 1.0f;
+
+			x[l] += h * vx[l];
+			y[l] += h * vy[l];
+			a[l] += h * w[l];
+		}
+	}
+}
+
+// push the bodies out of the ground and back onto their anchors, for at most
+// `iterations` rounds; a lane stops once it's within the slops
+// (b2ContactSolver:: and b2RevoluteJoint::SolvePositionConstraints())
+void BatchWorld::SolvePositions(int iterations)
+{
+	float* solving = Row(ROW_SOLVING);
+	float* solved = Row(ROW_SOLVED);
+	const float* live = Row(ROW_LIVE);
+	float* separation = Row(ROW_SEPARATION);
+	float* joint_error = Row(ROW_JOINT_ERROR);
+	float lower_angle = MIN_JOINT_ANGLE, upper_angle = MAX_JOINT_ANGLE;
+
+#pragma omp simd
+	for (int l = 0; l < n; l++)
+	{
+		solving[l] = live[l];
+		solved[l] = 0.0f;
+	}
+
+	int left = 1;
+	for (int i = 0; i < iterations && left > 0; i++)
+	{
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			separation[l] = 0.0f;
+			joint_error[l] = 0.0f;
+		}
+
+		for (int b = 0; b < N_BODIES; b++)
+		{
+			float* y = Row(ROW_Y + b);
+			float* a = Row(ROW_A + b);
+			float im = inv_mass[b], ii = inv_inertia[b];
+
+			for (int k = 0; k < N_CORNERS; k++)
+			{
+				int c = b * N_CORNERS + k;
+				float lx = (k & 1) ? half_x[b] : -half_x[b];
+				float ly = (k & 2) ? half_y[b] : -half_y[b];
+				const float* touch = Row(ROW_TOUCH + c);
+
+#pragma omp simd
+				for (int l = 0; l < n; l++)
+				{
+					float s, co;
+					rotation(a[l], s, co);
+					float rx = co * lx - s * ly;
+					float ry = s * lx + co * ly;
+					float sep = y[l] + ry - GROUND_Y - 2.0f * POLYGON_RADIUS;
+					float m = touch[l] * solving[l];
+					separation[l] = m != 0.0f && sep < separation[l] ?
+										sep : separation[l];
+
+					float C = BAUMGARTE * (sep + LINEAR_SLOP);
+					C = C < -MAX_LINEAR_CORRECTION ? -MAX_LINEAR_CORRECTION :
+						C > 0.0f ? 0.0f : C;
+					float impulse = -m * C / (im + ii * rx * rx);
+					y[l] += im * impulse;
+					a[l] += ii * rx * impulse;
+				}
+			}
+		}
+
+		for (int j = 0; j < N_LEG_PARAMS; j++)
+		{
+			int A = body_a[j], B = body_b[j];
+			float* xa = Row(ROW_X + A);
+			float* ya = Row(ROW_Y + A);
+			float* aa = Row(ROW_A + A);
+			float* xb = Row(ROW_X + B);
+			float* yb = Row(ROW_Y + B);
+			float* ab = Row(ROW_A + B);
+			float ima = inv_mass[A], iia = inv_inertia[A];
+			float imb = inv_mass[B], iib = inv_inertia[B];
+			float axial_m = axial_mass[j];
+			float lax = anchor_ax[j], lay = anchor_ay[j];
+			float lbx = anchor_bx[j], lby = anchor_by[j];
+
+#pragma omp simd
+			for (int l = 0; l < n; l++)
+			{
+				float m = solving[l];
+
+				// limits
+				float angle = ab[l] - aa[l];
+				float below = angle - lower_angle + ANGULAR_SLOP;
+				below = below < -MAX_ANGULAR_CORRECTION ?
+							-MAX_ANGULAR_CORRECTION : below > 0.0f ? 0.0f : below;
+				float above = angle - upper_angle - ANGULAR_SLOP;
+				above = above < 0.0f ? 0.0f : above > MAX_ANGULAR_CORRECTION ?
+											MAX_ANGULAR_CORRECTION : above;
+				float C = angle <= lower_angle ? below :
+							angle >= upper_angle ? above : 0.0f;
+				float impulse = -m * axial_m * C;
+				aa[l] -= iia * impulse;
+				ab[l] += iib * impulse;
+				float angular = C * C / (ANGULAR_SLOP * ANGULAR_SLOP);
+
+				// anchors
+				float sa, ca, sb, cb;
+				rotation(aa[l], sa, ca);
+				rotation(ab[l], sb, cb);
+				float rax = ca * lax - sa * lay;
+				float ray = sa * lax + ca * lay;
+				float rbx = cb * lbx - sb * lby;
+				float rby = sb * lbx + cb * lby;
+				float cx = xb[l] + rbx - xa[l] - rax;
+				float cy = yb[l] + rby - ya[l] - ray;
+				float linear = (cx * cx + cy * cy) / (LINEAR_SLOP * LINEAR_SLOP);
+
+				float k11 = ima + imb + ray * ray * iia + rby * rby * iib;
+				float k12 = -ray * rax * iia - rby * rbx * iib;
+				float k22 = ima + imb + rax * rax * iia + rbx * rbx * iib;
+				float det = 1.0f / (k11 * k22 - k12 * k12);
+				float x = -m * det * (k22 * cx - k12 * cy);
+				float y = -m * det * (k11 * cy - k12 * cx);
+				xa[l] -= ima * x;
+				ya[l] -= ima * y;
+				aa[l] -= iia * (rax * y - ray * x);
+				xb[l] += imb * x;
+				yb[l] += imb * y;
+				ab[l] += iib * (rbx * y - rby * x);
+
+				float e = linear > angular ? linear : angular;
+				joint_error[l] = e > joint_error[l] ? e : joint_error[l];
+			}
+		}
+
+		// lanes within the slops are done
+		left = 0;
+#pragma omp simd reduction(+:left)
+		for (int l = 0; l < n; l++)
+		{
+			bool ok = separation[l] >= -3.0f * LINEAR_SLOP &&
+						joint_error[l] <= 1.0f;
+			float done = solving[l] * (ok ? 1.0f : 0.0f);
+			solved[l] += done;
+			solving[l] -= done;
+			left += solving[l] != 0.0f;
+		}
+	}
+}
+
+// put lanes that have been still for long enough to sleep, as b2Island::
+// Solve() does; nothing wakes them up again this iteration. the timers start
+// at zero with every BatchWorld, as a rebuilt Walker's bodies' do
+void BatchWorld::Sleep(float dt)
+{
+	const float* live = Row(ROW_LIVE);
+	const float* solved = Row(ROW_SOLVED);
+	float* awake = Row(ROW_AWAKE);
+	float* min_sleep = Row(ROW_MIN_SLEEP);
+
+#pragma omp simd
+	for (int l = 0; l < n; l++)
+	{
+		min_sleep[l] = INFINITY;
+	}
+
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		const float* vx = Row(ROW_VX + b);
+		const float* vy = Row(ROW_VY + b);
+		const float* w = Row(ROW_W + b);
+		float* sleep = Row(ROW_SLEEP + b);
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			bool moving = w[l] * w[l] > ANGULAR_SLEEP_TOLERANCE *
+											ANGULAR_SLEEP_TOLERANCE ||
+							vx[l] * vx[l] + vy[l] * vy[l] >
+								LINEAR_SLEEP_TOLERANCE * LINEAR_SLEEP_TOLERANCE;
+			sleep[l] = moving ? 0.0f : sleep[l] + live[l] * dt;
+			min_sleep[l] = sleep[l] < min_sleep[l] ? sleep[l] : min_sleep[l];
+		}
+	}
+
+#pragma omp simd
+	for (int l = 0; l < n; l++)
+	{
+		bool asleep = live[l] != 0.0f && solved[l] != 0.0f &&
+						min_sleep[l] >= TIME_TO_SLEEP;
+		awake[l] = asleep ? 0.0f : awake[l];
+	}
+
+	// putting a body to sleep zeroes its velocities
+	for (int b = 0; b < N_BODIES; b++)
+	{
+		float* vx = Row(ROW_VX + b);
+		float* vy = Row(ROW_VY + b);
+		float* w = Row(ROW_W + b);
+		float* sleep = Row(ROW_SLEEP + b);
+#pragma omp simd
+		for (int l = 0; l < n; l++)
+		{
+			float keep = live[l] * awake[l] + (1.0f - live[l]);
+			vx[l] *= keep;
+			vy[l] *= keep;
+			w[l] *= keep;
+			sleep[l] *= keep;
+		}
+	}
+}
+
+void BatchWorld::Step(float dt)
+{
+	if (Live() == 0) return;
+
+	Collide();
+	IntegrateVelocities(dt);
+	WarmStart();
+	float max_impulse = dt * max_torque;
+	for (int i = 0; i < config.velocity_iterations; i++)
+	{
+		SolveVelocities(1.0f / dt, max_impulse);
+	}
+	IntegratePositions(dt);
+	SolvePositions(config.position_iterations);
+	Sleep(dt);
+}
+
+// terminate the lanes whose predicates in Mask fired in the last step, as
+// Walker::CheckTermination() does; returns the number of lanes still active
+template <int Mask>
+int BatchWorld::Terminate()
+{
+	float* active = Row(ROW_ACTIVE);
+	const float* awake = Row(ROW_AWAKE);
+	const float* head_contact = Row(ROW_CONTACT);
+	const float* y = Row(ROW_Y);
+	const float* x = Row(ROW_X);
+	float* stall_x = Row(ROW_STALL_X);
+	float* stall_steps = Row(ROW_STALL_STEPS);
+	int count = 0;
+
+#pragma omp simd reduction(+:count)
+	for (int l = 0; l < n; l++)
+	{
+		bool fired = false;
+		if (Mask & TERMINATE_CONTACT)
+		{
+			fired = fired || head_contact[l] != 0.0f;
+		}
+		if (Mask & TERMINATE_HEIGHT)
+		{
+			fired = fired || y[l] < GROUND_Y + TERMINATE_HEAD_Y;
+		}
+		if (Mask & TERMINATE_SLEEP)
+		{
+			fired = fired || awake[l] == 0.0f;
+		}
+		if (Mask & TERMINATE_STALL)
+		{
+			// only counted while nothing else fired, like the early returns
+			// of Walker::CheckTermination()
+			bool check = !fired && active[l] != 0.0f;
+			bool progress = x[l] > stall_x[l] + TERMINATE_STALL_DX;
+			stall_x[l] = check && progress ? x[l] : stall_x[l];
+			stall_steps[l] = !check ? stall_steps[l] :
+								progress ? 0.0f : stall_steps[l] + 1.0f;
+			fired = fired || (check && !progress &&
+								stall_steps[l] >= TERMINATE_STALL_STEPS);
+		}
+		active[l] = fired ? 0.0f : active[l];
+		count += active[l] != 0.0f;
+	}
+	return count;
+}
+
+// step until the iteration is over or every lane has been terminated
+template <int Mask>
+void BatchWorld::SimulateSteps()
+{
+	int steps = config.TimeSteps();
+	float dt = config.TimeStep();
+	int active = 0;
+	for (int l = 0; l < n; l++)
+	{
+		active += Row(ROW_ACTIVE)[l] != 0.0f;
+	}
+	for (int i = 0; i < steps && active > 0; i++)
+	{
+		Step(dt);
+
+		if (Mask) active = Terminate<Mask>();
+	}
+}
+
+void BatchWorld::Simulate()
+{
+	typedef void (BatchWorld::*Steps)();
+	static const Steps steps[] = TERMINATION_TABLE(BatchWorld::SimulateSteps);
+	(this->*steps[config.termination & TERMINATE_ALL])();
+
+	for (int l = 0; l < n; l++)
+	{
+		if (walkers[l]) Store(l);
+	}
+}
@@ -0,0 +1,513 @@
+// headless benchmarks of the GA's building blocks and of whole runs, so that a
+// change's effect on throughput can be measured instead of guessed:
+//
+//   micro  walker construction (fresh, from an image, recycled by the pool),
+//          Simulate() per walker (own worlds, shards and the batch backend),
+//          WalkerState capture, select_fittest() per selection mode, breeding
+//          and Dump()
+//   macro  run_genetic_algorithm() over population sizes x thread counts
+//
+// every result is a median time per operation (lower is better); they're
+// written as JSON (--out), which a later run can be compared against
+// (--compare) to flag regressions beyond a tolerance
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "walker.h"
+#include "walker_world.h"
+#include "batch_world.h"
+#include "walker_pool.h"
+#include "arena.h"
+#include "genome.h"
+#include "selection.h"
+#include "scheduler.h"
+#include "eval_cache.h"
+#include "config.h"
+#include "ga.h"
+
+struct BenchResult {
+    std::string name;
+    std::string unit;
+    double median;
+    double min;
+    int samples;
+};
+
+struct BenchOptions {
+    std::string out = "bench.json";
+    std::string compare;
+    float tolerance = 0.1f;
+    std::string filter;
+    int samples = 5;
+    int generations = 10;
+    std::vector<int> sizes = { 500, 2000, 8000 };
+    std::vector<int> threads;
+    bool micro = true;
+    bool macro = true;
+};
+
+static std::vector<BenchResult> results;
+static BenchOptions options;
+
+// keeps the compiler from dropping work whose result is otherwise unused
+static volatile float sink;
+
+static double now_s()
+{
+    return std::chrono::duration<double>(
+               std::chrono::high_resolution_clock::now().time_since_epoch())
+               .count();
+}
+
+static bool wanted(const std::string& name)
+{
+    return options.filter.empty() ||
+           name.find(options.filter) != std::string::npos;
+}
+
+// run `setup` (untimed) and then `body` (timed) once per sample, after a
+// warm-up, and record the median and minimum time per op, `ops` being the
+// number of operations one call of `body` does; `scale` converts seconds
+template <typename Setup, typename Body>
+static void measure(const std::string& name, const std::string& unit,
+                    double scale, int ops, int samples, Setup setup, Body body)
+{
+    if (!wanted(name)) return;
+
+    std::vector<double> times;
+    for (int s = -1; s < samples; s++) {
+        setup();
+        double t0 = now_s();
+        body();
+        double t = (now_s() - t0) * scale / ops;
+        if (s >= 0) times.push_back(t);
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchResult r;
+    r.name = name;
+    r.unit = unit;
+    r.median = times[times.size() / 2];
+    r.min = times[0];
+    r.samples = samples;
+    results.push_back(r);
+
+    std::cout   << name << ": " << r.median << " " << unit << " (min "
+                << r.min << ")" << std::endl;
+}
+
+template <typename Body>
+static void measure(const std::string& name, const std::string& unit,
+                    double scale, int ops, int samples, Body body)
+{
+    measure(name, unit, scale, ops, samples, [] {}, body);
+}
+
+// random chromosomes for n walkers, the same every time
+static void random_speeds(std::vector<Walker*>& walkers)
+{
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> speed(config.min_motor_speed,
+                                                config.max_motor_speed);
+    for (Walker* w : walkers) {
+        w->SetMotorSpeeds(speed(gen), speed(gen), speed(gen), speed(gen));
+    }
+}
+
+static void bench_walkers()
+{
+    const int n = 256;
+    const double ns = 1e9;
+
+    // a walker some generations in, to build children from
+    Walker* ancestor = new Walker();
+    for (int g = 0; g < 10; g++) {
+        ancestor->Simulate();
+    }
+    WalkerLineage image = ancestor->states;
+
+    std::vector<Walker*> walkers(n);
+    auto release = [&] {
+        for (Walker*& w : walkers) {
+            delete w;
+            w = nullptr;
+        }
+    };
+
+    measure("walker_fresh", "ns/walker", ns, n, options.samples, release,
+            [&] {
+                for (int i = 0; i < n; i++) walkers[i] = new Walker();
+            });
+    measure("walker_image", "ns/walker", ns, n, options.samples, release,
+            [&] {
+                for (int i = 0; i < n; i++) walkers[i] = new Walker(image);
+            });
+    release();
+
+    // what the GA does: slots of the pool are reset instead of reallocated
+    {
+        WalkerPool own(n, 0);
+        for (int i = 0; i < n; i++) own.Acquire(0, i, image);
+        int generation = 0;
+        measure("walker_pool", "ns/walker", ns, n, options.samples, [&] {
+            generation += 2;
+            for (int i = 0; i < n; i++) own.Acquire(generation, i, image);
+        });
+    }
+
+    // Simulate() per walker, one generation's worth of steps each
+    {
+        WalkerPool own(n, 0);
+        int generation = 0;
+        measure("simulate_own", "us/walker", 1e6, n, options.samples,
+                [&] {
+                    generation++;
+                    for (int i = 0; i < n; i++) {
+                        walkers[i] = own.Acquire(generation, i, image);
+                    }
+                    random_speeds(walkers);
+                },
+                [&] {
+                    for (int i = 0; i < n; i++) walkers[i]->Simulate();
+                });
+    }
+    if (config.shard_size > 0) {
+        WalkerPool shared(n, config.shard_size);
+        int generation = 0;
+        measure("simulate_shard", "us/walker", 1e6, n, options.samples,
+                [&] {
+                    generation++;
+                    for (int i = 0; i < n; i++) {
+                        walkers[i] = shared.Acquire(generation, i, image);
+                    }
+                    random_speeds(walkers);
+                },
+                [&] {
+                    for (WalkerWorld* shard : shared.Shards(generation)) {
+                        if (shard) shard->Simulate();
+                    }
+                });
+    }
+
+    // the same steps with the batch backend (see batch_world.h), whatever
+    // backend the config asks for
+    {
+        WalkerPool own(n, 0);
+        int generation = 0;
+        PhysicsBackend backend = config.backend;
+        config.backend = BACKEND_BATCH;
+        measure("simulate_batch", "us/walker", 1e6, n, options.samples,
+                [&] {
+                    generation++;
+                    for (int i = 0; i < n; i++) {
+                        walkers[i] = own.Acquire(generation, i, image);
+                    }
+                    random_speeds(walkers);
+                },
+                [&] {
+                    for (int i = 0; i < n; i += BATCH_WORLD_SIZE) {
+                        BatchWorld batch(&walkers[i],
+                                         std::min(BATCH_WORLD_SIZE, n - i));
+                        batch.Simulate();
+                    }
+                });
+        config.backend = backend;
+    }
+
+    const int captures = 10000;
+    measure("state_capture", "ns/state", ns, captures, options.samples, [&] {
+        float x = 0.0f;
+        for (int i = 0; i < captures; i++) {
+            WalkerState s(ancestor);
+            x += s.headWorldCenter.x;
+        }
+        sink = x;
+    });
+
+    delete ancestor;
+}
+
+static void bench_selection()
+{
+    const int n = 10000;
+    const int k = n / 10;
+    const double ns = 1e9;
+
+    std::vector<Walker*> walkers(n, nullptr);
+    std::vector<float> fitness(n);
+    std::mt19937 gen(1);
+    std::normal_distribution<float> distance(0.0f, 1.0f);
+    for (float& f : fitness) f = distance(gen);
+
+    SelectionMode mode = config.selection;
+    SelectionMode modes[] = { SELECT_TOP_K, SELECT_TOURNAMENT, SELECT_SUS };
+    int generation = 0;
+    for (SelectionMode m : modes) {
+        config.selection = m;
+        measure(std::string("select_") + selection_name(m), "ns/walker", ns,
+                n, options.samples, [&] {
+                    // truncation selection pushes into a TopK as walkers are
+                    // evaluated, so that's part of its cost
+                    TopK best(m == SELECT_TOP_K ? k : 0, fitness.data());
+                    if (m == SELECT_TOP_K) {
+                        for (int i = 0; i < n; i++) best.Push(i);
+                    }
+                    std::vector<Walker*> fittest =
+                        select_fittest(walkers, fitness, best, k, generation++);
+                    sink = fittest.size();
+                });
+    }
+    config.selection = mode;
+}
+
+static void bench_breeding()
+{
+    const int n = 10000;
+    const int k = n / 10;
+    const double ns = 1e9;
+
+    WalkerPool parents_pool(k, 0);
+    std::vector<Walker*> parents(k);
+    for (int i = 0; i < k; i++) parents[i] = parents_pool.Acquire(0, i);
+    random_speeds(parents);
+
+    BreedingPlan plan;
+    int generation = 0;
+    measure("breed_plan", "ns/walker", ns, n, options.samples, [&] {
+        plan.Draw(n, k, config.seed, ++generation);
+    });
+    measure("breed", "ns/walker", ns, n, options.samples, [&] {
+        GenomeBlock children = breed_population(parents, plan);
+        sink = children.size;
+    });
+}
+
+static void bench_dump()
+{
+    const int lineage_size = 200;
+    const int dumps = 20;
+    const std::string fname = "bench-dump";
+
+    Walker* walker = new Walker();
+    for (int g = 0; g < lineage_size; g++) {
+        walker->Simulate();
+    }
+
+    measure("dump", "us/state", 1e6, dumps * lineage_size, options.samples,
+            [&] {
+                for (int i = 0; i < dumps; i++) {
+                    walker->Dump(fname + TRAJECTORY_EXTENSION);
+                }
+            });
+    measure("dump_json", "us/state", 1e6, dumps * lineage_size,
+            options.samples, [&] {
+                for (int i = 0; i < dumps; i++) {
+                    walker->DumpJSON(fname + ".json");
+                }
+            });
+    remove((fname + TRAJECTORY_EXTENSION).c_str());
+    remove((fname + ".json").c_str());
+
+    delete walker;
+}
+
+// whole runs of `options.generations` generations, set up the way main.cpp
+// does; their own output is dropped
+static void bench_runs()
+{
+    int macro_samples = std::max(1, options.samples / 2);
+
+    for (int n : options.sizes) {
+        for (int t : options.threads) {
+            std::string name = "ga_n" + std::to_string(n) + "_t" +
+                               std::to_string(t);
+            scheduler_init(t, config.pin);
+
+            std::ostringstream dropped;
+            std::streambuf* out = nullptr;
+            auto setup = [&] {
+                Arena::enabled = true;
+                pool = new WalkerPool(n, config.shard_size);
+                cache = config.Caching() ? new EvalCache() : nullptr;
+                create_time = simulate_time = fitness_selection_time = 0.0;
+                out = std::cout.rdbuf(dropped.rdbuf());
+            };
+            auto body = [&] {
+                std::vector<Walker*> survivors = run_genetic_algorithm(
+                    n, options.generations, config.fit_ratio);
+                std::cout.rdbuf(out);
+                sink = calculate_fitness(survivors[0]);
+
+                delete cache;
+                cache = nullptr;
+                delete pool;
+                pool = nullptr;
+                Arena::ResetAll();
+                Arena::enabled = false;
+                dropped.str("");
+            };
+            measure(name, "ms/generation", 1e3, options.generations,
+                    macro_samples, setup, body);
+        }
+    }
+}
+
+static nlohmann::json serialize_results()
+{
+    nlohmann::json j;
+    j["settings"] = config.Serialize();
+    j["generations"] = options.generations;
+    j["hardware_threads"] = omp_get_num_procs();
+
+    nlohmann::json& r = j["results"];
+    r = nlohmann::json::object();
+    for (const BenchResult& b : results) {
+        r[b.name] = { { "unit", b.unit }, { "median", b.median },
+                      { "min", b.min }, { "samples", b.samples } };
+    }
+    return j;
+}
+
+// compare the results against a baseline's; false if any got slower by more
+// than the tolerance
+static bool compare_results(const std::string& fname)
+{
+    std::ifstream in(fname);
+    nlohmann::json baseline = nlohmann::json::parse(in, nullptr, false);
+    if (!in || baseline.is_discarded() || !baseline.contains("results")) {
+        std::cout << "[bench.cpp] " << fname << " holds no results"
+                  << std::endl;
+        return false;
+    }
+
+    std::cout << "\ncompared to " << fname << ":" << std::endl;
+    int regressions = 0;
+    for (const BenchResult& b : results) {
+        const nlohmann::json& base = baseline["results"];
+        if (!base.contains(b.name) || !base[b.name].contains("median")) {
+            std::cout << "  " << b.name << ": not in the baseline" << std::endl;
+            continue;
+        }
+        double before = base[b.name]["median"].get<double>();
+        double ratio = before > 0.0 ? b.median / before : 1.0;
+
+        const char* verdict = "";
+        if (ratio > 1.0 + options.tolerance) {
+            verdict = "  REGRESSION";
+            regressions++;
+        } else if (ratio < 1.0 - options.tolerance) {
+            verdict = "  faster";
+        }
+        std::cout   << "  " << b.name << ": " << before << " -> " << b.median
+                    << " " << b.unit << " (" << ratio << "x)" << verdict
+                    << std::endl;
+    }
+
+    std::cout   << regressions << " regression(s) beyond "
+                << 100 * options.tolerance << "%" << std::endl;
+    return regressions == 0;
+}
+
+static bool parse_list(const char* arg, std::vector<int>& list)
+{
+    list.clear();
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int v = atoi(item.c_str());
+        if (v < 1) return false;
+        list.push_back(v);
+    }
+    return !list.empty();
+}
+
+// [USAGE] ./bench [--micro | --macro] [--filter NAME] [--samples N]
+//                 [--sizes N,N,...] [--threads N,N,...] [--generations N]
+//                 [--config FILE] [--out FILE] [--compare BASELINE]
+//                 [--tolerance FRACTION]
+int main(int argc, char *argv[])
+{
+    config.seed = 1;
+    config.seeded = true;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        bool ok = true;
+
+        if (arg == "--micro") {
+            options.macro = false;
+        } else if (arg == "--macro") {
+            options.micro = false;
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++a];
+        } else if (arg == "--samples" && has_value) {
+            options.samples = atoi(argv[++a]);
+            ok = options.samples > 0;
+        } else if (arg == "--sizes" && has_value) {
+            ok = parse_list(argv[++a], options.sizes);
+        } else if (arg == "--threads" && has_value) {
+            ok = parse_list(argv[++a], options.threads);
+        } else if (arg == "--generations" && has_value) {
+            options.generations = atoi(argv[++a]);
+            ok = options.generations > 1;
+        } else if (arg == "--config" && has_value) {
+            ok = config.Load(std::string(argv[++a])) && config.Valid();
+        } else if (arg == "--out" && has_value) {
+            options.out = argv[++a];
+        } else if (arg == "--compare" && has_value) {
+            options.compare = argv[++a];
+        } else if (arg == "--tolerance" && has_value) {
+            options.tolerance = atof(argv[++a]);
+            ok = options.tolerance >= 0.0f;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cout << "[bench.cpp] invalid argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // by default, every power of two up to all cores, and all cores
+    if (options.threads.empty()) {
+        scheduler_init(0, false);
+        int all = scheduler_threads();
+        for (int t = 1; t < all; t *= 2) options.threads.push_back(t);
+        options.threads.push_back(all);
+    }
+
+    if (options.micro) {
+        // the building blocks are timed on one thread
+        scheduler_init(1, false);
+        bench_walkers();
+        bench_selection();
+        bench_breeding();
+        bench_dump();
+    }
+    if (options.macro) {
+        bench_runs();
+    }
+
+    std::ofstream out(options.out);
+    out << serialize_results().dump(4) << std::endl;
+    if (!out) {
+        std::cout << "[bench.cpp] could not write " << options.out << std::endl;
+        return 1;
+    }
+    std::cout << "results written to " << options.out << std::endl;
+
+    if (!options.compare.empty() && !compare_results(options.compare)) {
+        return 1;
+    }
+    return 0;
+}
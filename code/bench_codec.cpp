@@ -0,0 +1,137 @@
+// benchmarks the compressed trajectory codec (see include/trajectory_codec.h)
+// on a trajectory written by `main`: compression ratio against the .traj and
+// JSON forms, encode/decode throughput, and the largest error of every kind of
+// field at a few quantization levels
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "walker.h"
+#include "trajectory_file.h"
+#include "trajectory_codec.h"
+
+// largest absolute error per kind of field
+struct CodecError {
+    float position = 0.0f, angle = 0.0f, velocity = 0.0f, speed = 0.0f;
+};
+
+static void worst(float& e, float a, float b)
+{
+    e = std::max(e, std::fabs(a - b));
+}
+
+static void compare_body(CodecError& e, const BodySnapshot& a,
+                         const BodySnapshot& b)
+{
+    worst(e.position, a.position.x, b.position.x);
+    worst(e.position, a.position.y, b.position.y);
+    worst(e.angle, a.angle, b.angle);
+    worst(e.velocity, a.linearVelocity.x, b.linearVelocity.x);
+    worst(e.velocity, a.linearVelocity.y, b.linearVelocity.y);
+    worst(e.velocity, a.angularVelocity, b.angularVelocity);
+}
+
+static CodecError compare(const std::vector<WalkerState>& original,
+                          const std::vector<WalkerState>& decoded)
+{
+    CodecError e;
+    for (size_t i = 0; i < original.size(); i++) {
+        const WalkerState& a = original[i];
+        const WalkerState& b = decoded[i];
+        worst(e.position, a.headWorldCenter.x, b.headWorldCenter.x);
+        worst(e.position, a.headWorldCenter.y, b.headWorldCenter.y);
+        worst(e.angle, a.headAngle, b.headAngle);
+        for (int j = 0; j < N_LEG_PARAMS; j++) {
+            worst(e.position, a.legsWorldCenter[j].x, b.legsWorldCenter[j].x);
+            worst(e.position, a.legsWorldCenter[j].y, b.legsWorldCenter[j].y);
+            worst(e.angle, a.legsAngle[j], b.legsAngle[j]);
+            worst(e.angle, a.jangles[j], b.jangles[j]);
+            worst(e.velocity, a.jspeeds[j], b.jspeeds[j]);
+            worst(e.speed, a.mspeeds[j], b.mspeeds[j]);
+            compare_body(e, a.snapshot.legs[j], b.snapshot.legs[j]);
+        }
+        compare_body(e, a.snapshot.head, b.snapshot.head);
+    }
+    return e;
+}
+
+static double elapsed_s(std::chrono::high_resolution_clock::time_point t0)
+{
+    return std::chrono::duration<double>(
+               std::chrono::high_resolution_clock::now() - t0).count();
+}
+
+// [USAGE] ./bench_codec [trajectory file (.traj)] [# repetitions]
+int main(int argc, char *argv[])
+{
+    std::string fname = argc > 1 ? argv[1] : DEFAULT_DUMP_FNAME;
+    int reps = argc > 2 ? std::max(1, atoi(argv[2])) : 20;
+
+    TrajectoryFile file;
+    if (!file.Open(fname)) {
+        return 1;
+    }
+    std::vector<WalkerState> states = file.States();
+    file.Close();
+    if (states.empty()) {
+        std::cout << fname << " holds no states" << std::endl;
+        return 1;
+    }
+
+    // what the same states take in the other formats
+    size_t raw_size = states.size() * sizeof(TrajectoryRecord);
+    size_t json_size = 2;
+    for (WalkerState& s : states) {
+        json_size += s.Serialize().dump().size() + 1;
+    }
+
+    std::cout   << fname << ": " << states.size() << " states, "
+                << raw_size << " bytes as records, " << json_size
+                << " bytes as JSON\n" << std::endl;
+
+    struct Level { const char* name; TrajectoryQuantization q; };
+    const float x10 = 10.0f;
+    Level levels[] = {
+        { "exact", { 0.0f, 0.0f, 0.0f, 0.0f } },
+        { "default", defaultQuantization },
+        { "coarse", { x10 * CODEC_POSITION_STEP, x10 * CODEC_ANGLE_STEP,
+                      x10 * CODEC_VELOCITY_STEP, CODEC_SPEED_STEP } },
+    };
+
+    for (const Level& level : levels) {
+        std::vector<uint8_t> data;
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < reps; r++) {
+            data = encode_trajectory(states, level.q);
+        }
+        double encode_s = elapsed_s(t0) / reps;
+
+        std::vector<WalkerState> decoded;
+        t0 = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < reps; r++) {
+            if (!decode_trajectory(data.data(), data.size(), decoded)) {
+                std::cout << "decoding failed" << std::endl;
+                return 1;
+            }
+        }
+        double decode_s = elapsed_s(t0) / reps;
+
+        CodecError e = compare(states, decoded);
+        double mb = raw_size / 1e6;
+
+        std::cout   << level.name << ": " << data.size() << " bytes ("
+                    << (double)raw_size / data.size() << "x records, "
+                    << (double)json_size / data.size() << "x JSON)\n"
+                    << "  encode " << mb / encode_s << " MB/s, decode "
+                    << mb / decode_s << " MB/s\n"
+                    << "  max. error: position " << e.position
+                    << " m, angle " << e.angle << " rad, velocity "
+                    << e.velocity << ", motor speed " << e.speed
+                    << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <unistd.h>
+#include "checkpoint.h"
+
+bool Checkpoint::Save(const std::string& fname) const
+{
+	// number the states of every lineage, parents first, skipping the ones an
+	// earlier lineage already numbered (ids are 1-based, 0 is "no parent")
+	std::unordered_map<const LineageNode*, uint64_t> ids;
+	std::vector<TrajectoryRecord> records;
+	std::vector<CheckpointSurvivor> survivors(lineages.size());
+
+	for (size_t s = 0; s < lineages.size(); s++)
+	{
+		std::vector<const LineageNode*> fresh;
+		const LineageNode* node = lineages[s].Tip();
+		while (node && ids.find(node) == ids.end())
+		{
+			fresh.push_back(node);
+			node = node->parent.get();
+		}
+
+		for (int i = (int)fresh.size() - 1; i >= 0; i--)
+		{
+			const LineageNode* n = fresh[i];
+			TrajectoryRecord r = pack_state(n->state);
+			r.node = records.size() + 1;
+			r.parent = n->parent ? ids[n->parent.get()] : 0;
+			ids[n] = r.node;
+			records.push_back(r);
+		}
+
+		const LineageNode* tip = lineages[s].Tip();
+		survivors[s].node = tip ? ids[tip] : 0;
+		for (int j = 0; j < N_LEG_PARAMS; j++)
+		{
+			survivors[s].mspeeds[j] = mspeeds[s * N_LEG_PARAMS + j];
+		}
+	}
+
+	std::string settings = config.Serialize().dump();
+
+	CheckpointHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = CHECKPOINT_MAGIC;
+	h.version = CHECKPOINT_VERSION;
+	h.header_size = sizeof(CheckpointHeader);
+	h.record_size = sizeof(TrajectoryRecord);
+	h.generation = generation;
+	h.create_time = create_time;
+	h.simulate_time = simulate_time;
+	h.fitness_selection_time = fitness_selection_time;
+	h.elapsed = elapsed;
+	h.config_size = settings.size();
+	h.n_survivors = survivors.size();
+	h.n_records = records.size();
+	if (!records.empty())
+	{
+		const WalkerParameters& wp = lineages[0].back().wp;
+		h.head_size[0] = wp.head_size.x;
+		h.head_size[1] = wp.head_size.y;
+		h.upper_leg_size[0] = wp.upper_leg_size.x;
+		h.upper_leg_size[1] = wp.upper_leg_size.y;
+		h.lower_leg_size[0] = wp.lower_leg_size.x;
+		h.lower_leg_size[1] = wp.lower_leg_size.y;
+		h.mass_density = wp.mass_density;
+		h.max_torque = wp.max_torque;
+	}
+
+	// write it all next to the old checkpoint, make sure it reached the disk,
+	// then swap it in
+	std::string tmp = fname + ".tmp";
+	FILE* out = fopen(tmp.c_str(), "wb");
+	if (!out)
+	{
+		std::cout << "[checkpoint.cpp] could not open " << tmp << std::endl;
+		return false;
+	}
+
+	bool ok = fwrite(&h, sizeof(h), 1, out) == 1;
+	ok = ok && fwrite(settings.data(), 1, settings.size(), out)
+					== settings.size();
+	ok = ok && fwrite(survivors.data(), sizeof(CheckpointSurvivor),
+						survivors.size(), out) == survivors.size();
+	ok = ok && fwrite(records.data(), sizeof(TrajectoryRecord),
+						records.size(), out) == records.size();
+	ok = ok && fflush(out) == 0 && fsync(fileno(out)) == 0;
+	ok = (fclose(out) == 0) && ok;
+
+	if (!ok || rename(tmp.c_str(), fname.c_str()) != 0)
+	{
+		std::cout << "[checkpoint.cpp] could not write " << fname << std::endl;
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Checkpoint::Load(const std::string& fname)
+{
+	std::ifstream in(fname, std::ios::binary | std::ios::ate);
+	if (!in)
+	{
+		std::cout << "[checkpoint.cpp] could not open " << fname << std::endl;
+		return false;
+	}
+	std::vector<char> data((size_t)in.tellg());
+	in.seekg(0);
+	in.read(data.data(), data.size());
+
+	CheckpointHeader h;
+	if (!in || data.size() < sizeof(h))
+	{
+		std::cout << "[checkpoint.cpp] " << fname << " is truncated"
+					<< std::endl;
+		return false;
+	}
+	memcpy(&h, data.data(), sizeof(h));
+
+	if (h.magic != CHECKPOINT_MAGIC || h.version != CHECKPOINT_VERSION ||
+		h.header_size != sizeof(CheckpointHeader) ||
+		h.record_size != sizeof(TrajectoryRecord))
+	{
+		std::cout << "[checkpoint.cpp] " << fname
+					<< " is not a checkpoint (or not one of this version)"
+					<< std::endl;
+		return false;
+	}
+
+	size_t body = data.size() - sizeof(h);
+	if (h.config_size > body)
+	{
+		std::cout << "[checkpoint.cpp] " << fname << " is truncated"
+					<< std::endl;
+		return false;
+	}
+	body -= h.config_size;
+	if (h.n_survivors > body / sizeof(CheckpointSurvivor) ||
+		h.n_records > body / sizeof(TrajectoryRecord) ||
+		h.n_survivors * sizeof(CheckpointSurvivor)
+			+ h.n_records * sizeof(TrajectoryRecord) != body)
+	{
+		std::cout << "[checkpoint.cpp] " << fname << " is truncated"
+					<< std::endl;
+		return false;
+	}
+
+	const char* p = data.data() + sizeof(h);
+	nlohmann::json settings = nlohmann::json::parse(p, p + h.config_size,
+													nullptr, false);
+	config = Config();
+	if (settings.is_discarded() || !config.Load(settings))
+	{
+		std::cout << "[checkpoint.cpp] " << fname << " has a broken config"
+					<< std::endl;
+		return false;
+	}
+	p += h.config_size;
+
+	generation = h.generation;
+	create_time = h.create_time;
+	simulate_time = h.simulate_time;
+	fitness_selection_time = h.fitness_selection_time;
+	elapsed = h.elapsed;
+
+	WalkerParameters wp;
+	wp.head_size.Set(h.head_size[0], h.head_size[1]);
+	wp.upper_leg_size.Set(h.upper_leg_size[0], h.upper_leg_size[1]);
+	wp.lower_leg_size.Set(h.lower_leg_size[0], h.lower_leg_size[1]);
+	wp.mass_density = h.mass_density;
+	wp.max_torque = h.max_torque;
+
+	std::vector<CheckpointSurvivor> survivors(h.n_survivors);
+	memcpy(survivors.data(), p, h.n_survivors * sizeof(CheckpointSurvivor));
+	p += h.n_survivors * sizeof(CheckpointSurvivor);
+
+	// rebuild the tree: a node's lineage is its parent's plus itself, and
+	// copying a lineage only copies a pointer
+	std::vector<WalkerLineage> nodes(h.n_records + 1);
+	for (uint64_t i = 1; i <= h.n_records; i++)
+	{
+		TrajectoryRecord r;
+		memcpy(&r, p + (i - 1) * sizeof(r), sizeof(r));
+		if (r.node != i || r.parent >= i)
+		{
+			std::cout << "[checkpoint.cpp] " << fname
+						<< " has a broken lineage at state " << i << std::endl;
+			return false;
+		}
+		nodes[i] = nodes[r.parent];
+		nodes[i].push_back(unpack_state(r, wp));
+	}
+
+	lineages.clear();
+	mspeeds.clear();
+	for (const CheckpointSurvivor& s : survivors)
+	{
+		if (s.node == 0 || s.node > h.n_records)
+		{
+			std::cout << "[checkpoint.cpp] " << fname
+						<< " has a survivor without a lineage" << std::endl;
+			return false;
+		}
+		lineages.push_back(nodes[s.node]);
+		mspeeds.insert(mspeeds.end(), s.mspeeds, s.mspeeds + N_LEG_PARAMS);
+	}
+	return true;
+}
@@ -0,0 +1,160 @@
+#include <iostream>
+#include "config.h"
+#include "termination.h"
+
+Config config;
+
+Config::Config()
+{
+	num_walkers = NUM_WALKERS;
+	num_iterations = NUM_ITERATIONS;
+	fit_ratio = FITTEST_RATIO;
+	shard_size = WORLD_SHARD_SIZE;
+	seed = 0;
+	seeded = false;
+	selection = SELECT_TOP_K;
+	termination = TERMINATE_DEFAULT;
+
+	crossover_probability = CROSSOVER_PROBABILITY;
+	mutation_probability = MUTATION_PROBABILITY;
+	mutate_size = MUTATE_SIZE;
+	min_motor_speed = MIN_MOTOR_SPEED;
+	max_motor_speed = MAX_MOTOR_SPEED;
+
+	hertz = SIM_HERTZ;
+	velocity_iterations = SIM_VEL_ITER;
+	position_iterations = SIM_POS_ITER;
+	iteration_time = ITER_TIME;
+	gravity = GRAVITY_Y;
+	friction = FRICTION_COEFF;
+	backend = BACKEND_BOX2D;
+
+	screen_fraction = SCREEN_FRACTION;
+	screen_hertz = SCREEN_HERTZ;
+	screen_velocity_iterations = SCREEN_VEL_ITER;
+	screen_position_iterations = SCREEN_POS_ITER;
+
+	islands = 1;
+	migration_interval = ISLAND_MIGRATION_INTERVAL;
+	migrants = ISLAND_MIGRANTS;
+	topology = TOPOLOGY_RING;
+
+	threads = 0;
+	pin = false;
+	cache = true;
+	dump_json = false;
+	compress = false;
+	checkpoint_every = CHECKPOINT_INTERVAL;
+	listen = 0;
+	spawn_workers = 0;
+}
+
+float Config::TimeStep() const
+{
+	return 1.0f / hertz;
+}
+
+int Config::TimeSteps() const
+{
+	return (int) (iteration_time * hertz);
+}
+
+Config Config::Screening() const
+{
+	Config c = *this;
+	c.hertz = screen_hertz;
+	c.velocity_iterations = screen_velocity_iterations;
+	c.position_iterations = screen_position_iterations;
+	return c;
+}
+
+// a cached outcome is only a child's own if nothing but its key decides it,
+// which isn't the case in a shard: there, its lane's origin and its
+// neighbours (contact ordering) play a part too
+bool Config::Caching() const
+{
+	return cache && (shard_size == 0 || backend == BACKEND_BATCH);
+}
+
+void Config::Resume(const Config& run)
+{
+	num_walkers = run.num_walkers;
+	num_iterations = run.num_iterations;
+	fit_ratio = run.fit_ratio;
+	shard_size = run.shard_size;
+	seed = run.seed;
+	seeded = run.seeded;
+	selection = run.selection;
+	termination = run.termination;
+
+	crossover_probability = run.crossover_probability;
+	mutation_probability = run.mutation_probability;
+	mutate_size = run.mutate_size;
+	min_motor_speed = run.min_motor_speed;
+	max_motor_speed = run.max_motor_speed;
+
+	hertz = run.hertz;
+	velocity_iterations = run.velocity_iterations;
+	position_iterations = run.position_iterations;
+	iteration_time = run.iteration_time;
+	gravity = run.gravity;
+	friction = run.friction;
+	backend = run.backend;
+
+	screen_fraction = run.screen_fraction;
+	screen_hertz = run.screen_hertz;
+	screen_velocity_iterations = run.screen_velocity_iterations;
+	screen_position_iterations = run.screen_position_iterations;
+
+	islands = run.islands;
+	migration_interval = run.migration_interval;
+	migrants = run.migrants;
+	topology = run.topology;
+}
+
+bool Config::Valid() const
+{
+	std::string problem;
+	if (num_walkers < 1) problem = "num_walkers has to be at least 1";
+	else if (num_iterations < 1)
+		problem = "num_iterations has to be at least 1";
+	else if (!(fit_ratio > 0.0f)) problem = "fit_ratio has to be positive";
+	else if (shard_size < 0) problem = "shard_size can't be negative";
+	else if (!(crossover_probability >= 0.0f && crossover_probability <= 1.0f)
+			|| !(mutation_probability >= 0.0f && mutation_probability <= 1.0f))
+		problem = "probabilities have to be in [0, 1]";
+	else if (!(mutate_size >= 0.0f)) problem = "mutate_size can't be negative";
+	else if (!(min_motor_speed < max_motor_speed))
+		problem = "min_motor_speed has to be below max_motor_speed";
+	else if (!(hertz > 0.0f)) problem = "hertz has to be positive";
+	else if (velocity_iterations < 1 || position_iterations < 1)
+		problem = "solver iterations have to be at least 1";
+	else if (TimeSteps() < 1)
+		problem = "iteration_time has to last at least one time step";
+	else if (!(screen_fraction >= 0.0f && screen_fraction <= 1.0f))
+		problem = "screen_fraction has to be in [0, 1]";
+	else if (!(screen_hertz > 0.0f)) problem = "screen_hertz has to be positive";
+	else if (screen_velocity_iterations < 1 || screen_position_iterations < 1)
+		problem = "screening solver iterations have to be at least 1";
+	else if (Screening().TimeSteps() < 1)
+		problem = "iteration_time has to last at least one screening time step";
+	else if (islands < 1) problem = "islands has to be at least 1";
+	else if (islands > num_walkers)
+		problem = "every island needs at least one walker";
+	else if (migration_interval < 1)
+		problem = "migration_interval has to be at least 1";
+	else if (migrants < 0) problem = "migrants can't be negative";
+	else if (threads < 0) problem = "threads can't be negative";
+	else if (checkpoint_every < 1)
+		problem = "checkpoint_every has to be at least 1";
+	else if (listen < 0 || listen > 65535)
+		problem = "listen has to be a port number";
+	else if (spawn_workers < 0) problem = "spawn_workers can't be negative";
+
+	if (!problem.empty())
+	{
+		std::cout << "[config.cpp] invalid config: " << problem << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,368 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "config.h"
+#include "termination.h"
+
+// reading and writing Configs; kept apart from config.cpp, which is all the
+// Walkers (and so the testbed) need
+
+using json = nlohmann::json;
+
+json Config::Serialize() const
+{
+	json serial;
+	serial["num_walkers"] = num_walkers;
+	serial["num_iterations"] = num_iterations;
+	serial["fit_ratio"] = fit_ratio;
+	serial["shard_size"] = shard_size;
+	if (seeded)
+	{
+		serial["seed"] = seed;
+	}
+	serial["selection"] = selection_name(selection);
+	serial["termination"] = termination ? termination_names(termination)
+										: "none";
+
+	serial["crossover_probability"] = crossover_probability;
+	serial["mutation_probability"] = mutation_probability;
+	serial["mutate_size"] = mutate_size;
+	serial["min_motor_speed"] = min_motor_speed;
+	serial["max_motor_speed"] = max_motor_speed;
+
+	serial["hertz"] = hertz;
+	serial["velocity_iterations"] = velocity_iterations;
+	serial["position_iterations"] = position_iterations;
+	serial["iteration_time"] = iteration_time;
+	serial["gravity"] = gravity;
+	serial["friction"] = friction;
+	serial["backend"] = backend_name(backend);
+
+	serial["screen_fraction"] = screen_fraction;
+	serial["screen_hertz"] = screen_hertz;
+	serial["screen_velocity_iterations"] = screen_velocity_iterations;
+	serial["screen_position_iterations"] = screen_position_iterations;
+
+	serial["islands"] = islands;
+	serial["migration_interval"] = migration_interval;
+	serial["migrants"] = migrants;
+	serial["topology"] = topology_name(topology);
+
+	serial["threads"] = threads;
+	serial["pin"] = pin;
+	serial["cache"] = cache;
+	serial["dump_json"] = dump_json;
+	serial["compress"] = compress;
+	serial["stream"] = stream;
+	serial["checkpoint"] = checkpoint;
+	serial["checkpoint_every"] = checkpoint_every;
+	serial["resume"] = resume;
+	serial["trace"] = trace;
+	serial["listen"] = listen;
+	serial["spawn_workers"] = spawn_workers;
+	serial["worker"] = worker;
+	return serial;
+}
+
+// members that are read as they are
+#define CONFIG_VALUE(name) \
+	if (key == #name) { name = value.get<decltype(name)>(); continue; }
+
+bool Config::Load(const json& serial)
+{
+	if (!serial.is_object())
+	{
+		std::cout	<< "[config_io.cpp] a config has to be a JSON object"
+					<< std::endl;
+		return false;
+	}
+
+	try
+	{
+		for (json::const_iterator it = serial.begin(); it != serial.end(); ++it)
+		{
+			const std::string& key = it.key();
+			const json& value = it.value();
+
+			CONFIG_VALUE(num_walkers)
+			CONFIG_VALUE(num_iterations)
+			CONFIG_VALUE(fit_ratio)
+			CONFIG_VALUE(shard_size)
+			CONFIG_VALUE(crossover_probability)
+			CONFIG_VALUE(mutation_probability)
+			CONFIG_VALUE(mutate_size)
+			CONFIG_VALUE(min_motor_speed)
+			CONFIG_VALUE(max_motor_speed)
+			CONFIG_VALUE(hertz)
+			CONFIG_VALUE(velocity_iterations)
+			CONFIG_VALUE(position_iterations)
+			CONFIG_VALUE(iteration_time)
+			CONFIG_VALUE(gravity)
+			CONFIG_VALUE(friction)
+			CONFIG_VALUE(screen_fraction)
+			CONFIG_VALUE(screen_hertz)
+			CONFIG_VALUE(screen_velocity_iterations)
+			CONFIG_VALUE(screen_position_iterations)
+			CONFIG_VALUE(islands)
+			CONFIG_VALUE(migration_interval)
+			CONFIG_VALUE(migrants)
+			CONFIG_VALUE(threads)
+			CONFIG_VALUE(pin)
+			CONFIG_VALUE(cache)
+			CONFIG_VALUE(dump_json)
+			CONFIG_VALUE(compress)
+			CONFIG_VALUE(stream)
+			CONFIG_VALUE(checkpoint)
+			CONFIG_VALUE(checkpoint_every)
+			CONFIG_VALUE(resume)
+			CONFIG_VALUE(trace)
+			CONFIG_VALUE(listen)
+			CONFIG_VALUE(spawn_workers)
+			CONFIG_VALUE(worker)
+
+			if (key == "seed")
+			{
+				seed = value.get<uint64_t>();
+				seeded = true;
+			}
+			else if (key == "selection")
+			{
+				if (!parse_selection(value.get<std::string>(), selection))
+				{
+					std::cout	<< "[config_io.cpp] unknown selection " << value
+								<< " (topk, tournament, sus)" << std::endl;
+					return false;
+				}
+			}
+			else if (key == "backend")
+			{
+				if (!parse_backend(value.get<std::string>(), backend))
+				{
+					std::cout	<< "[config_io.cpp] unknown backend " << value
+								<< " (box2d, batch)" << std::endl;
+					return false;
+				}
+			}
+			else if (key == "topology")
+			{
+				if (!parse_topology(value.get<std::string>(), topology))
+				{
+					std::cout	<< "[config_io.cpp] unknown topology " << value
+								<< " (ring, all)" << std::endl;
+					return false;
+				}
+			}
+			else if (key == "termination")
+			{
+				if (!parse_termination(value.get<std::string>(), termination))
+				{
+					std::cout	<< "[config_io.cpp] unknown termination " << value
+								<< " (contact, height, sleep, stall or none)"
+								<< std::endl;
+					return false;
+				}
+			}
+			else
+			{
+				std::cout	<< "[config_io.cpp] unknown setting " << key
+							<< std::endl;
+				return false;
+			}
+		}
+	}
+	catch (const json::exception& e)
+	{
+		std::cout << "[config_io.cpp] " << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Config::Load(const std::string& fname)
+{
+	std::ifstream in(fname);
+	if (!in)
+	{
+		std::cout << "[config_io.cpp] could not open " << fname << std::endl;
+		return false;
+	}
+
+	json serial = json::parse(in, nullptr, false);
+	if (serial.is_discarded())
+	{
+		std::cout << "[config_io.cpp] " << fname << " is not valid JSON"
+					<< std::endl;
+		return false;
+	}
+	return Load(serial);
+}
+
+// options (--name value) can go anywhere; everything else is positional
+bool parse_args(int argc, char* argv[], Config& c)
+{
+	// config files first, so that everything else overrides them
+	for (int a = 1; a + 1 < argc; a++)
+	{
+		if (std::string(argv[a]) == "--config" &&
+			!c.Load(std::string(argv[++a])))
+		{
+			return false;
+		}
+	}
+
+	std::vector<char*> args;
+	for (int a = 1; a < argc; a++)
+	{
+		std::string arg = argv[a];
+		bool has_value = a + 1 < argc;
+
+		// config files are already applied, and main() writes the config
+		if ((arg == "--config" || arg == "--save-config") && has_value)
+		{
+			a++;
+		}
+		else if (arg == "--set" && has_value)
+		{
+			// name=value, the value being JSON (or else a string)
+			std::string setting = argv[++a];
+			size_t eq = setting.find('=');
+			if (eq == std::string::npos)
+			{
+				std::cout << "--set takes name=value" << std::endl;
+				return false;
+			}
+			std::string text = setting.substr(eq + 1);
+			json value = json::parse(text, nullptr, false);
+			if (value.is_discarded())
+			{
+				value = text;
+			}
+			json serial;
+			serial[setting.substr(0, eq)] = value;
+			if (!c.Load(serial)) return false;
+		}
+		else if (arg == "--seed" && has_value)
+		{
+			c.seed = strtoull(argv[++a], nullptr, 10);
+			c.seeded = true;
+		}
+		else if (arg == "--threads" && has_value)
+		{
+			c.threads = atoi(argv[++a]);
+		}
+		else if (arg == "--pin")
+		{
+			c.pin = true;
+		}
+		else if (arg == "--terminate" && has_value)
+		{
+			if (!parse_termination(argv[++a], c.termination))
+			{
+				std::cout	<< "Unknown termination " << argv[a]
+							<< " (contact, height, sleep, stall or none)"
+							<< std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--json")
+		{
+			c.dump_json = true;
+		}
+		else if (arg == "--compress")
+		{
+			c.compress = true;
+		}
+		else if (arg == "--stream" && has_value)
+		{
+			c.stream = argv[++a];
+		}
+		else if (arg == "--checkpoint" && has_value)
+		{
+			c.checkpoint = argv[++a];
+		}
+		else if (arg == "--checkpoint-every" && has_value)
+		{
+			c.checkpoint_every = atoi(argv[++a]);
+		}
+		else if (arg == "--resume" && has_value)
+		{
+			c.resume = argv[++a];
+		}
+		else if (arg == "--trace" && has_value)
+		{
+			c.trace = argv[++a];
+		}
+		else if (arg == "--listen" && has_value)
+		{
+			c.listen = atoi(argv[++a]);
+		}
+		else if (arg == "--spawn-workers" && has_value)
+		{
+			c.spawn_workers = atoi(argv[++a]);
+		}
+		else if (arg == "--worker" && has_value)
+		{
+			c.worker = argv[++a];
+		}
+		else if (arg == "--islands" && has_value)
+		{
+			c.islands = atoi(argv[++a]);
+		}
+		else if (arg == "--migrate-every" && has_value)
+		{
+			c.migration_interval = atoi(argv[++a]);
+		}
+		else if (arg == "--migrants" && has_value)
+		{
+			c.migrants = atoi(argv[++a]);
+		}
+		else if (arg == "--topology" && has_value)
+		{
+			if (!parse_topology(argv[++a], c.topology))
+			{
+				std::cout	<< "Unknown topology " << argv[a]
+							<< " (ring, all)" << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--backend" && has_value)
+		{
+			if (!parse_backend(argv[++a], c.backend))
+			{
+				std::cout	<< "Unknown backend " << argv[a]
+							<< " (box2d, batch)" << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--screen" && has_value)
+		{
+			c.screen_fraction = atof(argv[++a]);
+		}
+		else if (arg == "--no-cache")
+		{
+			c.cache = false;
+		}
+		else if (arg == "--selection" && has_value)
+		{
+			if (!parse_selection(argv[++a], c.selection))
+			{
+				std::cout	<< "Unknown selection " << argv[a]
+							<< " (topk, tournament, sus)" << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			args.push_back(argv[a]);
+		}
+	}
+
+	int n_args = args.size();
+	if (n_args > 0) c.num_walkers = atoi(args[0]);
+	if (n_args > 1) c.num_iterations = atoi(args[1]);
+	if (n_args > 2) c.fit_ratio = atof(args[2]);
+	if (n_args > 3) c.shard_size = atoi(args[3]);
+
+	return c.Valid();
+}
@@ -0,0 +1,151 @@
+#include <cstring>
+#include "eval_cache.h"
+#include "scheduler.h"
+
+EvalKey::EvalKey(const WalkerSnapshot& start, const float mspeeds[N_LEG_PARAMS])
+{
+	this->start = start;
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		this->mspeeds[i] = mspeeds[i];
+	}
+}
+
+static bool same_body(const BodySnapshot& a, const BodySnapshot& b)
+{
+	return	a.position == b.position && a.angle == b.angle &&
+			a.linearVelocity == b.linearVelocity &&
+			a.angularVelocity == b.angularVelocity;
+}
+
+// the full key is compared, so a hash collision never hands out the wrong
+// result
+bool EvalKey::operator==(const EvalKey& other) const
+{
+	if (!same_body(start.head, other.start.head)) return false;
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		if (!same_body(start.legs[i], other.start.legs[i])) return false;
+		if (start.mspeeds[i] != other.start.mspeeds[i]) return false;
+		if (mspeeds[i] != other.mspeeds[i]) return false;
+	}
+	return start.max_torque == other.start.max_torque &&
+			start.awake == other.start.awake;
+}
+
+// 64-bit FNV-1a over the bits of every float of the key
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+static void mix(uint64_t& h, float f)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+	for (int i = 0; i < 4; i++)
+	{
+		h ^= (bits >> (8 * i)) & 0xFF;
+		h *= FNV_PRIME;
+	}
+}
+
+static void mix(uint64_t& h, const BodySnapshot& b)
+{
+	mix(h, b.position.x);
+	mix(h, b.position.y);
+	mix(h, b.angle);
+	mix(h, b.linearVelocity.x);
+	mix(h, b.linearVelocity.y);
+	mix(h, b.angularVelocity);
+}
+
+size_t EvalKeyHash::operator()(const EvalKey& key) const
+{
+	uint64_t h = FNV_OFFSET;
+	mix(h, key.start.head);
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		mix(h, key.start.legs[i]);
+		mix(h, key.start.mspeeds[i]);
+		mix(h, key.mspeeds[i]);
+	}
+	mix(h, key.start.max_torque);
+	h ^= key.start.awake;
+	h *= FNV_PRIME;
+	return h;
+}
+
+EvalCache::EvalCache() : lookups(0), hits(0), duplicates(0)
+{
+}
+
+// find or create the entry for key; entries are nodes of an unordered_map, so
+// the returned pointer stays valid until the entry is evicted
+EvalEntry* EvalCache::Claim(const EvalKey& key, int generation, int i)
+{
+	size_t h = EvalKeyHash()(key);
+	Stripe& stripe = stripes[(h >> 32) % EVAL_CACHE_STRIPES];
+	std::lock_guard<std::mutex> guard(stripe.lock);
+
+	auto found = stripe.entries.emplace(key, EvalEntry());
+	EvalEntry& entry = found.first->second;
+	if (found.second)
+	{
+		entry.generation = generation;
+		entry.owner = i;
+		entry.done = false;
+	}
+	else if (!entry.done && entry.generation == generation && i < entry.owner)
+	{
+		entry.owner = i;
+	}
+	entry.last_used = generation;
+
+	lookups++;
+	return &entry;
+}
+
+// only valid once every child of the generation has claimed its entry
+EvalStatus EvalCache::Status(const EvalEntry* entry, int generation, int i)
+{
+	if (entry->done && entry->generation < generation)
+	{
+		hits++;
+		return EVAL_HIT;
+	}
+	if (entry->owner != i)
+	{
+		duplicates++;
+		return EVAL_DUPLICATE;
+	}
+	return EVAL_SIMULATE;
+}
+
+void EvalCache::Evict(int generation)
+{
+#pragma omp parallel for num_threads(scheduler_threads())
+	for (int s = 0; s < EVAL_CACHE_STRIPES; s++)
+	{
+		auto& entries = stripes[s].entries;
+		for (auto it = entries.begin(); it != entries.end(); )
+		{
+			if (generation - it->second.last_used > EVAL_CACHE_AGE)
+			{
+				it = entries.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+}
+
+size_t EvalCache::Size()
+{
+	size_t n = 0;
+	for (int s = 0; s < EVAL_CACHE_STRIPES; s++)
+	{
+		n += stripes[s].entries.size();
+	}
+	return n;
+}
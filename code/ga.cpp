@@ -0,0 +1,737 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include "ga.h"
+#include "walker_world.h"
+#include "batch_world.h"
+#include "arena.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "trace.h"
+#include <omp.h>
+
+std::chrono::high_resolution_clock::time_point program_start;
+
+// define a timer for each the creation, simulation, and fitness selection
+// of the walkers
+double create_time;
+double simulate_time;
+double fitness_selection_time;
+
+// with screening on, the time spent screening and the sum of the generations'
+// rank correlations, over the generations screened by this process
+double screen_time;
+double screen_correlation;
+int screened_generations;
+
+// the pool every walker is recycled through
+WalkerPool* pool;
+
+// the settings of the run live in `config` (see config.h); every random draw
+// is keyed by config.seed (see rng.h), so runs with the same seed are identical
+// regardless of the number of threads
+
+// outcomes of earlier simulations, so that identical children aren't simulated
+// again (nullptr if disabled; see eval_cache.h)
+EvalCache* cache;
+
+// where survivors' lineages are streamed while the run goes on (nullptr if
+// they're only kept in memory; see trajectory_stream.h)
+TrajectoryStream* stream;
+
+// the checkpoint the run carries on from (nullptr if it starts from scratch;
+// see checkpoint.h)
+Checkpoint* resume_from;
+
+// this process's island, which survivors migrate through (nullptr unless
+// running as one; see island.h)
+Island* island;
+
+// the workers children are simulated by (nullptr if they're simulated here;
+// see remote.h)
+Coordinator* coordinator;
+
+// set by SIGTERM/SIGINT while checkpointing: the run checkpoints and stops once
+// the current generation is done, instead of losing it
+volatile sig_atomic_t stop_requested;
+bool stopped_early;
+
+void request_stop(int)
+{
+    stop_requested = 1;
+}
+
+// Define a function to create a walker with the given motor speeds.
+// the walker starts in the same position as the passed parent; walkers are
+// recycled through the pool, walker i of a generation always taking the same
+// slot
+Walker* create_walker(Walker* parent, const GenomeBlock& genomes, int generation,
+                        int i) 
+{
+    Walker* walky;
+    if (parent) {
+        walky = pool->Acquire(generation, i, parent->states);
+    } else {
+        walky = pool->Acquire(generation, i);
+    }
+    float speeds[N_LEG_PARAMS];
+    genomes.Get(i, speeds);
+    walky->SetMotorSpeeds(speeds[UPPER_LEFT], speeds[UPPER_RIGHT],
+                            speeds[LOWER_LEFT], speeds[LOWER_RIGHT]);
+    return walky;
+}
+
+// Define a function to calculate the fitness of an walker assuming that
+// the walker's step had already been simulated.
+float calculate_fitness(Walker* walker) 
+{
+    // Get the distance walked by the walker and return it as the fitness.
+    return walker->GetPositionX();
+
+    //return ABS(walker->GetVelocityX());
+}
+
+// select the survivors of a generation from its fitness values; `best` holds
+// the top k already when selecting by truncation
+std::vector<Walker*> select_fittest(const std::vector<Walker*>& walkers,
+                                    const std::vector<float>& fitness,
+                                    const TopK& best, int k, int generation) 
+{
+    std::vector<int> selected;
+    if (config.selection == SELECT_TOP_K) {
+        selected = best.Sorted();
+    } else {
+        selected = select(config.selection, fitness, k, config.seed,
+                          generation);
+    }
+
+    std::vector<Walker*> fittest(selected.size());
+    for (int i = 0; i < (int)selected.size(); i++) {
+        fittest[i] = walkers[selected[i]];
+    }
+
+    // the remaining (dead) walkers stay in the pool to be recycled
+
+    return fittest;
+}
+
+// breed the chromosomes of a new population from the fittest walkers of the
+// previous generation, following an already drawn plan (see genome.h)
+GenomeBlock breed_population(const std::vector<Walker*>& fittest_walkers,
+                                const BreedingPlan& plan)
+{
+    TRACE_SCOPE("breed");
+
+    // gather the parents' chromosomes into one block
+    GenomeBlock parents(fittest_walkers.size());
+    for (int i = 0; i < (int)fittest_walkers.size(); i++) {
+        parents.Set(i, fittest_walkers[i]->mspeeds);
+    }
+
+    GenomeBlock children;
+    breed(parents, plan, children);
+    return children;
+}
+
+// walkers per task: one shard (or one walker if walkers have their own
+// worlds), or with the batch backend a BatchWorld's worth of them, without
+// splitting shards
+static int simulation_chunk()
+{
+    int chunk = pool->Chunk();
+    if (config.backend == BACKEND_BATCH) {
+        chunk *= std::max(1, BATCH_WORLD_SIZE / chunk);
+    }
+    return chunk;
+}
+
+// step walkers [first, last) of a generation, built by the calling thread
+static void simulate_chunk(std::vector<Walker*>& population, int first,
+                           int last, int generation)
+{
+    WalkerWorld* shard = pool->Shard(generation, first);
+    if (config.backend == BACKEND_BATCH) {
+        BatchWorld batch(&population[first], last - first);
+        batch.Simulate();
+    } else if (shard) {
+        shard->Simulate();
+    } else {
+        population[first]->Simulate();
+    }
+}
+
+// simulate every child at screening fidelity and return the n fittest, fittest
+// first, with their screening fitness; the pass is built and simulated as
+// run_generation() does, in the same pool slots, but without the cache or
+// workers (whose results are full fidelity)
+//
+// screening only swaps the simulation settings of `config` while it runs, so
+// nothing else may be simulating meanwhile; screened walkers are parked
+// afterwards, so those that aren't simulated again stay out of the way of
+// their shard-mates
+std::vector<int> screen_children(const std::vector<Walker*>& fittest_walkers,
+                                 const GenomeBlock& genomes,
+                                 const BreedingPlan& plan, int n,
+                                 int generation, std::vector<float>& fitness)
+{
+    TRACE_SCOPE("screen");
+
+    int num_walkers = genomes.size;
+    std::vector<Walker*> population(num_walkers);
+    std::vector<float> screened(num_walkers);
+
+    int n_threads = scheduler_threads();
+    std::vector<TopK> best(n_threads, TopK(n, screened.data()));
+
+    int chunk = simulation_chunk();
+    int n_tasks = (num_walkers + chunk - 1) / chunk;
+
+    Config full = config;
+    config = full.Screening();
+
+#pragma omp parallel num_threads(n_threads)
+    {
+        TopK& mine = best[omp_get_thread_num()];
+
+#pragma omp for schedule(dynamic, 1)
+        for (int t = 0; t < n_tasks; t++) {
+            int first = t * chunk;
+            int last = std::min(num_walkers, first + chunk);
+
+            for (int i = first; i < last; i++) {
+                Walker* parent = fittest_walkers.empty() ?
+                            nullptr : fittest_walkers[plan.parent1[i]];
+                population[i] = create_walker(parent, genomes, generation, i);
+            }
+
+            simulate_chunk(population, first, last, generation);
+
+            for (int i = first; i < last; i++) {
+                float f = calculate_fitness(population[i]);
+                screened[i] = (f == f) ? f : -INFINITY;
+                mine.Push(i);
+                population[i]->Park();
+            }
+        }
+    }
+
+    config = full;
+
+    for (int t = 1; t < n_threads; t++) {
+        best[0].Merge(best[t]);
+    }
+    std::vector<int> finalists = best[0].Sorted();
+
+    fitness.resize(finalists.size());
+    for (int j = 0; j < (int)finalists.size(); j++) {
+        fitness[j] = screened[finalists[j]];
+    }
+    return finalists;
+}
+
+// the ranks of v's values, ties sharing their average rank
+static std::vector<double> ranks(const std::vector<float>& v)
+{
+    int n = v.size();
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [&v](int a, int b) { return v[a] < v[b]; });
+
+    std::vector<double> r(n);
+    for (int i = 0; i < n;) {
+        int j = i + 1;
+        while (j < n && !(v[order[i]] < v[order[j]])) {
+            j++;
+        }
+        for (int m = i; m < j; m++) {
+            r[order[m]] = 0.5 * (i + j - 1);
+        }
+        i = j;
+    }
+    return r;
+}
+
+// Spearman's rank correlation between a and b, which are the same size; 0 if
+// either has less than two distinct values
+float rank_correlation(const std::vector<float>& a,
+                       const std::vector<float>& b)
+{
+    int n = a.size();
+    if (n < 2) return 0.0f;
+
+    std::vector<double> ra = ranks(a), rb = ranks(b);
+    double mean = 0.5 * (n - 1);
+    double ab = 0.0, aa = 0.0, bb = 0.0;
+    for (int i = 0; i < n; i++) {
+        double da = ra[i] - mean, db = rb[i] - mean;
+        ab += da * db;
+        aa += da * da;
+        bb += db * db;
+    }
+    return (aa > 0.0 && bb > 0.0) ? (float)(ab / std::sqrt(aa * bb)) : 0.0f;
+}
+
+// build, simulate and evaluate one generation in a single pass and return its
+// survivors, fittest first; every walker's fitness goes to `fitness` if given
+//
+// each task takes one shard (or one walker if walkers have their own worlds,
+// or a BatchWorld's worth with the batch backend): it builds the walkers,
+// steps them, and records their fitness while they're still in cache, so
+// there are no barriers between creating, simulating and selecting; how long
+// a task takes depends on what its bodies do, so threads take tasks as they
+// finish. the next generation's plan only depends on the number of survivors,
+// so threads done with the last tasks draw it while the others finish
+std::vector<Walker*> run_generation(const std::vector<Walker*>& fittest_walkers,
+                                    const GenomeBlock& genomes,
+                                    const BreedingPlan& plan,
+                                    BreedingPlan& next_plan,
+                                    int k, int generation,
+                                    GenerationStats& stats,
+                                    std::vector<float>* fitness_out)
+{
+    int num_walkers = genomes.size;
+    std::vector<Walker*> population(num_walkers);
+    std::vector<float> fitness(num_walkers);
+
+    int n_threads = scheduler_threads();
+    std::vector<TopK> best(n_threads, TopK(k, fitness.data()));
+
+    int chunk = simulation_chunk();
+    int n_tasks = (num_walkers + chunk - 1) / chunk;
+    int grain = scheduler_grain(next_plan.size);
+    double create_s = 0.0, simulate_s = 0.0;
+    int terminated = 0, adopted = 0, remote = 0;
+
+    // find every child's entry in the evaluation cache before anyone is
+    // simulated, so that the owner of each entry is known (see eval_cache.h);
+    // the children of generation 0 have nothing in common
+    bool caching = cache && !fittest_walkers.empty();
+    std::vector<EvalEntry*> entries;
+    std::vector<EvalStatus> status;
+    if (caching) {
+        TRACE_SCOPE("cache lookup");
+        cache->Evict(generation);
+        entries.resize(num_walkers);
+        status.resize(num_walkers);
+
+#pragma omp parallel for num_threads(n_threads)
+        for (int i = 0; i < num_walkers; i++) {
+            float speeds[N_LEG_PARAMS];
+            genomes.Get(i, speeds);
+            Walker* parent = fittest_walkers[plan.parent1[i]];
+            EvalKey key(parent->states.back().snapshot, speeds);
+            entries[i] = cache->Claim(key, generation, i);
+        }
+
+#pragma omp parallel for num_threads(n_threads)
+        for (int i = 0; i < num_walkers; i++) {
+            status[i] = cache->Status(entries[i], generation, i);
+        }
+    }
+
+    // children simulated by workers take their outcome like cache hits do;
+    // whatever no worker took is simulated here
+    std::vector<RemoteResult> remote_results;
+    std::vector<bool> remote_done;
+    if (coordinator) {
+        TRACE_SCOPE("remote");
+        std::vector<RemoteTask> tasks;
+        std::vector<int> index;
+        for (int i = 0; i < num_walkers; i++) {
+            if (caching && status[i] != EVAL_SIMULATE) continue;
+
+            RemoteTask t;
+            memset(&t, 0, sizeof(t));
+            genomes.Get(i, t.mspeeds);
+            if (!fittest_walkers.empty()) {
+                Walker* parent = fittest_walkers[plan.parent1[i]];
+                t.has_parent = 1;
+                t.parent = pack_state(parent->states.back());
+            }
+            tasks.push_back(t);
+            index.push_back(i);
+        }
+
+        std::vector<RemoteResult> results;
+        std::vector<bool> done;
+        coordinator->Evaluate(tasks, results, done);
+
+        remote_results.resize(num_walkers);
+        remote_done.assign(num_walkers, false);
+        for (int t = 0; t < (int)index.size(); t++) {
+            remote_results[index[t]] = results[t];
+            remote_done[index[t]] = done[t];
+        }
+    }
+
+#pragma omp parallel num_threads(n_threads) \
+                     reduction(+:create_s, simulate_s, terminated, adopted, \
+                               remote)
+    {
+        TopK& mine = best[omp_get_thread_num()];
+
+#pragma omp for schedule(dynamic, 1) nowait
+        for (int t = 0; t < n_tasks; t++) {
+            int first = t * chunk;
+            int last = std::min(num_walkers, first + chunk);
+            double t0 = omp_get_wtime();
+
+            {
+                TRACE_SCOPE_ARG("build", first);
+                for (int i = first; i < last; i++) {
+                    // [TODO] for now, just use the first parent to initialize
+                    // the child's position
+                    Walker* parent = fittest_walkers.empty() ?
+                                nullptr : fittest_walkers[plan.parent1[i]];
+                    population[i] = create_walker(parent, genomes, generation,
+                                                  i);
+
+                    // cached children aren't stepped; duplicates wait for
+                    // their entry's owner to be simulated
+                    if (caching && status[i] == EVAL_HIT) {
+                        population[i]->Adopt(entries[i]->result);
+                    } else if (caching && status[i] == EVAL_DUPLICATE) {
+                        population[i]->Park();
+                    } else if (!remote_done.empty() && remote_done[i]) {
+                        population[i]->Adopt(unpack_state(
+                            remote_results[i].state, population[i]->params));
+                    }
+                }
+            }
+            double t1 = omp_get_wtime();
+
+            {
+                TRACE_SCOPE_ARG("simulate", first);
+                simulate_chunk(population, first, last, generation);
+            }
+
+            // a walker whose simulation blew up (NaN) is never selected
+            {
+                TRACE_SCOPE_ARG("evaluate", first);
+                for (int i = first; i < last; i++) {
+                    if (caching && status[i] == EVAL_DUPLICATE) continue;
+
+                    float f = calculate_fitness(population[i]);
+                    fitness[i] = (f == f) ? f : -INFINITY;
+                    mine.Push(i);
+
+                    if (!remote_done.empty() && remote_done[i]) {
+                        remote++;
+                        terminated += remote_results[i].terminated ? 1 : 0;
+                    } else if (population[i]->adopted) {
+                        adopted++;
+                    } else if (population[i]->terminated) {
+                        terminated++;
+                    }
+
+                    if (caching && status[i] == EVAL_SIMULATE) {
+                        entries[i]->result = population[i]->states.back();
+                        entries[i]->done = true;
+                    }
+                }
+            }
+            double t2 = omp_get_wtime();
+
+            create_s += t1 - t0;
+            simulate_s += t2 - t1;
+        }
+
+        TRACE_SCOPE("draw plan");
+#pragma omp for schedule(dynamic, grain) nowait
+        for (int i = 0; i < next_plan.size; i++) {
+            next_plan.DrawChild(i, k, config.seed, generation + 1);
+        }
+    }
+
+    // every owner is done now; hand its result to its duplicates, still one
+    // shard per task
+    if (caching) {
+        TRACE_SCOPE("adopt duplicates");
+#pragma omp parallel for num_threads(n_threads) schedule(dynamic, 1) \
+                         reduction(+:adopted)
+        for (int t = 0; t < n_tasks; t++) {
+            TopK& mine = best[omp_get_thread_num()];
+            int first = t * chunk;
+            int last = std::min(num_walkers, first + chunk);
+
+            for (int i = first; i < last; i++) {
+                if (status[i] != EVAL_DUPLICATE) continue;
+
+                population[i]->Adopt(entries[i]->result);
+                float f = calculate_fitness(population[i]);
+                fitness[i] = (f == f) ? f : -INFINITY;
+                mine.Push(i);
+                adopted++;
+            }
+        }
+    }
+
+    std::vector<Walker*> survivors;
+    double t0 = omp_get_wtime();
+    {
+        TRACE_SCOPE("select");
+        for (int t = 1; t < n_threads; t++) {
+            best[0].Merge(best[t]);
+        }
+        survivors = select_fittest(population, fitness, best[0], k,
+                                   generation);
+    }
+
+    stats.create_ms = 1000.0 * create_s / n_threads;
+    stats.simulate_ms = 1000.0 * simulate_s / n_threads;
+    stats.select_ms = 1000.0 * (omp_get_wtime() - t0);
+    stats.terminated = terminated;
+    stats.adopted = adopted;
+    stats.remote = remote;
+    stats.screen_ms = 0.0;
+    stats.screened = 0;
+    stats.correlation = 0.0f;
+
+    if (fitness_out) {
+        *fitness_out = fitness;
+    }
+    return survivors;
+}
+
+// run_generation(), after screening the children if configured to (see ga.h);
+// the finalists are simulated in full as a generation of their own, in the
+// order of their screening fitness
+std::vector<Walker*> evaluate_generation(
+                                    const std::vector<Walker*>& fittest_walkers,
+                                    const GenomeBlock& genomes,
+                                    const BreedingPlan& plan,
+                                    BreedingPlan& next_plan,
+                                    int k, int generation,
+                                    GenerationStats& stats)
+{
+    int num_walkers = genomes.size;
+    int n = std::max(k, (int)std::ceil(config.screen_fraction * num_walkers));
+    if (config.screen_fraction <= 0.0f || n >= num_walkers) {
+        return run_generation(fittest_walkers, genomes, plan, next_plan, k,
+                              generation, stats);
+    }
+
+    double t0 = omp_get_wtime();
+    std::vector<float> screened;
+    std::vector<int> finalists = screen_children(fittest_walkers, genomes,
+                                                 plan, n, generation,
+                                                 screened);
+    double screen_s = omp_get_wtime() - t0;
+
+    // run_generation() only needs a plan for the children's first parents
+    GenomeBlock finalist_genomes(n);
+    BreedingPlan finalist_plan;
+    finalist_plan.size = n;
+    for (int j = 0; j < n; j++) {
+        float speeds[N_LEG_PARAMS];
+        genomes.Get(finalists[j], speeds);
+        finalist_genomes.Set(j, speeds);
+        if (!fittest_walkers.empty()) {
+            finalist_plan.parent1.push_back(plan.parent1[finalists[j]]);
+        }
+    }
+
+    std::vector<float> fitness;
+    std::vector<Walker*> survivors = run_generation(fittest_walkers,
+                                                    finalist_genomes,
+                                                    finalist_plan, next_plan,
+                                                    k, generation, stats,
+                                                    &fitness);
+
+    stats.screen_ms = 1000.0 * screen_s;
+    stats.screened = num_walkers;
+    stats.correlation = rank_correlation(screened, fitness);
+    screen_time += stats.screen_ms;
+    screen_correlation += stats.correlation;
+    screened_generations++;
+    return survivors;
+}
+
+// hand the survivors' new states to the stream, then drop what's streamed from
+// memory; all of them are appended before any is truncated, since survivors
+// share ancestors
+void stream_survivors(const std::vector<Walker*>& survivors)
+{
+    if (!stream) return;
+
+    TRACE_SCOPE("stream append");
+    for (Walker* w : survivors) {
+        stream->Append(w->states);
+    }
+    for (Walker* w : survivors) {
+        w->states.Truncate(TRAJECTORY_STREAM_KEEP);
+    }
+}
+
+// checkpoint the run after `generation` generations, `survivors` being the last
+// one's
+void save_checkpoint(const std::vector<Walker*>& survivors, int generation)
+{
+    TRACE_SCOPE("checkpoint");
+
+    Checkpoint c;
+    c.config = config;
+    c.generation = generation;
+    c.create_time = create_time;
+    c.simulate_time = simulate_time;
+    c.fitness_selection_time = fitness_selection_time;
+    c.elapsed = std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - program_start)
+                    .count();
+
+    for (Walker* w : survivors) {
+        c.lineages.push_back(w->states);
+        c.mspeeds.insert(c.mspeeds.end(), w->mspeeds,
+                         w->mspeeds + N_LEG_PARAMS);
+    }
+
+    if (c.Save(config.checkpoint)) {
+        std::cout   << "(run_genetic_algorithm): Checkpointed generation "
+                    << generation - 1 << " to " << config.checkpoint
+                    << std::endl;
+    }
+}
+
+// rebuild the survivors of the checkpointed generation in its pool buffer, in
+// the pose of their most recent state; they're only bred from, not simulated
+std::vector<Walker*> restore_survivors(const Checkpoint& c)
+{
+    std::vector<Walker*> survivors(c.lineages.size());
+    for (int i = 0; i < (int)c.lineages.size(); i++) {
+        const float* speeds = &c.mspeeds[i * N_LEG_PARAMS];
+        survivors[i] = pool->Acquire(c.generation - 1, i, c.lineages[i]);
+        survivors[i]->SetMotorSpeeds(speeds[UPPER_LEFT], speeds[UPPER_RIGHT],
+                                     speeds[LOWER_LEFT], speeds[LOWER_RIGHT]);
+    }
+    return survivors;
+}
+
+// whether to checkpoint once `generation` generations are done
+bool checkpoint_due(int generation, int num_iterations)
+{
+    if (config.checkpoint.empty() || generation >= num_iterations) {
+        return false;
+    }
+    return stop_requested || generation % config.checkpoint_every == 0;
+}
+
+// Define a function to run the genetic algorithm and return the best walkers.
+std::vector<Walker*> run_genetic_algorithm( int num_walkers, 
+                                            int num_iterations,
+                                            float fit_ratio) 
+{
+    if (fit_ratio > 1.0f) fit_ratio = 0.1f;
+
+    // keep at least one walker to breed from
+    int k = std::max(1, (int)(num_walkers * fit_ratio));
+
+    std::vector<Walker*> walkers;
+    BreedingPlan plan, next_plan;
+    GenomeBlock genomes;
+    GenerationStats stats;
+
+    // generations done, and the last one checkpointed
+    int first = 1;
+    int saved = 0;
+    if (resume_from) {
+        // the checkpointed survivors stand in for the generations already done;
+        // the plan they breed from only depends on the seed and the generation
+        first = resume_from->generation;
+        walkers = restore_survivors(*resume_from);
+        saved = first;
+        next_plan.Draw(first < num_iterations ? num_walkers : 0, k,
+                       config.seed, first);
+    } else {
+        TRACE_SCOPE_ARG("generation", 0);
+        auto start_initial_generation =
+            std::chrono::high_resolution_clock::now();
+
+        initialize_genomes(genomes, num_walkers, config.seed);
+        next_plan.Resize(num_iterations > 1 ? num_walkers : 0);
+        walkers = evaluate_generation(walkers, genomes, plan, next_plan, k, 0,
+                                      stats);
+        stream_survivors(walkers);
+
+        auto end_initial_generation = std::chrono::high_resolution_clock::now();
+        std::cout << "(run_genetic_algorithm): Time to create initial "
+                  << "population: "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         end_initial_generation - start_initial_generation)
+                         .count()
+                  << "ms" << std::endl;
+
+        if (island && island->Due(1, num_iterations)) {
+            island->Migrate(walkers);
+        }
+        if (checkpoint_due(1, num_iterations)) {
+            save_checkpoint(walkers, 1);
+            saved = 1;
+        }
+    }
+    int done = first;
+
+    // run the genetic algorithm for a number of iterations
+    for (int i = first; i < num_iterations && !stop_requested; i++) {
+
+        TRACE_SCOPE_ARG("generation", i);
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::swap(plan, next_plan);
+        genomes = breed_population(walkers, plan);
+        next_plan.Resize(i + 1 < num_iterations ? num_walkers : 0);
+
+        walkers = evaluate_generation(walkers, genomes, plan, next_plan, k, i,
+                                      stats);
+        stream_survivors(walkers);
+
+        if (island && island->Due(i + 1, num_iterations)) {
+            TRACE_SCOPE("migrate");
+            island->Migrate(walkers);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout	<< "(run_genetic_algorithm): Time to run generation " << i
+                        << ": " 
+						<< std::chrono::duration_cast
+							<std::chrono::milliseconds>(end - start).count() 
+						<< "ms (create " << stats.create_ms << "ms, simulate "
+                        << stats.simulate_ms << "ms per thread, select "
+                        << stats.select_ms << "ms, "
+                        << stats.terminated << " terminated early, "
+                        << stats.adopted << " cached";
+        if (coordinator) {
+            std::cout   << ", " << stats.remote << " remote";
+        }
+        if (stats.screened > 0) {
+            std::cout   << ", screened " << stats.screened << " in "
+                        << stats.screen_ms << "ms, rank correlation "
+                        << stats.correlation;
+        }
+        std::cout   << ")" << std::endl;
+
+        create_time += stats.create_ms;
+        simulate_time += stats.simulate_ms;
+        fitness_selection_time += stats.select_ms;
+
+        done = i + 1;
+        if (checkpoint_due(done, num_iterations)) {
+            save_checkpoint(walkers, done);
+            saved = done;
+        }
+    }
+
+    // a stop requested after the last check still gets its checkpoint; one
+    // during the last generation doesn't stop anything, the run is done
+    stopped_early = stop_requested && done < num_iterations;
+    if (stopped_early && saved != done && !config.checkpoint.empty()) {
+        save_checkpoint(walkers, done);
+    }
+
+    return walkers;
+}
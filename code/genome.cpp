@@ -0,0 +1,131 @@
+#include "genome.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "config.h"
+
+GenomeBlock::GenomeBlock(int size)
+{
+	Resize(size);
+}
+
+void GenomeBlock::Resize(int n)
+{
+	size = n;
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		genes[j].resize(n);
+	}
+}
+
+void GenomeBlock::Set(int i, const float speeds[N_LEG_PARAMS])
+{
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		genes[j][i] = speeds[j];
+	}
+}
+
+void GenomeBlock::Get(int i, float speeds[N_LEG_PARAMS]) const
+{
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		speeds[j] = genes[j][i];
+	}
+}
+
+void BreedingPlan::Resize(int n)
+{
+	size = n;
+	parent1.resize(n);
+	parent2.resize(n);
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		take1[j].resize(n);
+		mutation[j].resize(n);
+	}
+}
+
+// every draw is made whether it's used or not, so each child always uses the
+// same part of its stream
+void BreedingPlan::DrawChild(int i, int num_parents, uint64_t seed,
+								int generation)
+{
+	Rng rng(seed, generation, i);
+
+	// randomly select two walkers from the fittest walkers
+	parent1[i] = rng.Index(num_parents);
+	parent2[i] = rng.Index(num_parents);
+
+	// perform crossover with probability config.crossover_probability; for
+	// each gene, select the allele from one of the parents with probability 0.5
+	bool cross = rng.Uniform() < config.crossover_probability;
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		take1[j][i] = !cross || rng.Uniform() < 0.5f;
+	}
+
+	// perform mutation with probability config.mutation_probability
+	bool mutate = rng.Uniform() < config.mutation_probability;
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		float m = rng.Normal(0.0f, config.mutate_size);
+		mutation[j][i] = mutate ? m : 0.0f;
+	}
+}
+
+void BreedingPlan::Draw(int n, int num_parents, uint64_t seed, int generation)
+{
+	Resize(n);
+
+#pragma omp parallel for num_threads(scheduler_threads())
+	for (int i = 0; i < n; i++)
+	{
+		DrawChild(i, num_parents, seed, generation);
+	}
+}
+
+void initialize_genomes(GenomeBlock& genomes, int n, uint64_t seed)
+{
+	genomes.Resize(n);
+	float stdev = (config.max_motor_speed - config.min_motor_speed) / 2;
+
+#pragma omp parallel for num_threads(scheduler_threads())
+	for (int i = 0; i < n; i++)
+	{
+		Rng rng(seed, 0, i);
+		for (int j = 0; j < N_LEG_PARAMS; j++)
+		{
+			genomes.genes[j][i] = rng.Normal(0.0f, stdev);
+		}
+	}
+}
+
+// one pass per joint over the whole population; the loop body has no branches
+// (only selects), so it compiles to gathers and blends
+void breed(const GenomeBlock& parents, const BreedingPlan& plan,
+			GenomeBlock& children)
+{
+	int n = plan.size;
+	children.Resize(n);
+
+	const float lo = config.min_motor_speed, hi = config.max_motor_speed;
+	const int* p1 = plan.parent1.data();
+	const int* p2 = plan.parent2.data();
+
+	for (int j = 0; j < N_LEG_PARAMS; j++)
+	{
+		const float* genes = parents.genes[j].data();
+		const uint8_t* take1 = plan.take1[j].data();
+		const float* mutation = plan.mutation[j].data();
+		float* child = children.genes[j].data();
+
+#pragma omp parallel for simd num_threads(scheduler_threads()) schedule(static)
+		for (int i = 0; i < n; i++)
+		{
+			float gene = take1[i] ? genes[p1[i]] : genes[p2[i]];
+			float mutated = gene + mutation[i];
+			bool in_range = mutated <= hi && mutated >= lo;
+			child[i] = in_range ? mutated : gene;
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// size of the chunks an Arena hands memory out of [bytes]
+#define ARENA_CHUNK_SIZE (4 << 20)
+
+// a bump ("arena") allocator; memory is handed out from large chunks and is
+// never freed piece by piece, only all at once by Arena::Reset()
+//
+// each thread gets its own Arena (Arena::Local()), so threads building walkers
+// under OpenMP never contend on the global heap; Box2D's b2Alloc()/b2Free()
+// hooks (see b2_user_settings.h) and Walker/WalkerWorld construction go
+// through arena_alloc()/arena_free() below
+class Arena
+{
+private:
+	std::vector<char*> chunks;
+	size_t offset;					// first free byte of the last chunk
+	size_t chunk_size;
+
+public:
+	Arena(size_t chunk_size = ARENA_CHUNK_SIZE);
+	~Arena();
+
+	void* Allocate(size_t size);
+	void Reset();
+	size_t Capacity();
+
+	// when disabled, arena_alloc() falls back to malloc()
+	static bool enabled;
+
+	// the calling thread's Arena
+	static Arena* Local();
+
+	// release the memory of every thread's Arena; nothing allocated from an
+	// Arena may be used afterwards
+	static void ResetAll();
+	static size_t CapacityAll();
+};
+
+// while one of these is alive, the calling thread allocates from the heap even
+// with arenas enabled, so that arena_free() really frees what it gets; worlds
+// are stepped under one, since what Box2D allocates while stepping (island
+// arrays that overflow its 100 KB b2StackAllocator in large shards, growing
+// broadphase buffers) it frees again soon, every step for the former, and an
+// Arena would keep all of it until Reset(), which only happens once a run is
+// over (the pool keeps walkers and shards across generations)
+class ArenaBypass
+{
+private:
+	bool bypassed;							// whether an outer one is alive
+
+public:
+	ArenaBypass();
+	~ArenaBypass();
+};
+
+// allocate from the calling thread's Arena (or the heap if arenas are
+// disabled or bypassed); arena_free() is a no-op for memory that came from an
+// Arena
+void* arena_alloc(size_t size);
+void arena_free(void* mem);
+
+// new/delete counterparts of arena_alloc()/arena_free()
+template <typename T, typename... Args>
+T* arena_new(Args&&... args)
+{
+	return new (arena_alloc(sizeof(T))) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+void arena_delete(T* obj)
+{
+	if (obj)
+	{
+		obj->~T();
+		arena_free(obj);
+	}
+}
+
+#endif
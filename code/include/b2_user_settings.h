@@ -0,0 +1,64 @@
+#ifndef B2_USER_SETTINGS_H
+#define B2_USER_SETTINGS_H
+
+// Box2D settings override, used when Box2D (and everything including it) is
+// built with B2_USER_SETTINGS defined (cmake -DBOX2D_USER_SETTINGS=ON); this is
+// Box2D 2.4's b2_settings.h with allocation routed to our per-thread arenas
+// (see arena.h), so worlds built under OpenMP don't all fight over the heap
+//
+// note that this file is included by box2d/b2_settings.h after b2_types.h and
+// b2_api.h, and has to provide everything b2_settings.h would have
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// tunable constants (Box2D defaults)
+#define b2_lengthUnitsPerMeter 1.0f
+#define b2_maxPolygonVertices 8
+
+// user data
+struct B2_API b2BodyUserData
+{
+	b2BodyUserData()
+	{
+		pointer = 0;
+	}
+
+	uintptr_t pointer;
+};
+
+struct B2_API b2FixtureUserData
+{
+	b2FixtureUserData()
+	{
+		pointer = 0;
+	}
+
+	uintptr_t pointer;
+};
+
+struct B2_API b2JointUserData
+{
+	b2JointUserData()
+	{
+		pointer = 0;
+	}
+
+	uintptr_t pointer;
+};
+
+// memory allocation; defined in arena.cpp
+void* b2Alloc(int32 size);
+void b2Free(void* mem);
+
+// logging
+inline void b2Log(const char* string, ...)
+{
+	va_list args;
+	va_start(args, string);
+	vprintf(string, args);
+	va_end(args);
+}
+
+#endif
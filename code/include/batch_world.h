@@ -0,0 +1,102 @@
+#ifndef BATCH_WORLD_H
+#define BATCH_WORLD_H
+
+#include <string>
+#include <vector>
+#include "statics.h"
+
+class Walker;
+
+// the physics engine a run simulates its Walkers with (Config::backend)
+enum PhysicsBackend
+{
+	BACKEND_BOX2D,							// b2Worlds (see walker_world.h)
+	BACKEND_BATCH							// BatchWorlds (see below)
+};
+
+// parse a backend given by name ("box2d" or "batch"); false if unknown
+bool parse_backend(const std::string& name, PhysicsBackend& backend);
+const char* backend_name(PhysicsBackend backend);
+
+// a physics engine for nothing but Walkers: every Walker is the same five
+// boxes (head, then legs) held together by four motorized revolute joints,
+// and all it's made to touch is its flat ground, so a b2World's broadphase,
+// contact graph and islands are all overhead. a BatchWorld instead keeps up to
+// BATCH_WORLD_SIZE Walkers as "lanes" of structure-of-arrays state (one row
+// per quantity, one column per Walker) and steps them in lockstep, every
+// constraint being solved for all lanes at once in a loop the compiler
+// vectorizes (with whatever vectors it's allowed to use, see the Makefile)
+//
+// a step follows b2World::Step() for one island, with Box2D's tuning
+// constants: sequential impulses over the joints (motor, limits, anchors) and
+// the ground contacts (friction, then normal; one per box corner within the
+// contact skin), warm started from the previous step, then position
+// correction until every constraint is within its slop, then sleeping. it
+// solves the normal impulses of a box corner by corner rather than as a block,
+// and it leaves out the contacts between a Walker's own parts that Box2D
+// simulates (a leg against the other legs, a lower leg against the head), so
+// its parts pass through each other where Box2D's would collide; its
+// trajectories are close to Box2D's but not the same (./verify measures how
+// close), and a run's outcome depends on its backend (it's a run setting,
+// see config.h)
+//
+// Walkers keep their b2Bodies, which the BatchWorld reads their state from
+// and writes it back to once the iteration is over (so WalkerState and
+// everything else work as they do with Box2D); Walkers adopting a cached
+// result aren't loaded at all. lanes that are terminated, asleep or unused
+// are masked out rather than skipped, so every lane does exactly the same
+// arithmetic, and a Walker's outcome doesn't depend on which others it was
+// batched with
+class BatchWorld
+{
+private:
+	int n;									// lanes, a multiple of BATCH_WIDTH
+	std::vector<float> block;				// the rows, plus room to align them
+	float* rows;							// aligned to BATCH_WIDTH floats
+	std::vector<Walker*> walkers;			// per lane (nullptr = unused)
+
+	// the same for every lane (see Bodies())
+	float inv_mass[1 + N_LEG_PARAMS];
+	float inv_inertia[1 + N_LEG_PARAMS];
+	float half_x[1 + N_LEG_PARAMS];
+	float half_y[1 + N_LEG_PARAMS];
+	int body_a[N_LEG_PARAMS];				// joint j connects these bodies
+	int body_b[N_LEG_PARAMS];
+	float anchor_ax[N_LEG_PARAMS];			// ...at these local anchors
+	float anchor_ay[N_LEG_PARAMS];
+	float anchor_bx[N_LEG_PARAMS];
+	float anchor_by[N_LEG_PARAMS];
+	float axial_mass[N_LEG_PARAMS];
+	float max_torque;
+	float friction;
+
+	float* Row(int row) { return rows + row * n; }
+
+	void Bodies(Walker* w);
+	void Load(int lane, Walker* w);
+	void Store(int lane);
+
+	int Live();
+	void Collide();
+	void IntegrateVelocities(float dt);
+	void WarmStart();
+	void SolveVelocities(float inv_dt, float max_impulse);
+	void IntegratePositions(float dt);
+	void SolvePositions(int iterations);
+	void Sleep(float dt);
+	void Step(float dt);
+
+	template <int Mask> int Terminate();
+	template <int Mask> void SimulateSteps();
+
+public:
+	// the lanes are walkers[0, count); BatchWorlds are short-lived (one per
+	// batch per iteration), so they live on the stack of whoever steps them
+	BatchWorld(Walker* const* walkers, int count);
+
+	// step every lane for one iteration and record every Walker's state, as
+	// WalkerWorld::Simulate() does
+	void Simulate();
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "statics.h"
+#include "walker.h"
+#include "config.h"
+#include "trajectory_file.h"
+
+// checkpoints of a GA run (.ckpt), enough to carry on where it left off
+// without simulating anything again:
+//
+//   header     CheckpointHeader: the # of generations done and the run's
+//              timers
+//   config     the run's Config, as JSON; random draws are keyed by (seed,
+//              generation, index) (see rng.h), so its seed and the generation
+//              counter are the whole RNG state
+//   survivors  a CheckpointSurvivor (chromosome and most recent state) for
+//              each survivor of the last generation done, fittest first
+//   records    the survivors' lineages, as TrajectoryRecords (see
+//              trajectory_file.h) with node and parent ids; lineages share
+//              their ancestors, so every state is stored once
+//
+// a checkpoint is written to a temporary file that's renamed over the old one
+// once it's complete, so an interrupted write leaves the last checkpoint alone
+//
+// [ASSUME] files are written and read on little-endian machines
+#define CHECKPOINT_MAGIC 0x504B4357u			// "WCKP"
+#define CHECKPOINT_VERSION 2
+
+struct CheckpointHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t record_size;
+
+	int32_t generation;						// # of generations done
+	int32_t reserved;
+
+	// timers [ms]
+	double create_time;
+	double simulate_time;
+	double fitness_selection_time;
+	double elapsed;
+
+	uint64_t config_size;					// bytes of JSON
+	uint64_t n_survivors;
+	uint64_t n_records;
+	float head_size[2];
+	float upper_leg_size[2];
+	float lower_leg_size[2];
+	float mass_density;
+	float max_torque;
+};
+
+struct CheckpointSurvivor
+{
+	uint64_t node;
+	float mspeeds[N_LEG_PARAMS];
+};
+
+// a run as of the end of a generation
+struct Checkpoint
+{
+	Config config;
+	int generation;
+
+	double create_time;
+	double simulate_time;
+	double fitness_selection_time;
+	double elapsed;
+
+	// survivors, fittest first
+	std::vector<WalkerLineage> lineages;
+	std::vector<float> mspeeds;				// N_LEG_PARAMS per survivor
+
+	bool Save(const std::string& fname) const;
+	bool Load(const std::string& fname);
+};
+
+#endif
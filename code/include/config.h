@@ -0,0 +1,112 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <cstdint>
+#include <string>
+#include "nlohmann/json.hpp"
+#include "statics.h"
+#include "selection.h"
+#include "island.h"
+#include "batch_world.h"
+
+// the settings of a run; they start out as the defaults in statics.h, a JSON
+// file (--config) overrides those, and the command line overrides the file, so
+// sweeps don't need a rebuild per configuration
+//
+// a JSON config holds any of the members below, by name; selection,
+// termination, backend and topology are given by name as on the command line
+// (see selection.h, termination.h, batch_world.h and island.h), and giving a
+// seed makes the run seeded
+//
+// the run settings (population, genome, simulation, screening and islands)
+// are what decide the outcome of a run, and they're what a checkpoint keeps;
+// the rest only decide how it's executed and what it writes
+struct Config
+{
+	// population
+	int num_walkers;
+	int num_iterations;						// # of generations
+	float fit_ratio;
+	int shard_size;							// walkers per b2World (0 = own)
+	uint64_t seed;
+	bool seeded;
+	SelectionMode selection;
+	int termination;						// TERMINATE_* mask
+
+	// genome
+	float crossover_probability;
+	float mutation_probability;
+	float mutate_size;						// stdev of a mutation [rad/s]
+	float min_motor_speed;					// [rad/s]
+	float max_motor_speed;
+
+	// simulation
+	float hertz;							// # simulation updates per second
+	int velocity_iterations;				// per step
+	int position_iterations;
+	float iteration_time;					// simulated per generation [s]
+	float gravity;							// [m/s^2]
+	float friction;
+	PhysicsBackend backend;
+
+	// screening (see ga.h)
+	float screen_fraction;					// re-simulated in full (0 = off)
+	float screen_hertz;
+	int screen_velocity_iterations;
+	int screen_position_iterations;
+
+	// islands (see island.h)
+	int islands;							// # of processes (1 = off)
+	int migration_interval;					// generations between migrations
+	int migrants;							// fittest sent per migration
+	MigrationTopology topology;
+
+	// execution and output
+	int threads;							// 0 = every available core
+	bool pin;
+	bool cache;
+	bool dump_json;
+	bool compress;
+	std::string stream;
+	std::string checkpoint;
+	int checkpoint_every;
+	std::string resume;
+	std::string trace;						// Chrome trace (see trace.h)
+	int listen;								// TCP port for workers (0 = off)
+	int spawn_workers;						// # of local workers to fork
+	std::string worker;						// HOST:PORT of a coordinator
+
+	Config();
+
+	float TimeStep() const;
+	int TimeSteps() const;
+
+	// these settings with children simulated at screening fidelity
+	Config Screening() const;
+
+	// whether to evaluate children through the cache (see eval_cache.h)
+	bool Caching() const;
+
+	// take the run settings of another (checkpointed) run, keeping these
+	// execution and output settings
+	void Resume(const Config& run);
+
+	nlohmann::json Serialize() const;
+
+	// override the settings present in a JSON object; false (and a message)
+	// on unknown names, values of the wrong type, or invalid values
+	bool Load(const nlohmann::json& serial);
+	bool Load(const std::string& fname);
+
+	bool Valid() const;
+};
+
+// the settings of this run
+extern Config config;
+
+// fill a Config from the command line (see main.cpp for the usage); --config
+// files are applied first, whatever their position; false (and a message) if
+// the arguments are invalid
+bool parse_args(int argc, char* argv[], Config& c);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef EVAL_CACHE_H
+#define EVAL_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include "statics.h"
+#include "walker.h"
+
+// what an iteration of a child depends on: the exact state it starts in (its
+// parent's most recent snapshot) and its motor speeds; Box2D is deterministic,
+// so two children with the same key end up in the same state, as long as each
+// has a world of its own (or the batch backend), so the cache is only used
+// then (see Config::Caching())
+struct EvalKey
+{
+	WalkerSnapshot start;
+	float mspeeds[N_LEG_PARAMS];
+
+	EvalKey(const WalkerSnapshot& start, const float mspeeds[N_LEG_PARAMS]);
+	bool operator==(const EvalKey& other) const;
+};
+
+struct EvalKeyHash
+{
+	size_t operator()(const EvalKey& key) const;
+};
+
+// the outcome of simulating a key, computed by its owner: the lowest-indexed
+// child of the generation that first asked for it; picking the owner by index
+// rather than by whoever gets there first keeps runs reproducible
+struct EvalEntry
+{
+	int generation;							// generation of the owner
+	int owner;								// index of the owner
+	bool done;								// result is valid
+	int last_used;							// generation of the last lookup
+	WalkerState result;
+};
+
+// what a child has to do with its entry
+enum EvalStatus
+{
+	EVAL_SIMULATE,							// it owns the entry; simulate it
+	EVAL_HIT,								// result of an earlier generation
+	EVAL_DUPLICATE							// another child of this generation
+											// owns the entry
+};
+
+// a concurrent cache of iteration outcomes, split into EVAL_CACHE_STRIPES
+// independently locked hash maps; entries not used for EVAL_CACHE_AGE
+// generations are evicted
+//
+// a generation first Claim()s the entry of every child (in parallel; the
+// only phase that takes locks), then Status() says what each child does;
+// owners fill in their result once simulated, and everyone else adopts it
+// (see Walker::Adopt())
+class EvalCache
+{
+private:
+	struct Stripe
+	{
+		std::mutex lock;
+		std::unordered_map<EvalKey, EvalEntry, EvalKeyHash> entries;
+	};
+	Stripe stripes[EVAL_CACHE_STRIPES];
+
+public:
+	std::atomic<uint64_t> lookups;
+	std::atomic<uint64_t> hits;				// results of earlier generations
+	std::atomic<uint64_t> duplicates;		// results of the same generation
+
+	EvalCache();
+
+	EvalEntry* Claim(const EvalKey& key, int generation, int i);
+	EvalStatus Status(const EvalEntry* entry, int generation, int i);
+	void Evict(int generation);
+	size_t Size();
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef GA_H
+#define GA_H
+
+#include <chrono>
+#include <csignal>
+#include <vector>
+#include "walker.h"
+#include "walker_pool.h"
+#include "genome.h"
+#include "selection.h"
+#include "eval_cache.h"
+#include "trajectory_stream.h"
+#include "checkpoint.h"
+#include "island.h"
+#include "remote.h"
+#include "config.h"
+
+// the genetic algorithm itself, as run by main.cpp (and timed by bench.cpp);
+// everything it needs besides `config` is set up by the caller: the pool
+// (and optionally the cache, stream and checkpoint to resume from) below, the
+// scheduler (see scheduler.h), and the arenas if walkers should come from
+// them (see arena.h)
+
+// when the run started (checkpoints keep the time elapsed since)
+extern std::chrono::high_resolution_clock::time_point program_start;
+
+// thread time spent creating and simulating walkers, and selecting them [ms]
+extern double create_time;
+extern double simulate_time;
+extern double fitness_selection_time;
+
+// with screening on, the time spent screening children [ms] and the sum of
+// every screened generation's rank correlation (see GenerationStats), over
+// the generations screened by this process
+extern double screen_time;
+extern double screen_correlation;
+extern int screened_generations;
+
+// the pool every walker is recycled through
+extern WalkerPool* pool;
+
+// outcomes of earlier simulations (nullptr if disabled; see eval_cache.h)
+extern EvalCache* cache;
+
+// where survivors' lineages are streamed (nullptr if they're only kept in
+// memory; see trajectory_stream.h)
+extern TrajectoryStream* stream;
+
+// the checkpoint the run carries on from (nullptr if it starts from scratch;
+// see checkpoint.h)
+extern Checkpoint* resume_from;
+
+// this process's island, which survivors migrate through (nullptr unless
+// running as one; see island.h)
+extern Island* island;
+
+// the workers children are simulated by (nullptr if they're simulated here;
+// see remote.h)
+extern Coordinator* coordinator;
+
+// set by SIGTERM/SIGINT while checkpointing
+extern volatile sig_atomic_t stop_requested;
+
+// whether the run stopped on a stop request with generations left, the last
+// one done being checkpointed; a stop during the last generation finishes it
+extern bool stopped_early;
+
+void request_stop(int);
+
+// what a generation took: thread time spent creating and simulating walkers
+// (per thread, as the two overlap), time spent selecting the survivors once
+// every walker was evaluated, how many walkers were terminated early, how
+// many took their outcome from the evaluation cache and how many were
+// simulated by workers; with screening, also the time spent screening, how
+// many children were screened, and the Spearman rank correlation between the
+// finalists' screening and full fitness
+struct GenerationStats {
+	double create_ms;
+	double simulate_ms;
+	double select_ms;
+	int terminated;
+	int adopted;
+	int remote;
+	double screen_ms;
+	int screened;							// 0 if the generation wasn't
+	float correlation;
+};
+
+// multi-fidelity evaluation: with config.screen_fraction > 0, every child is
+// first simulated at screening fidelity (config.Screening(): fewer, longer
+// steps with fewer solver iterations), and only the fittest screen_fraction
+// of them (never fewer than the k survivors) are simulated again in full,
+// through the evaluation cache and workers as usual, for the survivors to be
+// selected from; the others are discarded unseen. how well the screening
+// ranks them is measured as the rank correlation between both fidelities
+// among the finalists (the only children simulated at both)
+
+Walker* create_walker(Walker* parent, const GenomeBlock& genomes, int generation,
+						int i);
+float calculate_fitness(Walker* walker);
+std::vector<Walker*> select_fittest(const std::vector<Walker*>& walkers,
+									const std::vector<float>& fitness,
+									const TopK& best, int k, int generation);
+GenomeBlock breed_population(const std::vector<Walker*>& fittest_walkers,
+								const BreedingPlan& plan);
+std::vector<int> screen_children(const std::vector<Walker*>& fittest_walkers,
+									const GenomeBlock& genomes,
+									const BreedingPlan& plan, int n,
+									int generation, std::vector<float>& fitness);
+float rank_correlation(const std::vector<float>& a,
+						const std::vector<float>& b);
+std::vector<Walker*> run_generation(const std::vector<Walker*>& fittest_walkers,
+									const GenomeBlock& genomes,
+									const BreedingPlan& plan,
+									BreedingPlan& next_plan,
+									int k, int generation,
+									GenerationStats& stats,
+									std::vector<float>* fitness = nullptr);
+std::vector<Walker*> evaluate_generation(
+									const std::vector<Walker*>& fittest_walkers,
+									const GenomeBlock& genomes,
+									const BreedingPlan& plan,
+									BreedingPlan& next_plan,
+									int k, int generation,
+									GenerationStats& stats);
+void stream_survivors(const std::vector<Walker*>& survivors);
+void save_checkpoint(const std::vector<Walker*>& survivors, int generation);
+std::vector<Walker*> restore_survivors(const Checkpoint& c);
+bool checkpoint_due(int generation, int num_iterations);
+
+// run the genetic algorithm and return the survivors of the last generation,
+// fittest first
+std::vector<Walker*> run_genetic_algorithm(int num_walkers, int num_iterations,
+											float fit_ratio);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef GENOME_H
+#define GENOME_H
+
+#include <cstdint>
+#include <vector>
+#include "statics.h"
+
+// the chromosomes (motor speeds) of a whole population as a structure of
+// arrays: one contiguous float array per joint (UPPER_LEFT..LOWER_RIGHT), so
+// that breeding runs as vectorized kernels over the population instead of
+// allocating and copying a std::vector<float> per walker
+class GenomeBlock
+{
+public:
+	int size;
+	std::vector<float> genes[N_LEG_PARAMS];
+
+	GenomeBlock(int size = 0);
+	void Resize(int n);
+	void Set(int i, const float speeds[N_LEG_PARAMS]);
+	void Get(int i, float speeds[N_LEG_PARAMS]) const;
+};
+
+// every random decision needed to breed a generation, drawn up front so the
+// breeding kernel itself is branch-free; each child's draws come from its own
+// Rng stream (seed, generation, child index)
+class BreedingPlan
+{
+public:
+	int size;
+	std::vector<int> parent1;				// also the child's starting image
+	std::vector<int> parent2;
+	std::vector<uint8_t> take1[N_LEG_PARAMS];	// 1 if the gene is parent1's
+	std::vector<float> mutation[N_LEG_PARAMS];	// 0 if the gene doesn't mutate
+
+	void Resize(int n);
+	void DrawChild(int i, int num_parents, uint64_t seed, int generation);
+	void Draw(int n, int num_parents, uint64_t seed, int generation);
+};
+
+// random initial chromosomes for generation 0
+void initialize_genomes(GenomeBlock& genomes, int n, uint64_t seed);
+
+// gather both parents of every child, cross them over and mutate the result
+// (mutations that leave the configured motor speed range are rejected)
+void breed(const GenomeBlock& parents, const BreedingPlan& plan,
+			GenomeBlock& children);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include <string>
+#include <vector>
+
+class Walker;
+
+// island model: the population is split into `islands` sub-populations, each
+// evolved by run_genetic_algorithm() in a process of its own (forked from
+// main), so islands don't share a heap, arenas or OpenMP team; every
+// `migration_interval` generations, each island sends copies of its
+// `migrants` fittest survivors (chromosome and whole lineage) to its
+// neighbours, where they replace the least fit survivors before breeding
+//
+// islands only wait on their own neighbours, over Unix socketpairs set up
+// before the fork; there's no global selection. a message is a 64-bit length
+// and a payload, and every island sends before it receives (without blocking),
+// so migrations can't deadlock; an island whose neighbour died carries on
+// without it. island 0 keeps the run's seed and the others derive theirs
+// from it, so a run is reproducible for a given number of islands
+enum MigrationTopology
+{
+	TOPOLOGY_RING,							// island i sends to island i + 1
+	TOPOLOGY_ALL							// every island sends to all others
+};
+
+// parse a topology given by name ("ring" or "all"); false if unknown
+bool parse_topology(const std::string& name, MigrationTopology& topology);
+const char* topology_name(MigrationTopology topology);
+
+// one island's end of the connections, in its own process
+class Island
+{
+private:
+	int id;
+	std::vector<int> in;					// from each neighbour (-1 = gone)
+	std::vector<int> out;					// to each neighbour
+
+public:
+	Island(int id, const std::vector<int>& in, const std::vector<int>& out);
+	~Island();
+
+	int Id() const { return id; }
+
+	// whether to migrate once `generation` generations (of num_iterations)
+	// are done
+	bool Due(int generation, int num_iterations) const;
+
+	// send the fittest survivors to the neighbours, and replace the least fit
+	// ones with theirs; survivors are the last generation's, fittest first
+	void Migrate(std::vector<Walker*>& survivors);
+};
+
+// run the GA on config.islands islands (see above) and return the fittest
+// walker across all of them, rebuilt from its lineage in `pool`; empty (and a
+// message) if no island finished. the timers (see ga.h) become the islands'
+// averages
+std::vector<Walker*> run_islands(int num_walkers, int num_iterations,
+									float fit_ratio);
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "statics.h"
+#include "walker.h"
+#include "trajectory_file.h"
+
+// distributed evaluation: the coordinator (main with --listen or
+// --spawn-workers) keeps the population and does the breeding and selection,
+// and worker processes (main --worker HOST:PORT, on any machine) simulate its
+// children
+//
+// the protocol runs over TCP; every message is a RemoteMessage header and
+// `size` bytes of payload:
+//
+//   config   coordinator -> worker, once it connects: the run's Config as
+//            JSON, so both sides simulate the same way
+//   batch    coordinator -> worker: a uint64_t batch id, then RemoteTasks
+//   results  worker -> coordinator: the batch id, then a RemoteResult per
+//            task, in the same order
+//   bye      coordinator -> worker: the run is over
+//
+// batches of REMOTE_BATCH_SIZE children go to whichever worker has fewer than
+// REMOTE_INFLIGHT batches outstanding, so faster workers take more of them;
+// once none are left to send, a batch that's been outstanding for much longer
+// than usual (REMOTE_STRAGGLER_*) is sent to an idle worker as well, and
+// whichever answers first wins. a worker that disconnects, or that holds a
+// batch for REMOTE_HANG_FACTOR times that long (and at least REMOTE_WAIT_MS),
+// is dropped and has its batches sent to others; whatever no worker took
+// within REMOTE_WAIT_MS, or was left once the last worker was dropped for not
+// answering, is left to the coordinator to simulate
+//
+// workers simulate every child in a world of its own, and so does the
+// coordinator (main forces shard size 0), so a distributed run gives the same
+// walkers however many workers are alive, and the same as a local one without
+// shards (shard size 0), or as any local one with the batch backend
+//
+// [ASSUME] coordinator and workers are the same build on little-endian
+// machines
+#define REMOTE_MAGIC 0x4D455257u				// "WREM"
+
+enum RemoteMessageType
+{
+	REMOTE_CONFIG = 1,
+	REMOTE_BATCH,
+	REMOTE_RESULTS,
+	REMOTE_BYE
+};
+
+struct RemoteMessage
+{
+	uint32_t magic;
+	uint32_t type;
+	uint64_t size;
+};
+
+// a child to simulate: built in the pose of its parent's most recent state
+// (or fresh, in generation 0), with the given chromosome
+struct RemoteTask
+{
+	uint32_t has_parent;
+	float mspeeds[N_LEG_PARAMS];
+	TrajectoryRecord parent;
+};
+
+struct RemoteResult
+{
+	uint32_t terminated;
+	TrajectoryRecord state;
+};
+
+// a connected worker, as the coordinator sees it
+struct RemoteWorker
+{
+	int fd;
+	std::vector<char> input;				// a partial message
+	std::vector<uint64_t> inflight;			// batch ids it holds
+	std::vector<double> sent;				// ...and when each was sent (ms)
+};
+
+class Coordinator
+{
+private:
+	int listener;
+	int port;
+	std::vector<RemoteWorker> workers;
+	std::vector<int> spawned;				// pids of --spawn-workers
+
+	uint64_t next_batch;					// ids are never reused
+
+	// for spotting stragglers
+	double batch_ms;						// sum over answered batches
+	int n_batches;
+
+	double alone_since;						// when the last worker left (ms)
+
+	void Accept();
+
+public:
+	Coordinator();
+	~Coordinator();
+
+	// listen for workers on the given TCP port (0 = any free one)
+	bool Listen(int port);
+	int Port() const { return port; }
+
+	// fork n workers on this machine, with `threads` threads each; must be
+	// called before any OpenMP parallel region
+	bool Spawn(int n, int threads);
+
+	// simulate the tasks on the workers; done[i] tells whether results[i] is
+	// filled in (false for whatever no worker could take)
+	void Evaluate(const std::vector<RemoteTask>& tasks,
+					std::vector<RemoteResult>& results,
+					std::vector<bool>& done);
+
+	// tell every worker the run is over, and wait for the spawned ones (for
+	// REMOTE_WAIT_MS, then they're killed)
+	void Close();
+};
+
+// run as a worker of the coordinator at HOST:PORT until it says bye; false
+// (and a message) if it couldn't be reached or the connection broke
+bool run_worker(const std::string& address);
+
+#endif
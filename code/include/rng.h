@@ -0,0 +1,42 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// counter-based random number generator (Philox4x32-10; Salmon et al.,
+// "Parallel Random Numbers: As Easy as 1, 2, 3", SC'11)
+//
+// every number is a pure function of a key and a counter, so a stream keyed by
+// (seed, generation, walker index) gives the same numbers no matter which
+// thread draws them or in what order the walkers are handled; there's no
+// shared state to race on and no syscalls (unlike std::random_device)
+//
+// walker indices never reach 2^31, so streams with the top bit of the index set
+// are free for draws that belong to the generation rather than to one walker
+#define RNG_GENERATION_STREAM 0x80000000u
+
+class Rng
+{
+private:
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t block[4];
+	int used;								// # of words of block handed out
+	bool has_spare;							// Box-Muller makes normals in pairs
+	float spare;
+
+	void Next();
+
+public:
+	Rng(uint64_t seed, uint32_t generation, uint32_t index);
+
+	uint32_t Uint();
+	float Uniform();						// [0, 1)
+	float Normal(float mean, float stdev);
+	int Index(int n);						// [0, n)
+};
+
+// a seed for runs that weren't given one
+uint64_t random_seed();
+
+#endif
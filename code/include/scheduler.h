@@ -0,0 +1,29 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// how the parallel phases of a generation (breeding, creating, simulating,
+// selecting and dumping walkers) are spread over the cores
+//
+// every phase is an OpenMP loop over num_threads(scheduler_threads()); loops
+// whose iterations take uneven time (stepping a shard whose walkers fell
+// asleep is much cheaper than one whose walkers tumble) use dynamic chunks of
+// scheduler_grain() so that idle threads take work from the shared queue
+// instead of waiting at the barrier
+//
+// the schedule never changes results: every random draw is keyed by walker
+// index (see rng.h) and pool slots are fixed (see walker_pool.h)
+
+// threads <= 0 uses every core available to the process; with pin, OpenMP
+// thread i is bound to the i-th of those cores
+void scheduler_init(int threads, bool pin);
+
+int scheduler_threads();
+bool scheduler_pinned();
+
+// the dynamic chunk size for a loop of n iterations: small enough that there
+// are SCHEDULER_CHUNKS_PER_THREAD chunks for each thread to balance, and a
+// multiple of `multiple` (e.g. the walkers of one shard, which must be built
+// by one thread)
+int scheduler_grain(int n, int multiple = 1);
+
+#endif
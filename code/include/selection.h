@@ -0,0 +1,61 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// how the survivors of a generation are picked from its fitness values;
+// every mode returns indices into the fitness array, fittest first
+enum SelectionMode
+{
+	SELECT_TOP_K,							// the k fittest (truncation)
+	SELECT_TOURNAMENT,						// k tournaments of TOURNAMENT_SIZE
+	SELECT_SUS								// stochastic universal sampling
+};
+
+// a total order on walker indices: higher fitness first, then lower index
+struct FitterThan
+{
+	const float* fitness;
+
+	bool operator()(int a, int b) const
+	{
+		return fitness[a] > fitness[b] || (fitness[a] == fitness[b] && a < b);
+	}
+};
+
+// the k fittest of a stream of walker indices (whose fitness is already in
+// the array), kept as a heap with the least fit survivor on top; each thread
+// fills its own while walkers are simulated, and they're merged at the end
+class TopK
+{
+private:
+	int k;
+	FitterThan fitter;
+	std::vector<int> heap;
+
+public:
+	TopK(int k = 0, const float* fitness = nullptr);
+
+	void Push(int i);
+	void Merge(const TopK& other);
+	std::vector<int> Sorted() const;		// fittest first
+};
+
+bool parse_selection(const std::string& name, SelectionMode& mode);
+const char* selection_name(SelectionMode mode);
+
+// fitness is evaluated once per walker beforehand, so none of these touch the
+// walkers themselves; ties are broken by lower index, so the result doesn't
+// depend on the number of threads
+std::vector<int> select_top_k(const std::vector<float>& fitness, int k);
+std::vector<int> select_tournament(const std::vector<float>& fitness, int k,
+									uint64_t seed, int generation);
+std::vector<int> select_sus(const std::vector<float>& fitness, int k,
+									uint64_t seed, int generation);
+
+std::vector<int> select(SelectionMode mode, const std::vector<float>& fitness,
+									int k, uint64_t seed, int generation);
+
+#endif
@@ -18,6 +18,68 @@
 #define GROUND_SIZE_Y 5.0f
 #define FRICTION_COEFF 0.05f
 
+// shared-world (batched) simulation; walkers in the same b2World each get their
+// own "lane", a copy of the ground stacked vertically WORLD_LANE_SPACING apart,
+// so they never overlap in the broadphase (the farther a lane is from y = 0,
+// the coarser its floats, see WalkerWorld::LaneOrigin())
+#define WORLD_SHARD_SIZE 64                             // walkers per b2World (0 = one world per walker)
+#define WORLD_LANE_SPACING 20.0f                        // vertical distance between lanes [m]
+#define GROUND_CATEGORY 0x0001                          // collision filter bits
+#define WALKER_CATEGORY 0x0002
+
+// batch physics backend (see batch_world.h)
+#define BATCH_WORLD_SIZE 64                             // walkers stepped in lockstep per BatchWorld
+#define BATCH_WIDTH 16                                  // lanes are padded to this (AVX-512 floats)
+
+// parallel scheduling (see scheduler.h)
+#define SCHEDULER_CHUNKS_PER_THREAD 8                   // dynamic chunks per thread to balance load
+
+// early termination (see termination.h)
+#define TERMINATE_HEAD_Y (HEAD_SIZE_X / 2 + 0.5f)       // head height (above its lane's ground) of a fallen walker [m]
+#define TERMINATE_STALL_STEPS 20                        // time steps without progress before a walker has stalled
+#define TERMINATE_STALL_DX 0.01f                        // x distance that counts as progress [m]
+
+// evaluation cache (see eval_cache.h)
+#define EVAL_CACHE_STRIPES 64                           // independently locked parts of the cache
+#define EVAL_CACHE_AGE 2                                // generations an unused entry is kept
+
+// multi-fidelity screening (see ga.h)
+#define SCREEN_FRACTION 0.0f                            // children re-simulated at full fidelity (0 = no screening)
+#define SCREEN_HERTZ 30.0f                              // screening simulation updates per second
+#define SCREEN_VEL_ITER 4                               // screening velocity iterations per step
+#define SCREEN_POS_ITER 2                               // screening position iterations per step
+
+// trajectory streaming (see trajectory_stream.h)
+#define TRAJECTORY_STREAM_QUEUE 4096                    // records in flight to the I/O thread
+#define TRAJECTORY_STREAM_BACKLOG 65536                 // records waiting for room in the queue before the GA waits
+#define TRAJECTORY_STREAM_KEEP 2                        // states kept in memory per lineage once streamed
+
+// trajectory compression (see trajectory_codec.h)
+#define TRAJECTORY_CODEC_BLOCK 64                       // states per bit-packed block
+#define CODEC_POSITION_STEP 1e-4f                       // quantization steps (max. error is half) [m]
+#define CODEC_ANGLE_STEP 1e-4f                          // [rad]
+#define CODEC_VELOCITY_STEP 1e-3f                       // [m/s], [rad/s]
+#define CODEC_SPEED_STEP 0.0f                           // motor speeds (0 = exact, replays need them)
+
+// checkpointing (see checkpoint.h)
+#define CHECKPOINT_INTERVAL 50                          // generations between checkpoints
+
+// island model (see island.h)
+#define ISLAND_MIGRATION_INTERVAL 10                    // generations between migrations
+#define ISLAND_MIGRANTS 2                               // fittest walkers each island sends
+
+// distributed evaluation (see remote.h)
+#define REMOTE_BATCH_SIZE 32                            // walkers per batch sent to a worker
+#define REMOTE_INFLIGHT 2                               // batches a worker holds at once
+#define REMOTE_STRAGGLER_FACTOR 4.0                     // x the average batch time before a batch is resent
+#define REMOTE_STRAGGLER_MIN_MS 200                     // ...and never before this long [ms]
+#define REMOTE_HANG_FACTOR 10.0                         // x the straggler limit before a worker is given up on
+#define REMOTE_WAIT_MS 10000                            // how long to wait for a worker [ms]
+#define REMOTE_POLL_MS 20                               // how often stragglers are checked for [ms]
+
+// tracing (see trace.h)
+#define TRACE_BUFFER_EVENTS (1 << 16)                   // events kept per thread
+
 // computation parameters
 #define SIM_HERTZ 60.0f                                 // # simulation updates per second
 #define SIM_TIMESTEP 1.0f / SIM_HERTZ                   // simulation time step [s]
@@ -55,4 +117,8 @@
 
 #define FITTEST_RATIO 0.3f
 
+// selection (see selection.h)
+#define SELECTION_BLOCK 4096                            // walkers per top-k partition block
+#define TOURNAMENT_SIZE 4                               // walkers drawn per tournament
+
 #endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef TERMINATION_H
+#define TERMINATION_H
+
+#include <string>
+#include "box2d/box2d.h"
+
+// predicates that stop simulating a Walker before the end of an iteration;
+// a terminated Walker's bodies are disabled (so b2World::Step() skips them)
+// and it keeps the state, and so the fitness, it had when it was terminated
+#define TERMINATE_CONTACT 0x1				// its head touched the ground
+#define TERMINATE_HEIGHT 0x2				// its head fell below TERMINATE_HEAD_Y
+#define TERMINATE_SLEEP 0x4					// all of its bodies are asleep
+#define TERMINATE_STALL 0x8					// no x progress in TERMINATE_STALL_STEPS
+#define TERMINATE_DEFAULT (TERMINATE_CONTACT | TERMINATE_SLEEP)
+#define TERMINATE_ALL 0xF
+
+// the predicates in use are a mask of the above (Config::termination); the
+// time-step loops are templates on the mask, so that the predicates left out
+// cost nothing, and this is the table of their 16 instantiations that a loop
+// is picked from once per iteration
+#define TERMINATION_TABLE(f) { \
+	&f<0x0>, &f<0x1>, &f<0x2>, &f<0x3>, &f<0x4>, &f<0x5>, &f<0x6>, &f<0x7>, \
+	&f<0x8>, &f<0x9>, &f<0xA>, &f<0xB>, &f<0xC>, &f<0xD>, &f<0xE>, &f<0xF> }
+
+// parse a comma separated list of predicate names (contact, height, sleep,
+// stall) or "none"
+bool parse_termination(const std::string& names, int& mask);
+std::string termination_names(int mask);
+
+// flags a Walker whose head starts touching the ground; its own legs touching
+// it don't count; it has no state of its own, so every world we own shares the
+// one instance
+class HeadContactListener : public b2ContactListener
+{
+public:
+	static bool Ground(b2Fixture* other);
+	void BeginContact(b2Contact* contact);
+};
+
+extern HeadContactListener head_contact_listener;
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include "statics.h"
+
+// scoped timing of the hot paths (building, simulating, selecting, breeding,
+// I/O), written as a Chrome trace (chrome://tracing or ui.perfetto.dev) with
+// one row per thread, so imbalance and serialization inside the OpenMP
+// regions show up
+//
+// every thread records into a ring buffer of its own (TRACE_BUFFER_EVENTS
+// events, the oldest overwritten first), so recording never takes a lock; a
+// buffer outlives its thread, so trace_write() still sees threads that are
+// gone, but it must not run while threads are still recording
+//
+// it's only compiled in with WALKER_TRACE (`make TRACE=1`); otherwise the
+// macros below are empty and nothing is recorded
+
+struct TraceEvent
+{
+	const char* name;						// a string literal
+	uint64_t start;							// [ns] since the trace started
+	uint64_t duration;						// [ns]
+	int64_t arg;							// shown as "n" (-1 = none)
+};
+
+#ifdef WALKER_TRACE
+
+// records an event from its construction to its destruction
+class TraceScope
+{
+private:
+	const char* name;
+	int64_t arg;
+	uint64_t start;
+
+public:
+	TraceScope(const char* name, int64_t arg = -1);
+	~TraceScope();
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// time the rest of the enclosing scope, optionally tagged with a number (e.g.
+// the first walker of a shard)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg) \
+	TraceScope TRACE_CONCAT(trace_, __LINE__)(name, arg)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_ARG(name, arg)
+
+#endif
+
+// start recording (nothing is recorded until then); false (and a message) if
+// tracing isn't compiled in
+bool trace_start();
+
+// write what every thread recorded as a Chrome trace (JSON); false (and a
+// message) if it couldn't be written
+bool trace_write(const std::string& fname);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef TRAJECTORY_CODEC_H
+#define TRAJECTORY_CODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "statics.h"
+#include "walker.h"
+#include "trajectory_file.h"
+
+// compressed trajectories (.trajz), for archiving lineages; consecutive states
+// of a lineage barely differ, so every field of a TrajectoryRecord is
+//
+//   1. quantized: rounded to a multiple of the step of its kind (position,
+//      angle, velocity, motor speed), so it's off by at most step / 2 (or by
+//      the precision of a float of its size, if that's coarser); a step
+//      of 0 keeps the field exact (its float bits are used instead)
+//   2. delta encoded against the same field of the previous state
+//   3. bit packed: states are cut into blocks of TRAJECTORY_CODEC_BLOCK, and in
+//      every block each field stores its first value and then its deltas,
+//      zigzagged, using only as many bits as the largest one needs
+//
+// quantizing before taking deltas means errors don't add up along a lineage;
+// a value that can't be quantized (not finite, or too large for its step)
+// makes its field exact for the rest of its block
+//
+// the file is a TrajectoryCodecHeader (which keeps the run's simulation
+// settings, like a .traj's) followed by the packed blocks; node and parent ids
+// aren't kept, a .trajz holds a single lineage, oldest state first
+//
+// [ASSUME] files are written and read on little-endian machines
+#define TRAJECTORY_CODEC_MAGIC 0x5A525457u	// "WTRZ"
+#define TRAJECTORY_CODEC_VERSION 2
+#define TRAJECTORY_CODEC_EXTENSION ".trajz"
+
+// quantization steps by kind of field (0 = exact)
+struct TrajectoryQuantization
+{
+	float position;							// [m]
+	float angle;							// [rad]
+	float velocity;							// [m/s], [rad/s]
+	float speed;							// motor speeds [rad/s]
+};
+
+const TrajectoryQuantization defaultQuantization = {
+	CODEC_POSITION_STEP,
+	CODEC_ANGLE_STEP,
+	CODEC_VELOCITY_STEP,
+	CODEC_SPEED_STEP
+};
+
+struct TrajectoryCodecHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t n_fields;
+	uint64_t n_states;
+	uint64_t payload_size;
+	TrajectoryQuantization steps;
+	float head_size[2];
+	float upper_leg_size[2];
+	float lower_leg_size[2];
+	float mass_density;
+	float max_torque;
+	TrajectorySimulation simulation;
+};
+
+// compress a lineage (all states are assumed to share their WalkerParameters)
+std::vector<uint8_t> encode_trajectory(const std::vector<WalkerState>& states,
+										const TrajectoryQuantization& q
+											= defaultQuantization);
+
+// decompress what encode_trajectory() made (and the run's simulation settings,
+// if asked for); false if the data is malformed
+bool decode_trajectory(const uint8_t* data, size_t size,
+						std::vector<WalkerState>& states,
+						TrajectorySimulation* simulation = nullptr);
+
+bool write_compressed(const std::string& fname,
+						const std::vector<WalkerState>& states,
+						const TrajectoryQuantization& q = defaultQuantization);
+bool read_compressed(const std::string& fname,
+						std::vector<WalkerState>& states,
+						TrajectorySimulation* simulation = nullptr);
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef TRAJECTORY_FILE_H
+#define TRAJECTORY_FILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "statics.h"
+#include "walker.h"
+
+// binary trajectory files (.traj); a file holds a tree of WalkerStates: every
+// record names its own node id and its parent's, so one file can hold a single
+// lineage (oldest state first, as Walker::Dump() writes it) or the lineages
+// of many Walkers streamed during a run (see trajectory_stream.h)
+//
+//   header   TrajectoryHeader: magic, version, sizes, the WalkerParameters
+//            shared by every state (stored once instead of once per state),
+//            and the run's simulation settings, to replay it the same way
+//   records  one fixed-width TrajectoryRecord per WalkerState
+//   index    the file offset of every record (uint64 each)
+//   trailer  TrajectoryTrailer: where the index starts, # of records, magic
+//
+// fixed-width records and the index let a reader map the file and use the
+// records in place, without parsing anything; the trailer is written last, so
+// a file whose writer didn't finish (e.g. the run crashed) is recognized as
+// truncated, and its complete records are still read
+//
+// node ids are the 1-based position of the record in the file, and parents
+// always come before their children; 0 is "no parent"
+//
+// [ASSUME] files are written and read on little-endian machines
+#define TRAJECTORY_MAGIC 0x4A525457u		// "WTRJ"
+#define TRAJECTORY_END_MAGIC 0x444E4557u	// "WEND"
+#define TRAJECTORY_VERSION 3
+#define TRAJECTORY_EXTENSION ".traj"
+
+struct Config;
+
+// the settings of a Config that decide how a state's iteration was simulated
+struct TrajectorySimulation
+{
+	float hertz;
+	int32_t velocity_iterations;
+	int32_t position_iterations;
+	float iteration_time;
+	float gravity;
+	float friction;
+	int32_t termination;
+	int32_t backend;
+};
+
+TrajectorySimulation pack_simulation(const Config& c);
+void unpack_simulation(const TrajectorySimulation& s, Config& c);
+
+struct TrajectoryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t record_size;
+	float head_size[2];
+	float upper_leg_size[2];
+	float lower_leg_size[2];
+	float mass_density;
+	float max_torque;
+	TrajectorySimulation simulation;
+};
+
+// one body of a WalkerSnapshot
+struct TrajectoryBody
+{
+	float position[2];
+	float angle;
+	float linear_velocity[2];
+	float angular_velocity;
+};
+
+// one WalkerState, minus its WalkerParameters
+struct TrajectoryRecord
+{
+	uint64_t node;
+	uint64_t parent;
+	int32_t state_index;
+	float head_world_center[2];
+	float head_angle;
+	float legs_world_center[N_LEG_PARAMS][2];
+	float legs_angle[N_LEG_PARAMS];
+	float mspeeds[N_LEG_PARAMS];
+	float jspeeds[N_LEG_PARAMS];
+	float jangles[N_LEG_PARAMS];
+
+	// WalkerSnapshot (its motor speeds are the ones above)
+	TrajectoryBody head;
+	TrajectoryBody legs[N_LEG_PARAMS];
+	float max_torque;
+	uint32_t awake;
+};
+
+struct TrajectoryTrailer
+{
+	uint64_t index_offset;
+	uint64_t n_records;
+	uint32_t version;
+	uint32_t magic;
+};
+
+TrajectoryRecord pack_state(const WalkerState& state);
+WalkerState unpack_state(const TrajectoryRecord& record,
+							const WalkerParameters& wp);
+
+// writes a .traj file one state at a time
+class TrajectoryWriter
+{
+private:
+	std::ofstream out;
+	uint64_t n_records;						// records are fixed width, so the
+											// index follows from the count
+
+public:
+	bool Open(const std::string& fname, const WalkerParameters& wp);
+	void Write(const WalkerState& state);	// the next state of one lineage
+	void Write(const TrajectoryRecord& record);
+	void Flush();
+	bool Close();
+};
+
+// a .traj file mapped into memory; records are read in place
+class TrajectoryFile
+{
+private:
+	void* map;
+	size_t map_size;
+	const TrajectoryHeader* header;
+	const uint64_t* index;
+	uint64_t n_records;
+
+public:
+	WalkerParameters wp;
+	TrajectorySimulation simulation;		// see unpack_simulation()
+
+	TrajectoryFile();
+	~TrajectoryFile();
+
+	bool Open(const std::string& fname);
+	void Close();
+
+	size_t Size() const;
+	const TrajectoryRecord& Record(size_t i) const;
+	WalkerState State(size_t i) const;
+	std::vector<WalkerState> States() const;
+
+	// the states from the root of the tree down to the given node
+	std::vector<WalkerState> Lineage(uint64_t node) const;
+};
+
+#endif
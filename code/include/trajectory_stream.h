@@ -0,0 +1,88 @@
+#ifndef TRAJECTORY_STREAM_H
+#define TRAJECTORY_STREAM_H
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "statics.h"
+#include "walker.h"
+#include "trajectory_file.h"
+
+// a bounded single-producer single-consumer ring buffer; neither side ever
+// waits on the other, TryPush() just fails when the ring is full
+template <typename T, int N>
+class SpscQueue
+{
+private:
+	T items[N];
+	std::atomic<uint64_t> head;				// next to pop (consumer)
+	std::atomic<uint64_t> tail;				// next to push (producer)
+
+public:
+	SpscQueue() : head(0), tail(0) {}
+
+	bool TryPush(const T& item)
+	{
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N) return false;
+		items[t % N] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& item)
+	{
+		uint64_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		item = items[h % N];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+// streams the lineages of a run to a trajectory file (see trajectory_file.h)
+// while it runs: every generation, the states its survivors added since the
+// last generation are handed to a background I/O thread; the GA thread only
+// packs records and doesn't wait on the disk (if the queue is full, records
+// wait in a backlog until the next Append(); only once the backlog holds
+// TRAJECTORY_STREAM_BACKLOG records does the GA thread wait, and say so)
+//
+// once streamed, a lineage can be truncated to the states children still need
+// (TRAJECTORY_STREAM_KEEP), so memory doesn't grow with the number of
+// generations; full lineages are read back with TrajectoryFile::Lineage()
+class TrajectoryStream
+{
+private:
+	TrajectoryWriter writer;
+	SpscQueue<TrajectoryRecord, TRAJECTORY_STREAM_QUEUE> queue;
+	std::deque<TrajectoryRecord> backlog;
+	bool stalled;							// the backlog filled up once
+	std::atomic<bool> closing;
+	std::thread io;
+	uint64_t next_id;
+
+	void Run();
+	void Drain();
+	void Push(const TrajectoryRecord& record);
+
+public:
+	std::string fname;
+
+	TrajectoryStream();
+	~TrajectoryStream();
+
+	bool Open(const std::string& fname, const WalkerParameters& wp);
+
+	// stream the states of a lineage that haven't been streamed yet; returns
+	// the node id of its most recent state
+	uint64_t Append(const WalkerLineage& lineage);
+
+	// wait for everything to be written and finish the file
+	bool Close();
+
+	uint64_t Records();
+};
+
+#endif
@@ -1,10 +1,15 @@
 #ifndef WALKER_H
 #define WALKER_H
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 #include "box2d/box2d.h"
 #include "nlohmann/json.hpp"
 #include "statics.h"
+#include "arena.h"
+#include "termination.h"
 
 // true if index is referring to the upper legs
 #define is_upper_leg(i) i < 2
@@ -12,7 +17,7 @@
 // get the index of the upper part of the same-sided leg
 #define get_upper_leg(i) i < 2 ? 0 : (i-2)
 
-#define DEFAULT_DUMP_FNAME "trajectory.json"
+#define DEFAULT_DUMP_FNAME "trajectory.traj"
 
 // this struct defines the physical parameters of a Walker; these parameters
 // do *not* change between Walker::Simulate() calls
@@ -37,6 +42,36 @@ const WalkerParameters defaultParameters = {
 };
 
 class Walker;
+class WalkerWorld;
+
+// full physical state of one body, relative to its Walker's lane origin
+struct BodySnapshot
+{
+	b2Vec2 position;
+	float angle;
+	b2Vec2 linearVelocity;
+	float angularVelocity;
+};
+
+// everything needed to put a Walker's bodies and joint motors back exactly the
+// way they were, in a single pass and without destroying/creating anything;
+// note that Box2D keeps contact and joint impulses for warm starting that
+// can't be captured, so a restored Walker continues its parent's physics from
+// the exact same pose and velocities, but without its warm-start history
+struct WalkerSnapshot
+{
+	BodySnapshot head;
+	BodySnapshot legs[N_LEG_PARAMS];
+	float mspeeds[N_LEG_PARAMS];			// set motor angular speed
+	float max_torque;
+	bool awake;
+
+	WalkerSnapshot();
+	WalkerSnapshot(Walker* base);
+	WalkerSnapshot(nlohmann::json serial);
+	void Restore(Walker* target) const;
+	nlohmann::json Serialize();
+};
 
 // data needed to reconstruct simulations; Box2D is reportedly deterministic
 // (https://box2d.org/documentation/md__d_1__git_hub_box2d_docs__f_a_q.html)
@@ -55,21 +90,68 @@ public:
 	float jspeeds[N_LEG_PARAMS];			// joint angular speed
 	float jangles[N_LEG_PARAMS];			// joint angles
 	int state_index;
+	WalkerSnapshot snapshot;				// exact state, for restoring
 	
 	WalkerState();
 	WalkerState(Walker* base);
 	WalkerState(nlohmann::json serial);
 	nlohmann::json Serialize();
-	WalkerState Diff(WalkerState cmp);
+	WalkerState Diff(const WalkerState& cmp) const;
 	void Print();
 };
 
+// a state in the lineage tree, pointing back at the state it followed
+struct LineageNode
+{
+	WalkerState state;
+	mutable std::shared_ptr<const LineageNode> parent;
+	mutable uint64_t id;					// node id once streamed, else 0
+
+	LineageNode(const WalkerState& s, std::shared_ptr<const LineageNode> p);
+	~LineageNode();
+};
+
+// the history of WalkerStates leading up to a Walker, as a persistent linked
+// list: copying a WalkerLineage is O(1) and pushing onto a copy leaves the
+// original alone, so children share their ancestry with their parent (and
+// siblings) instead of each copying it; nodes are reference counted, so dead
+// branches are freed as soon as nobody descends from them
+//
+// the interface mimics the std::vector<WalkerState> it replaced
+class WalkerLineage
+{
+private:
+	std::shared_ptr<const LineageNode> tip;
+
+public:
+	WalkerLineage();
+	explicit WalkerLineage(const std::vector<WalkerState>& image);
+
+	void push_back(const WalkerState& s);
+	void pop_back();
+	const WalkerState& back() const;
+	size_t size() const;					// states still in memory, O(n)
+	bool empty() const;
+	void clear();
+
+	// all states still in memory, oldest first
+	std::vector<WalkerState> Unroll() const;
+
+	const LineageNode* Tip() const;
+
+	// forget all but the most recent `keep` states (e.g. once they've been
+	// streamed to disk); size() and Unroll() only see the ones kept
+	void Truncate(size_t keep);
+};
+
 class Walker
 {
 private:
 	// box2d world objects
 	b2World *world;
 	b2Body *groundBody;
+	WalkerWorld *shard;				// non-null if the world is shared
+	bool owns_world;
 
 	// box2d walker objects
 	b2BodyDef headDef;
@@ -81,17 +163,29 @@ private:
 	b2RevoluteJointDef jointsDef[N_LEG_PARAMS];
 
 	void Exist(b2World *w = nullptr);
+	void Exist(WalkerWorld *s);
+	b2Filter Filter();
 	void Build_Head(WalkerParameters wp);
 	void Build_Legs(WalkerParameters wp);
 	void Build_Joints(WalkerParameters wp);
 	void Build(WalkerParameters wp = defaultParameters);
+	void Build(WalkerLineage image);
+	void ClearTermination();
+	template <int Mask> void SimulateSteps();
+
+	friend class WalkerWorld;
 
 public:
 	WalkerParameters params;
 	b2Body *head;
 	b2Body *legs[N_LEG_PARAMS];
 	b2RevoluteJoint *joints[N_LEG_PARAMS];
-	std::vector<WalkerState> states;
+	WalkerLineage states;
+
+	// lane within a shared WalkerWorld and the world position of that lane's
+	// origin; positions in WalkerState are always relative to the origin
+	int lane;
+	b2Vec2 origin;
 
 	// set motor speeds per joint; note that the actual angular speed of a joint
 	// is dependent on the motor's torque; 'mspeed' refers to the explicitly
@@ -99,21 +193,90 @@ public:
 	// gets the actual speed
 	float mspeeds[N_LEG_PARAMS];
 
+	// early termination within the current iteration (see termination.h)
+	bool terminated;
+	bool adopted;							// this iteration's state came from
+											// an identical simulation
+	bool head_contact;						// set by HeadContactListener
+	float stall_x;							// head x at the last progress
+	int stall_steps;						// time steps since then
+
 	Walker(WalkerParameters wp = defaultParameters, b2World* w0 = nullptr);
 	Walker(std::vector<WalkerState> image, b2World* w0 = nullptr);
+	Walker(WalkerLineage image, b2World* w0 = nullptr);
+	Walker(WalkerWorld* s, WalkerParameters wp = defaultParameters);
+	Walker(WalkerLineage image, WalkerWorld* s);
 	~Walker();
 
+	// Walkers are allocated from the constructing thread's Arena
+	static void* operator new(size_t size) { return arena_alloc(size); }
+	static void operator delete(void* mem) { arena_free(mem); }
+
+	void Reset(WalkerLineage image);
+
 	// functions needed for GA
 	std::vector<float> GetMotorSpeeds();
 	void SetMotorSpeeds(float mUpperLeft, float mUpperRight, 
 						float mLowerLeft, float mLowerRight);
+	// note that for a Walker in a shared WalkerWorld this steps every Walker in
+	// the shard; use WalkerWorld::Simulate() instead
 	void Simulate();
+	void Record();
+	template <int Mask> bool CheckTermination();
+	void Terminate();
+	void Park();
+	void Adopt(const WalkerState& result);
 	float GetPositionX();
 	float GetPositionY();
 	float GetVelocityX();
 	float GetVelocityY();
 
+	// binary trajectory (see trajectory_file.h), unless fname ends in .json
 	void Dump(bool use_default_fname = true);
+	void Dump(const std::string& fname);
+	void DumpJSON(const std::string& fname);
 };
 
+// check the termination predicates in Mask after a time step
+template <int Mask>
+bool Walker::CheckTermination()
+{
+	if ((Mask & TERMINATE_CONTACT) && head_contact)
+	{
+		return true;
+	}
+
+	if ((Mask & TERMINATE_HEIGHT) &&
+		GetPositionY() < GROUND_Y + TERMINATE_HEAD_Y)
+	{
+		return true;
+	}
+
+	if (Mask & TERMINATE_SLEEP)
+	{
+		bool asleep = !head->IsAwake();
+		for (int i = 0; i < N_LEG_PARAMS && asleep; i++)
+		{
+			asleep = !legs[i]->IsAwake();
+		}
+		if (asleep) return true;
+	}
+
+	if (Mask & TERMINATE_STALL)
+	{
+		float x = head->GetPosition().x;
+		if (x > stall_x + TERMINATE_STALL_DX)
+		{
+			stall_x = x;
+			stall_steps = 0;
+		}
+		else if (++stall_steps >= TERMINATE_STALL_STEPS)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 #endif
\ No newline at end of file
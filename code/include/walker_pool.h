@@ -0,0 +1,44 @@
+#ifndef WALKER_POOL_H
+#define WALKER_POOL_H
+
+#include <vector>
+#include "statics.h"
+#include "walker.h"
+#include "walker_world.h"
+
+// recycles Walkers (and with them their worlds, bodies, fixtures and joints)
+// between generations instead of deleting and reallocating them
+//
+// the pool holds two buffers of num_walkers slots; generation g lives in
+// buffer g % 2 while its survivors breed generation g + 1 into the other, so a
+// slot is only reused once its previous occupant is dead; slot i of a buffer
+// always lives in the same shard and lane, which keeps runs reproducible
+class WalkerPool
+{
+private:
+	int shard_size;
+	std::vector<Walker*> slots[2];
+	std::vector<WalkerWorld*> shards[2];
+
+public:
+	WalkerPool(int num_walkers, int shard_size = WORLD_SHARD_SIZE);
+	~WalkerPool();
+
+	// walker i of the given generation; an empty image gives a fresh Walker
+	Walker* Acquire(int generation, int i,
+					WalkerLineage image = WalkerLineage());
+
+	// the shared worlds of a generation (empty if walkers have their own);
+	// shards nobody has acquired a walker from yet are nullptr
+	std::vector<WalkerWorld*>& Shards(int generation);
+
+	// the shard walker i of the given generation lives in (nullptr if walkers
+	// have their own worlds)
+	WalkerWorld* Shard(int generation, int i);
+
+	// the OpenMP chunk size to use when acquiring walkers; a b2World is not
+	// thread-safe, so all walkers of a shard must be acquired by one thread
+	int Chunk();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef WALKER_WORLD_H
+#define WALKER_WORLD_H
+
+#include <vector>
+#include "box2d/box2d.h"
+#include "statics.h"
+#include "walker.h"
+#include "arena.h"
+
+// a single b2World shared by a "shard" of Walkers, so that one b2World::Step()
+// moves all of them at once
+//
+// every Walker gets its own lane: a copy of the ground stacked vertically
+// WORLD_LANE_SPACING apart from its neighbours; all lanes belong to one static
+// ground body; lanes keep Walkers out of each others' broadphase, and collision
+// filtering keeps them from ever touching in case one of them leaves its lane:
+// Walkers don't collide with each other (see Walker::Filter()), and every
+// fixture carries its lane + 1 as user data so that a Walker falling off its
+// ground can't land on another lane's (see LaneContactFilter)
+class WalkerWorld
+{
+public:
+	b2World *world;
+	b2Body *groundBody;
+	std::vector<Walker*> lanes;		// nullptr if the lane is free
+
+	WalkerWorld(int capacity = WORLD_SHARD_SIZE);
+	~WalkerWorld();
+
+	// allocated from the constructing thread's Arena, like the Walkers
+	static void* operator new(size_t size) { return arena_alloc(size); }
+	static void operator delete(void* mem) { arena_free(mem); }
+
+	int Claim(Walker* w);
+	void Release(Walker* w);
+	b2Vec2 LaneOrigin(int lane);
+	int Size();
+
+	// step the shard for one iteration and record every Walker's state
+	void Simulate();
+	int Running();
+	template <int Mask> int Terminate();
+	template <int Mask> void SimulateSteps();
+};
+
+// rejects contacts between fixtures of different lanes (their user data is
+// lane + 1, or 0 outside of lanes), and otherwise filters as Box2D does; it
+// has no state of its own, so every shard shares the one instance
+class LaneContactFilter : public b2ContactFilter
+{
+public:
+	bool ShouldCollide(b2Fixture* a, b2Fixture* b);
+};
+
+extern LaneContactFilter lane_contact_filter;
+
+#endif
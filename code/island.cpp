@@ -0,0 +1,490 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "island.h"
+#include "ga.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "trajectory_file.h"
+
+bool parse_topology(const std::string& name, MigrationTopology& topology)
+{
+	if (name == "ring") topology = TOPOLOGY_RING;
+	else if (name == "all") topology = TOPOLOGY_ALL;
+	else return false;
+	return true;
+}
+
+const char* topology_name(MigrationTopology topology)
+{
+	return topology == TOPOLOGY_ALL ? "all" : "ring";
+}
+
+// the payload of a message: a header, then for each walker an IslandWalker
+// followed by its lineage, oldest state first
+struct IslandHeader
+{
+	uint32_t n_walkers;
+	uint32_t stopped;	// stopped early (see stopped_early)
+
+	// timers of the island's whole run [ms] (results only)
+	double create_time;
+	double simulate_time;
+	double fitness_selection_time;
+};
+
+struct IslandWalker
+{
+	float fitness;
+	float mspeeds[N_LEG_PARAMS];
+	uint32_t n_states;
+};
+
+// a walker as it travels between processes
+struct IslandMigrant
+{
+	float fitness;
+	float mspeeds[N_LEG_PARAMS];
+	WalkerLineage lineage;
+};
+
+static void append(std::vector<char>& buffer, const void* data, size_t size)
+{
+	const char* p = (const char*)data;
+	buffer.insert(buffer.end(), p, p + size);
+}
+
+// a length-prefixed message holding the given walkers
+static std::vector<char> pack_walkers(const std::vector<Walker*>& walkers,
+										const IslandHeader& header)
+{
+	std::vector<char> payload;
+	append(payload, &header, sizeof(header));
+	for (Walker* w : walkers)
+	{
+		std::vector<WalkerState> states = w->states.Unroll();
+
+		IslandWalker iw;
+		memset(&iw, 0, sizeof(iw));
+		float f = calculate_fitness(w);
+		iw.fitness = (f == f) ? f : -INFINITY;
+		memcpy(iw.mspeeds, w->mspeeds, sizeof(iw.mspeeds));
+		iw.n_states = states.size();
+		append(payload, &iw, sizeof(iw));
+
+		for (const WalkerState& s : states)
+		{
+			TrajectoryRecord r = pack_state(s);
+			append(payload, &r, sizeof(r));
+		}
+	}
+
+	uint64_t size = payload.size();
+	std::vector<char> message;
+	append(message, &size, sizeof(size));
+	message.insert(message.end(), payload.begin(), payload.end());
+	return message;
+}
+
+// the walkers of a payload; false if it's malformed
+static bool unpack_walkers(const std::vector<char>& payload,
+							IslandHeader& header,
+							std::vector<IslandMigrant>& walkers)
+{
+	if (payload.size() < sizeof(header)) return false;
+	memcpy(&header, payload.data(), sizeof(header));
+
+	size_t offset = sizeof(header);
+	for (uint32_t i = 0; i < header.n_walkers; i++)
+	{
+		IslandWalker iw;
+		if (payload.size() - offset < sizeof(iw)) return false;
+		memcpy(&iw, payload.data() + offset, sizeof(iw));
+		offset += sizeof(iw);
+
+		if ((payload.size() - offset) / sizeof(TrajectoryRecord) < iw.n_states)
+		{
+			return false;
+		}
+
+		IslandMigrant m;
+		m.fitness = iw.fitness;
+		memcpy(m.mspeeds, iw.mspeeds, sizeof(m.mspeeds));
+		for (uint32_t j = 0; j < iw.n_states; j++)
+		{
+			TrajectoryRecord r;
+			memcpy(&r, payload.data() + offset, sizeof(r));
+			offset += sizeof(r);
+			m.lineage.push_back(unpack_state(r, defaultParameters));
+		}
+		walkers.push_back(m);
+	}
+	return offset == payload.size();
+}
+
+static bool write_all(int fd, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool read_all(int fd, char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t n = read(fd, data, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+// a whole message, blocking; false on EOF or error
+static bool read_message(int fd, std::vector<char>& payload)
+{
+	uint64_t size;
+	if (!read_all(fd, (char*)&size, sizeof(size))) return false;
+	payload.resize(size);
+	return read_all(fd, payload.data(), size);
+}
+
+Island::Island(int id, const std::vector<int>& in, const std::vector<int>& out)
+	: id(id), in(in), out(out)
+{
+	// sends must never block, or two islands sending to each other at once
+	// could each wait for the other to read
+	for (int fd : out)
+	{
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+}
+
+Island::~Island()
+{
+	for (int fd : in) if (fd >= 0) close(fd);
+	for (int fd : out) if (fd >= 0) close(fd);
+}
+
+bool Island::Due(int generation, int num_iterations) const
+{
+	return generation < num_iterations &&
+			generation % config.migration_interval == 0;
+}
+
+void Island::Migrate(std::vector<Walker*>& survivors)
+{
+	int k = survivors.size();
+	int n_migrants = std::min(config.migrants, k);
+	if (n_migrants == 0) return;
+
+	IslandHeader header;
+	memset(&header, 0, sizeof(header));
+	header.n_walkers = n_migrants;
+	std::vector<Walker*> emigrants(survivors.begin(),
+									survivors.begin() + n_migrants);
+	std::vector<char> message = pack_walkers(emigrants, header);
+
+	// send to every neighbour and read one message from each, whichever is
+	// ready first
+	std::vector<size_t> sent(out.size(), 0);
+	std::vector<std::vector<char>> received(in.size());
+	std::vector<size_t> got(in.size(), 0);
+	std::vector<bool> done(in.size(), false);
+
+	while (true)
+	{
+		std::vector<pollfd> fds;
+		std::vector<int> which;
+		for (size_t o = 0; o < out.size(); o++)
+		{
+			if (out[o] < 0 || sent[o] == message.size()) continue;
+			fds.push_back({ out[o], POLLOUT, 0 });
+			which.push_back(-1 - (int)o);
+		}
+		for (size_t i = 0; i < in.size(); i++)
+		{
+			if (in[i] < 0 || done[i]) continue;
+			fds.push_back({ in[i], POLLIN, 0 });
+			which.push_back(i);
+		}
+		if (fds.empty()) break;
+
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if (errno == EINTR) continue;
+			std::cout << "[island.cpp] poll failed: " << strerror(errno)
+						<< std::endl;
+			return;
+		}
+
+		for (size_t f = 0; f < fds.size(); f++)
+		{
+			if (!fds[f].revents) continue;
+
+			if (which[f] < 0)
+			{
+				int o = -1 - which[f];
+				ssize_t n = send(out[o], message.data() + sent[o],
+									message.size() - sent[o], MSG_NOSIGNAL);
+				if (n > 0)
+				{
+					sent[o] += n;
+				}
+				else if (n < 0 && errno != EAGAIN && errno != EINTR)
+				{
+					std::cout << "[island.cpp] island " << id
+								<< " lost a neighbour" << std::endl;
+					close(out[o]);
+					out[o] = -1;
+				}
+				continue;
+			}
+
+			// the length first, then the payload
+			int i = which[f];
+			std::vector<char>& buffer = received[i];
+			size_t want = sizeof(uint64_t);
+			if (got[i] >= want)
+			{
+				uint64_t size;
+				memcpy(&size, buffer.data(), sizeof(size));
+				want += size;
+			}
+			buffer.resize(want);
+
+			ssize_t n = read(in[i], buffer.data() + got[i], want - got[i]);
+			if (n > 0)
+			{
+				got[i] += n;
+				done[i] = got[i] == want && want > sizeof(uint64_t);
+			}
+			else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+			{
+				std::cout << "[island.cpp] island " << id
+							<< " lost a neighbour" << std::endl;
+				close(in[i]);
+				in[i] = -1;
+			}
+		}
+	}
+
+	// the immigrants, in neighbour order, take the places of the least fit
+	// survivors; the fittest survivor is always kept
+	std::vector<IslandMigrant> immigrants;
+	for (size_t i = 0; i < in.size(); i++)
+	{
+		if (in[i] < 0 || !done[i]) continue;
+
+		std::vector<char> payload(received[i].begin() + sizeof(uint64_t),
+									received[i].end());
+		IslandHeader h;
+		if (!unpack_walkers(payload, h, immigrants))
+		{
+			std::cout << "[island.cpp] island " << id
+						<< " got a broken migration" << std::endl;
+		}
+	}
+
+	int n = std::min((int)immigrants.size(), k - 1);
+	for (int j = 0; j < n; j++)
+	{
+		Walker* w = survivors[k - 1 - j];
+		const float* speeds = immigrants[j].mspeeds;
+		w->states = immigrants[j].lineage;
+		w->SetMotorSpeeds(speeds[UPPER_LEFT], speeds[UPPER_RIGHT],
+							speeds[LOWER_LEFT], speeds[LOWER_RIGHT]);
+	}
+}
+
+// island 0 keeps the run's seed; the others draw theirs from a stream no
+// generation reaches
+static uint64_t island_seed(uint64_t seed, int id)
+{
+	if (id == 0) return seed;
+	Rng rng(seed, 0xFFFFFFFFu, RNG_GENERATION_STREAM | id);
+	return ((uint64_t)rng.Uint() << 32) | rng.Uint();
+}
+
+// an island's whole life, in its own process; 0 if it sent its results
+static int run_island(int id, int num_walkers, int num_iterations,
+						float fit_ratio, int threads, Island* endpoint,
+						int coordinator)
+{
+	config.seed = island_seed(config.seed, id);
+	scheduler_init(threads, false);
+	island = endpoint;
+
+	std::vector<Walker*> survivors = run_genetic_algorithm(num_walkers,
+														num_iterations,
+														fit_ratio);
+	int n = std::min(1, (int)survivors.size());
+	survivors.resize(n);
+
+	IslandHeader header;
+	memset(&header, 0, sizeof(header));
+	header.n_walkers = n;
+	header.stopped = stopped_early;
+	header.create_time = create_time;
+	header.simulate_time = simulate_time;
+	header.fitness_selection_time = fitness_selection_time;
+	std::vector<char> message = pack_walkers(survivors, header);
+
+	bool ok = write_all(coordinator, message.data(), message.size());
+	close(coordinator);
+	delete endpoint;
+	island = nullptr;
+	return ok ? 0 : 1;
+}
+
+std::vector<Walker*> run_islands(int num_walkers, int num_iterations,
+									float fit_ratio)
+{
+	int n_islands = config.islands;
+	int threads = std::max(1, scheduler_threads() / n_islands);
+
+	// one socketpair per directed edge of the topology ([0] sends, [1]
+	// receives) and one per island to report back ([0] is the island's)
+	struct Edge { int from, to, fds[2]; };
+	std::vector<Edge> edges;
+	for (int i = 0; i < n_islands; i++)
+	{
+		for (int j = 0; j < n_islands; j++)
+		{
+			bool linked = config.topology == TOPOLOGY_ALL ?
+							i != j : j == (i + 1) % n_islands && i != j;
+			if (linked) edges.push_back({ i, j, { -1, -1 } });
+		}
+	}
+	std::vector<int> reports(2 * n_islands, -1);
+
+	bool ok = true;
+	for (Edge& e : edges)
+	{
+		ok = ok && socketpair(AF_UNIX, SOCK_STREAM, 0, e.fds) == 0;
+	}
+	for (int i = 0; i < n_islands; i++)
+	{
+		ok = ok && socketpair(AF_UNIX, SOCK_STREAM, 0, &reports[2 * i]) == 0;
+	}
+
+	std::vector<pid_t> pids(n_islands, -1);
+	for (int i = 0; ok && i < n_islands; i++)
+	{
+		// make sure nothing buffered gets written twice
+		std::cout.flush();
+		pids[i] = fork();
+		if (pids[i] < 0)
+		{
+			ok = false;
+			break;
+		}
+		if (pids[i] > 0) continue;
+
+		// the island keeps its ends of its own connections only
+		std::vector<int> in, out;
+		for (Edge& e : edges)
+		{
+			if (e.from == i) out.push_back(e.fds[0]);
+			else close(e.fds[0]);
+			if (e.to == i) in.push_back(e.fds[1]);
+			else close(e.fds[1]);
+		}
+		for (int j = 0; j < n_islands; j++)
+		{
+			close(reports[2 * j + 1]);
+			if (j != i) close(reports[2 * j]);
+		}
+
+		int share = num_walkers / n_islands + (i < num_walkers % n_islands);
+		int status = run_island(i, share, num_iterations, fit_ratio, threads,
+								new Island(i, in, out), reports[2 * i]);
+		std::cout.flush();
+		_exit(status);
+	}
+
+	for (Edge& e : edges)
+	{
+		if (e.fds[0] >= 0) close(e.fds[0]);
+		if (e.fds[1] >= 0) close(e.fds[1]);
+	}
+	for (int i = 0; i < n_islands; i++)
+	{
+		if (reports[2 * i] >= 0) close(reports[2 * i]);
+	}
+
+	if (!ok)
+	{
+		std::cout << "[island.cpp] could not start the islands: "
+					<< strerror(errno) << std::endl;
+	}
+
+	// collect every island's fittest walkers; an island that died sends
+	// nothing and the others carry on
+	std::vector<IslandMigrant> results;
+	int finished = 0;
+	create_time = simulate_time = fitness_selection_time = 0.0;
+	for (int i = 0; i < n_islands; i++)
+	{
+		std::vector<char> payload;
+		IslandHeader h;
+		bool got = pids[i] > 0 && read_message(reports[2 * i + 1], payload) &&
+					unpack_walkers(payload, h, results);
+		if (reports[2 * i + 1] >= 0) close(reports[2 * i + 1]);
+
+		int status = 0;
+		if (pids[i] > 0) waitpid(pids[i], &status, 0);
+
+		if (got && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		{
+			finished++;
+			stopped_early = stopped_early || h.stopped;
+			create_time += h.create_time;
+			simulate_time += h.simulate_time;
+			fitness_selection_time += h.fitness_selection_time;
+		}
+		else if (pids[i] > 0)
+		{
+			std::cout << "[island.cpp] island " << i << " failed" << std::endl;
+		}
+	}
+
+	if (finished == 0)
+	{
+		std::cout << "[island.cpp] no island finished" << std::endl;
+		return std::vector<Walker*>();
+	}
+	create_time /= finished;
+	simulate_time /= finished;
+	fitness_selection_time /= finished;
+
+	std::stable_sort(results.begin(), results.end(),
+					[](const IslandMigrant& a, const IslandMigrant& b)
+					{ return a.fitness > b.fitness; });
+	int n = std::min(1, (int)results.size());
+
+	std::vector<Walker*> fittest(n);
+	for (int i = 0; i < n; i++)
+	{
+		const float* speeds = results[i].mspeeds;
+		fittest[i] = pool->Acquire(0, i, results[i].lineage);
+		fittest[i]->SetMotorSpeeds(speeds[UPPER_LEFT], speeds[UPPER_RIGHT],
+									speeds[LOWER_LEFT], speeds[LOWER_RIGHT]);
+	}
+	return fittest;
+}
@@ -38,373 +38,159 @@
 // point.
 
 #include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <random>
 #include <chrono>
+#include <string>
+#include <cmath>
+#include <csignal>
 #include "walker.h"
+#include "walker_world.h"
+#include "walker_pool.h"
+#include "arena.h"
+#include "rng.h"
+#include "genome.h"
+#include "selection.h"
+#include "scheduler.h"
+#include "termination.h"
+#include "eval_cache.h"
+#include "trajectory_file.h"
+#include "trajectory_stream.h"
+#include "trajectory_codec.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "ga.h"
+#include "trace.h"
+#include "remote.h"
 #include <omp.h>
 
 // #define N_BEST 1
 
-std::chrono::high_resolution_clock::time_point program_start;
 std::chrono::high_resolution_clock::time_point program_end;
-std::chrono::high_resolution_clock::time_point start;
-std::chrono::high_resolution_clock::time_point end;
-std::chrono::high_resolution_clock::time_point start_initial_generation;
-std::chrono::high_resolution_clock::time_point end_initial_generation;
 
-// define a timer for each the creation, simulation, and fitness selection
-// of the walkers
-double create_time;
-double simulate_time;
-double fitness_selection_time;
-
-
-// Define the chromosome type, which is a vector of 4 floating point numbers.
-typedef std::vector<float> Chromosome;
-
-// Define a function to initialize a chromosome with random values.
-Chromosome initialize_chromosome() 
+// [USAGE] ./main (# of walkers) (# generations) (# survival fraction)
+//               (# walkers per shared world) [--config FILE]
+//               [--set name=value] [--seed N]
+//               [--selection topk|tournament|sus] [--threads N] [--pin]
+//               [--terminate contact,height,sleep,stall|none]
+//               [--no-cache] [--json] [--compress] [--stream FILE]
+//               [--checkpoint FILE] [--checkpoint-every N] [--resume FILE]
+//               [--save-config FILE] [--trace FILE] [--islands K]
+//               [--migrate-every M] [--migrants N] [--topology ring|all]
+//               [--listen PORT] [--spawn-workers N] [--backend box2d|batch]
+//               [--screen FRACTION]
+//       ./main --worker HOST:PORT [--threads N]
+int main(int argc, char *argv[]) 
 {
-    Chromosome chromosome;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    float stdev = (MAX_MOTOR_SPEED - MIN_MOTOR_SPEED) / 2;
-    std::normal_distribution<float> dis(0, stdev);
-    for (int i = 0; i < 4; i++) {
-        chromosome.push_back(dis(gen));
+    if (!parse_args(argc, argv, config)) {
+        return 1;
     }
-    return chromosome;
-}
 
-// Define a function to create a walker with a given chromosome.
-// the walker starts in the same position as the passed parent
-Walker* create_walker(Walker* parent, Chromosome chromosome) 
-{
-    Walker* walky;
-    if (parent) {
-        walky = new Walker(parent->states);
-    } else {
-        walky = new Walker();
+    // a worker only simulates what its coordinator sends it (see remote.h)
+    if (!config.worker.empty()) {
+        scheduler_init(config.threads, config.pin);
+        return run_worker(config.worker) ? 0 : 1;
     }
-    walky->SetMotorSpeeds(chromosome[0], chromosome[1], chromosome[2], 
-                            chromosome[3]);
-    return walky;
-}
-
-// Define a function to calculate the fitness of an walker assuming that
-// the walker's step had already been simulated.
-float calculate_fitness(Walker* walker) 
-{
-    // Get the distance walked by the walker and return it as the fitness.
-    return walker->GetPositionX();
-
-    //return ABS(walker->GetVelocityX());
-}
 
-// Define a function to perform crossover on two chromosomes.
-Chromosome crossover(Chromosome chromosome1, Chromosome chromosome2) 
-{
-    // for each index in the chromosome, randomly select the allele from one 
-    // of the parents with probability 0.5
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
-    Chromosome child;
-    for (int i = 0; i < 4; i++) {
-        if (dis(gen) < 0.5f) {
-            child.push_back(chromosome1[i]);
-        } else {
-            child.push_back(chromosome2[i]);
-        }
+    // streamed survivors only keep their most recent states, so a checkpoint
+    // couldn't hold their lineages, and the stream can't be carried on
+    if (!config.stream.empty() &&
+        (!config.checkpoint.empty() || !config.resume.empty())) {
+        std::cout   << "--stream can't be combined with --checkpoint or "
+                    << "--resume (streamed lineages aren't kept in memory, "
+                    << "so a checkpoint can't hold them)" << std::endl;
+        return 1;
     }
-    return child;
-}
-
-// Define a function to perform mutation on a chromosome.
-Chromosome mutate(Chromosome chromosome) 
-{
-    // for each index in the chromosome, randomly sample from a normal 
-    // distribution with mean 0 and standard deviation 0.04, with prob. 0.1
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::normal_distribution<float> dis(0.0f, MUTATE_SIZE);
-    Chromosome mutated;
-
-    for (int i = 0; i < 4; i++) {
-        float chrom = chromosome[i], mutation = dis(gen);
-
-        if (chrom + mutation <= MAX_MOTOR_SPEED &&
-            chrom + mutation >= MIN_MOTOR_SPEED) {
-            chrom += mutation;
+    // a resumed run is the checkpointed one: its run settings replace the
+    // arguments, and it keeps checkpointing to the same file by default
+    if (!config.resume.empty()) {
+        resume_from = new Checkpoint();
+        if (!resume_from->Load(config.resume)) {
+            return 1;
+        }
+        config.Resume(resume_from->config);
+        create_time = resume_from->create_time;
+        simulate_time = resume_from->simulate_time;
+        fitness_selection_time = resume_from->fitness_selection_time;
+        if (config.checkpoint.empty()) {
+            config.checkpoint = config.resume;
         }
-        mutated.push_back(chrom);
     }
-    return mutated;
-}
-
-// Define a function to select the fittest walkers after the speeds have 
-// been applied, and it returns the top 10% of the walkers
-std::vector<Walker*> select_fittest(std::vector<Walker*> walkers, float ratio) 
-{
-    // print the walkers' speeds in the new population and their fitness
-    // std::cout << "select_fittest called" << std::endl;
-    // for (int i = 0; i < 10; i++) {
-    //     std::cout << "Walker " << i << ": ";
-    //     Chromosome chromosome = walkers[i]->GetMotorSpeeds();
-    //     for (int j = 0; j < chromosome.size(); j++) {
-    //         std::cout << chromosome[j] << " ";
-    //     }
-    //     std::cout << "Fitness: " << walkers[i]->GetDistanceWalked();
-    //     std::cout << std::endl;
-    // }
 
-    if (ratio > 1.0f) ratio = 0.1f;
-
-    // sort the walkers by fitness
-
-    std::sort(walkers.begin(), walkers.end(), [](Walker* w1, Walker* w2) 
-    {
-        return calculate_fitness(w1) < calculate_fitness(w2);
-    });
-	
-    // return the top `ratio` portion of the walkers using assign
-    std::vector<Walker*> fittest;
-    int cutoff_i = walkers.size() * ratio;
-    for (int i = 0; i < cutoff_i; i++) {
-        fittest.push_back(walkers[i]);
+    // islands run in processes of their own, which write nothing but their
+    // results back
+    if (config.islands > 1 && (!config.stream.empty() ||
+                               !config.checkpoint.empty() ||
+                               !config.resume.empty() ||
+                               !config.trace.empty())) {
+        std::cout   << "--islands can't be combined with --stream, "
+                    << "--checkpoint, --resume or --trace" << std::endl;
+        return 1;
     }
-
-    // free memory used by the remaining (dead) walkers
-    for (int i = cutoff_i; i < (int)walkers.size(); i++) {
-        delete walkers[i];
+    if (config.islands > 1 && (config.listen || config.spawn_workers)) {
+        std::cout   << "--islands can't be combined with --listen or "
+                    << "--spawn-workers" << std::endl;
+        return 1;
     }
 
-    return fittest;
-}
-
-// Define a function to create a new population of walkers given the fittest 
-// walkers from the previous generation and their chromosomes, and the number
-// of walkers to create.
-std::vector<Walker*> create_new_population(
-    std::vector<Walker*> fittest_walkers,
-    int num_walkers) 
-{
-    // std::vector<Walker*> new_population;
-    // define a new_population vector of size num_walkers
-    // for parallel
-    std::vector<Walker*> new_population(num_walkers);
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
-
-#pragma omp parallel for num_threads(4)
-    for (int i = 0; i < num_walkers; i++) {
-        // randomly select two walkers from the fittest walkers
-        int index1 = dis(gen) * fittest_walkers.size();
-        int index2 = dis(gen) * fittest_walkers.size();
-
-        // get the chromosomes of the walkers
-        Chromosome chromosome1 = fittest_walkers[index1]->GetMotorSpeeds();
-        Chromosome chromosome2 = fittest_walkers[index2]->GetMotorSpeeds();
-
-        // perform crossover with probability 0.8
-        if (dis(gen) < CROSSOVER_PROBABILITY) {
-            chromosome1 = crossover(chromosome1, chromosome2);
-        }
-
-        // perform mutation with probability 0.1
-        if (dis(gen) < MUTATION_PROBABILITY) {
-            chromosome1 = mutate(chromosome1);
-        }
-
-        // [TODO] for now, just use the first parent to initialize the child's
-        // position
-        // new_population.push_back(create_walker(fittest_walkers[index1],
-        //                             chromosome1));
-        // for parallel
-        new_population[i] = create_walker(fittest_walkers[index1], chromosome1);
+    // workers simulate every child in a world of its own (see remote.h), so
+    // the coordinator does too, for no walker to depend on who simulated it
+    if (config.listen || config.spawn_workers) {
+        config.shard_size = 0;
     }
 
-#pragma omp parallel for num_threads(4)
-// because if multiple threads try to delete the same
-                         // walker, it will cause a segfault, or undefined
-                         // behavior
-	for (Walker* walky : fittest_walkers) {
-		delete walky;
+    if (!config.seeded) {
+        config.seed = random_seed();
+        config.seeded = true;
     }
 
-    return new_population;
-}
-
-// Define a function to run the genetic algorithm and return the best walkers.
-std::vector<Walker*> run_genetic_algorithm( int num_walkers, 
-                                            int num_iterations,
-                                            float fit_ratio) 
-{
-    // initialize the population of walkers
-    // std::vector<Walker*> walkers;
-    // for parallel
-    std::vector<Walker*> walkers(num_walkers);
-
-    //start = std::chrono::high_resolution_clock::now();
-
-    start_initial_generation = std::chrono::high_resolution_clock::now();
-
-#pragma omp parallel for num_threads(4)
-    // thread-local list of walkers
-    for (int i = 0; i < num_walkers; i++) {
-        Walker* walk0 = create_walker(nullptr, initialize_chromosome());
-        walk0->Simulate();
-        // walkers.push_back(walk0);
-        // for parallel
-        walkers[i] = walk0;
+    // the effective settings, e.g. to rerun this exact configuration
+    for (int a = 1; a + 1 < argc; a++) {
+        if (std::string(argv[a]) == "--save-config") {
+            std::ofstream out(argv[a + 1]);
+            out << config.Serialize().dump(4) << std::endl;
+        }
     }
 
-    end_initial_generation = std::chrono::high_resolution_clock::now();
-    std::cout << "(run_genetic_algorithm): Time to create initial population: "
-              << std::chrono::duration_cast<std::chrono::milliseconds>(
-                     end_initial_generation - start_initial_generation)
-                     .count()
-              << "ms" << std::endl;
-
-
-
-//     start = std::chrono::high_resolution_clock::now();
-
-//     // for parallel
-// #pragma omp parallel for num_threads(4)
-//     for (int i = 0; i < num_walkers; i++) {
-//         Walker* walk0 = create_walker(nullptr, initialize_chromosome());
-//     }
-
-//     end = std::chrono::high_resolution_clock::now();
-//     std::cout	<< "(run_genetic_algorithm): Time to create new "
-// 					<< " population, iteration 0: " 
-//     				<< std::chrono::duration_cast<std::chrono::milliseconds>(
-//     				end - start).count() << "ms" << std::endl;
-    
-//     // add end-start to create_time
-//     create_time += std::chrono::duration_cast<std::chrono::milliseconds>(
-//     				end - start).count();
-
-//     start = std::chrono::high_resolution_clock::now();
-
-//     // simulate the walkers
-// #pragma omp parallel for num_threads(4)
-//     for (int i = 0; i < num_walkers; i++) {
-//         walkers[i]->Simulate();
-//     }
-
-//     end = std::chrono::high_resolution_clock::now();
-//     std::cout	<< "(run_genetic_algorithm): Time to simulate new "
-//                     << " population, iteration 0: " 
-//     				<< std::chrono::duration_cast<std::chrono::milliseconds>(
-//     				end - start).count() << "ms" << std::endl;
-
-//     // add end-start to simulate_time
-//     simulate_time += std::chrono::duration_cast<std::chrono::milliseconds>(
-//     				end - start).count();
-
-//     start = std::chrono::high_resolution_clock::now();
-
-    
-
-    // run the genetic algorithm for a number of iterations
-
-    // select the first walkers to generate offspring
-    walkers = select_fittest(walkers, fit_ratio);
-
-    for (int i = 1; i < num_iterations; i++) {
-
-        // print the iteration number
-        // std::cout << "Iteration " << i << std::endl;
-        // apply the currently set motor speeds to the walkers
-
-        // create a new population of walkers
-        
-        start = std::chrono::high_resolution_clock::now();
-
-        walkers = create_new_population(walkers, num_walkers);
-
-        end = std::chrono::high_resolution_clock::now();
-        std::cout	<< "(run_genetic_algorithm): Time to create new "
-						<< " population, iteration " << i << ": " 
-						<< std::chrono::duration_cast
-							<std::chrono::milliseconds>(end - start).count() 
-						<< "ms" << std::endl;
-        // start = end;
-
-        // add end-start to create_time
-        create_time += std::chrono::duration_cast
-                            <std::chrono::milliseconds>(end - start).count();
-                            
-
-        start = std::chrono::high_resolution_clock::now();
+    if (!config.checkpoint.empty()) {
+        std::signal(SIGTERM, request_stop);
+        std::signal(SIGINT, request_stop);
+    }
 
-// #pragma omp parallel for num_threads(4)
-// add parallel and collapse
-#pragma omp parallel for num_threads(4)
-        for (int j = 0; j < num_walkers; j++) {
-        	walkers[j]->Simulate();
+    // workers are forked before OpenMP starts any threads, and local ones
+    // split the threads between them
+    if (config.listen || config.spawn_workers) {
+        coordinator = new Coordinator();
+        int procs = config.threads > 0 ? config.threads : omp_get_num_procs();
+        if (!coordinator->Listen(config.listen) ||
+            !coordinator->Spawn(config.spawn_workers,
+                                std::max(1, procs / std::max(1,
+                                                config.spawn_workers)))) {
+            return 1;
         }
-
-        end = std::chrono::high_resolution_clock::now();
-        std::cout	<< "(run_genetic_algorithm): Time to simulate walkers,"
-							" iteration " << i << ": " 
-						<< std::chrono::duration_cast
-							<std::chrono::milliseconds>(end - start).count() 
-						<< "ms" << std::endl;
-        // add end-start to simulate_time
-        simulate_time += std::chrono::duration_cast
-                            <std::chrono::milliseconds>(end - start).count();
-
-
-        // start = end; // wrong
-
-        // select the fittest walkers
-
-        start = std::chrono::high_resolution_clock::now();
-
-        walkers = select_fittest(walkers, fit_ratio);
-
-        // end = std::chrono::high_resolution_clock::now();
-        // std::cout	<< "(run_genetic_algorithm): Time to select fittest "
-		// 					"walkers, iteration " << i << ": " 
-		// 				<< std::chrono::duration_cast
-		// 					<std::chrono::milliseconds>(end - start).count() 
-		// 				<< "ms" << std::endl;
-        // start = end;
     }
 
-    return walkers;
-}
+    // islands split the threads between them, unpinned (they'd all pin to
+    // the same cores)
+    scheduler_init(config.threads, config.pin && config.islands == 1);
 
-// [USAGE] ./main (# of walkers) (# generations) (# survival fraction)
-int main(int argc, char *argv[]) 
-{
-    int n_walkers = NUM_WALKERS, n_iter = NUM_ITERATIONS;
-    float fit_r = FITTEST_RATIO; //, total_time;
-
-    if (argc > 1) {
-        n_walkers = atoi(argv[1]);
-        if (argc > 2) {
-            // total_time = atof(argv[2]);
-            // n_iter = total_time / SIM_DT;
-            n_iter = atoi(argv[2]);
-            if (argc > 3) {
-                fit_r = atof(argv[3]);
-            }
-        }
+    if (!config.trace.empty() && !trace_start()) {
+        return 1;
     }
 
-    // print number of max threads
-    std::cout << "Max threads: " << omp_get_max_threads() << std::endl;
-
     program_start = std::chrono::high_resolution_clock::now();
+    if (resume_from) {
+        program_start -= std::chrono::duration_cast<
+                             std::chrono::high_resolution_clock::duration>(
+                             std::chrono::duration<double, std::milli>(
+                                 resume_from->elapsed));
+    }
+
+    int n_walkers = config.num_walkers, n_iter = config.num_iterations;
+    float fit_r = config.fit_ratio;
 
     // std::cout   << "#Walkers = " << n_walkers << "\nTime = " << total_time
     //             << " (" << n_iter << " Iterations)\nFittest = " << fit_r 
@@ -412,11 +198,105 @@ int main(int argc, char *argv[])
 
     std::cout   << "# Walkers = " << n_walkers << "\n# Iterations = " << n_iter 
                 << "\n# Fittest = " << n_walkers * fit_r << " (Top " 
-                <<  100 * fit_r << "%)" << std::endl;
+                <<  100 * fit_r << "%)" << "\n# Walkers per world = " 
+                << (config.shard_size > 0 ? config.shard_size : 1)
+                << "\nSeed = " << config.seed
+                << "\nSelection = " << selection_name(config.selection)
+                << "\nTermination = " << termination_names(config.termination)
+                << "\nSimulation = " << config.hertz << "Hz, "
+                << config.TimeSteps() << " steps per generation, "
+                << config.velocity_iterations << "/"
+                << config.position_iterations << " solver iterations ("
+                << backend_name(config.backend) << ")"
+                << "\nScreening = ";
+    if (config.screen_fraction > 0.0f) {
+        std::cout   << config.screen_hertz << "Hz, "
+                    << config.Screening().TimeSteps() << " steps, "
+                    << config.screen_velocity_iterations << "/"
+                    << config.screen_position_iterations
+                    << " solver iterations (top "
+                    << 100 * config.screen_fraction << "% simulated in full)";
+    } else {
+        std::cout   << "off";
+    }
+    std::cout   << "\nIslands = " << config.islands;
+    if (config.islands > 1) {
+        std::cout   << " (" << topology_name(config.topology) << ", "
+                    << config.migrants << " migrants every "
+                    << config.migration_interval << " generations)";
+    }
+    std::cout   << "\nWorkers = ";
+    if (coordinator) {
+        std::cout   << "port " << coordinator->Port() << " ("
+                    << config.spawn_workers << " spawned)";
+    } else {
+        std::cout   << "off";
+    }
+    std::cout   << "\nEvaluation cache = " << (config.Caching() ? "on"
+                                         : config.cache ? "off (shared worlds)"
+                                                        : "off")
+                << "\nStream = " << (config.stream.empty() ? "off"
+                                                          : config.stream)
+                << "\nCheckpoint = " << (config.checkpoint.empty()
+                                            ? "off" : config.checkpoint)
+                << "\nTrace = " << (config.trace.empty() ? "off"
+                                                         : config.trace)
+                << "\n# Threads = " << scheduler_threads()
+                << (scheduler_pinned() ? " (pinned)" : "") << std::endl;
+    if (resume_from) {
+        std::cout   << "Resuming from " << config.resume
+                    << " after generation " << resume_from->generation - 1
+                    << std::endl;
+    }
+
+    // walkers, worlds and everything Box2D allocates come from per-thread
+    // arenas, released all at once when the run is over
+    Arena::enabled = true;
+    pool = new WalkerPool(n_walkers, config.shard_size);
+    cache = config.Caching() ? new EvalCache() : nullptr;
+
+    if (!config.stream.empty()) {
+        stream = new TrajectoryStream();
+        if (!stream->Open(config.stream, defaultParameters)) {
+            std::cout << "Can't open " << config.stream << std::endl;
+            return 1;
+        }
+    }
 
 	// run the genetic algorithm
-    std::vector<Walker*> walkers = run_genetic_algorithm(n_walkers, n_iter,
-                                                            fit_r);
+    std::vector<Walker*> walkers;
+    if (config.islands > 1) {
+        walkers = run_islands(n_walkers, n_iter, fit_r);
+        if (walkers.empty()) {
+            return 1;
+        }
+    } else {
+        walkers = run_genetic_algorithm(n_walkers, n_iter, fit_r);
+    }
+
+    // the workers are done
+    delete coordinator;
+    coordinator = nullptr;
+    delete resume_from;
+    resume_from = nullptr;
+
+    // interrupted with generations left: the last one done is checkpointed,
+    // nothing else to do
+    if (stopped_early) {
+        std::cout   << "Stopped; resume with --resume " << config.checkpoint
+                    << std::endl;
+        if (stream) {
+            stream->Close();
+            delete stream;
+        }
+        if (!config.trace.empty()) {
+            trace_write(config.trace);
+        }
+        delete cache;
+        delete pool;
+        Arena::ResetAll();
+        return 0;
+    }
 
     // print the best walker
     std::cout	<< "Best walker: " 
@@ -426,7 +306,8 @@ int main(int argc, char *argv[])
     std::cout	<< "Size of best walker:   "
                 << sizeof(*walkers[0]) << std::endl;
 
-    // print simulate_time average (we don't count the first iteration)
+    // print simulate_time average (we don't count the first iteration); create
+    // and simulate overlap, so both are thread time per thread
     std::cout	<< "Average simulate_time: "
                 << simulate_time / (n_iter - 1) << "ms" << std::endl;
             
@@ -434,6 +315,17 @@ int main(int argc, char *argv[])
     std::cout	<< "Average create_time:   "
                 << create_time / (n_iter - 1) << "ms" << std::endl;
 
+    std::cout	<< "Average select_time:   "
+                << fitness_selection_time / (n_iter - 1) << "ms" << std::endl;
+
+    if (screened_generations > 0) {
+        std::cout   << "Average screen_time:   "
+                    << screen_time / screened_generations
+                    << "ms (rank correlation "
+                    << screen_correlation / screened_generations << ")"
+                    << std::endl;
+    }
+
 
     // // print the best walker's chromosome
     // std::cout << "Best walker's chromosome: ";
@@ -473,11 +365,63 @@ int main(int argc, char *argv[])
         walkers[i]->Dump();
     }
     */
-   walkers[0]->Dump(true);
+    // dump the best walker to trajectory.traj (plus a .json copy with --json
+    // and a .trajz one with --compress)
+    Walker* best = walkers[0];
+
+    // streamed lineages were truncated along the way; read them back whole
+    if (stream) {
+        uint64_t records = stream->Records();
+        stream->Close();
+
+        TrajectoryFile file;
+        if (!file.Open(config.stream)) {
+            return 1;
+        }
+        best->states = WalkerLineage(file.Lineage(best->states.Tip()->id));
+        file.Close();
+
+        std::cout   << "Streamed " << records << " states to "
+                    << config.stream << std::endl;
+        delete stream;
+        stream = nullptr;
+    }
+
+    {
+        TRACE_SCOPE("dump");
+        std::string fname = "trajectory";
+        best->Dump(fname + TRAJECTORY_EXTENSION);
+        if (config.dump_json) {
+            best->DumpJSON(fname + ".json");
+        }
+        if (config.compress) {
+            write_compressed(fname + TRAJECTORY_CODEC_EXTENSION,
+                             best->states.Unroll());
+        }
+    }
+
+    if (cache) {
+        uint64_t lookups = cache->lookups, hits = cache->hits,
+                 duplicates = cache->duplicates;
+        std::cout	<< "Evaluation cache:      " << hits << " hits + "
+                    << duplicates << " duplicates / " << lookups
+                    << " lookups (" << (lookups ? 100.0 * (hits + duplicates)
+                                                    / lookups : 0.0)
+                    << "%)" << std::endl;
+    }
+
+    std::cout	<< "Arena memory:          "
+                << Arena::CapacityAll() / (1 << 20) << "MB" << std::endl;
+
+    // every thread is done recording by now
+    if (!config.trace.empty() && trace_write(config.trace)) {
+        std::cout   << "Trace written to " << config.trace << std::endl;
+    }
 
-	for (Walker* walky : walkers) {
-		delete walky;
-	}
+    // the pool owns every walker ever created
+    delete cache;
+    delete pool;
+    Arena::ResetAll();
 
     program_end = std::chrono::high_resolution_clock::now();
     std::cout	<< "Time to run genetic algorithm: "
@@ -0,0 +1,612 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <omp.h>
+#include "remote.h"
+#include "config.h"
+#include "scheduler.h"
+#include "batch_world.h"
+
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool write_all(int fd, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool read_all(int fd, char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t n = read(fd, data, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool send_message(int fd, uint32_t type,
+							const std::vector<char>& payload)
+{
+	RemoteMessage m;
+	m.magic = REMOTE_MAGIC;
+	m.type = type;
+	m.size = payload.size();
+	return write_all(fd, (const char*)&m, sizeof(m)) &&
+			write_all(fd, payload.data(), payload.size());
+}
+
+// a whole message, blocking; false on EOF, error or garbage
+static bool read_message(int fd, RemoteMessage& m, std::vector<char>& payload)
+{
+	if (!read_all(fd, (char*)&m, sizeof(m)) || m.magic != REMOTE_MAGIC)
+	{
+		return false;
+	}
+	payload.resize(m.size);
+	return read_all(fd, payload.data(), m.size);
+}
+
+// take a whole message off the front of what's been received, if there is
+// one; `broken` if what's there isn't a message
+static bool take_message(std::vector<char>& input, RemoteMessage& m,
+							std::vector<char>& payload, bool& broken)
+{
+	if (input.size() < sizeof(m)) return false;
+	memcpy(&m, input.data(), sizeof(m));
+	if (m.magic != REMOTE_MAGIC)
+	{
+		broken = true;
+		return false;
+	}
+	if (input.size() - sizeof(m) < m.size) return false;
+
+	payload.assign(input.begin() + sizeof(m),
+					input.begin() + sizeof(m) + m.size);
+	input.erase(input.begin(), input.begin() + sizeof(m) + m.size);
+	return true;
+}
+
+Coordinator::Coordinator()
+	: listener(-1), port(0), next_batch(0), batch_ms(0.0), n_batches(0),
+	  alone_since(now_ms())
+{
+}
+
+Coordinator::~Coordinator()
+{
+	Close();
+}
+
+bool Coordinator::Listen(int p)
+{
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0)
+	{
+		std::cout << "[remote.cpp] could not open a socket: " << strerror(errno)
+					<< std::endl;
+		return false;
+	}
+	int on = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(p);
+	socklen_t len = sizeof(addr);
+	if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+		listen(listener, SOMAXCONN) != 0 ||
+		getsockname(listener, (sockaddr*)&addr, &len) != 0)
+	{
+		std::cout << "[remote.cpp] could not listen on port " << p << ": "
+					<< strerror(errno) << std::endl;
+		close(listener);
+		listener = -1;
+		return false;
+	}
+
+	// accepting happens between everything else
+	fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+	port = ntohs(addr.sin_port);
+	return true;
+}
+
+bool Coordinator::Spawn(int n, int threads)
+{
+	std::string address = "127.0.0.1:" + std::to_string(port);
+	for (int i = 0; i < n; i++)
+	{
+		// make sure nothing buffered gets written twice
+		std::cout.flush();
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			std::cout << "[remote.cpp] could not spawn a worker: "
+						<< strerror(errno) << std::endl;
+			return false;
+		}
+		if (pid > 0)
+		{
+			spawned.push_back(pid);
+			continue;
+		}
+
+		close(listener);
+		scheduler_init(threads, false);
+		bool ok = run_worker(address);
+		std::cout.flush();
+		_exit(ok ? 0 : 1);
+	}
+	return true;
+}
+
+// welcome whoever connected since last time with the run's config
+void Coordinator::Accept()
+{
+	if (listener < 0) return;
+
+	std::string settings = config.Serialize().dump();
+	std::vector<char> payload(settings.begin(), settings.end());
+	while (true)
+	{
+		int fd = accept(listener, nullptr, nullptr);
+		if (fd < 0) return;
+
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		if (!send_message(fd, REMOTE_CONFIG, payload))
+		{
+			close(fd);
+			continue;
+		}
+
+		RemoteWorker w;
+		w.fd = fd;
+		workers.push_back(w);
+		std::cout	<< "(coordinator): a worker connected (" << workers.size()
+					<< " now)" << std::endl;
+	}
+}
+
+void Coordinator::Evaluate(const std::vector<RemoteTask>& tasks,
+							std::vector<RemoteResult>& results,
+							std::vector<bool>& done)
+{
+	int n = tasks.size();
+	results.assign(n, RemoteResult());
+	done.assign(n, false);
+	if (n == 0) return;
+
+	// batch b holds tasks [b * REMOTE_BATCH_SIZE, ...) and has id base + b
+	int nb = (n + REMOTE_BATCH_SIZE - 1) / REMOTE_BATCH_SIZE;
+	uint64_t base = next_batch;
+	next_batch += nb;
+
+	std::deque<int> queue;
+	for (int b = 0; b < nb; b++) queue.push_back(b);
+	std::vector<double> sent_at(nb, 0.0);
+	std::vector<bool> answered(nb, false);
+	std::vector<bool> duplicated(nb, false);
+	int left = nb;
+
+	auto first = [](int b) { return b * REMOTE_BATCH_SIZE; };
+	auto count = [n](int b)
+	{
+		return std::min(REMOTE_BATCH_SIZE, n - b * REMOTE_BATCH_SIZE);
+	};
+
+	// a worker that's gone hands its batches back to the queue
+	bool hung = false;
+	auto drop = [&](RemoteWorker& w, const char* why)
+	{
+		for (uint64_t id : w.inflight)
+		{
+			if (id < base) continue;
+			int b = id - base;
+			if (!answered[b]) queue.push_front(b);
+		}
+		close(w.fd);
+		w.fd = -1;
+		std::cout	<< "(coordinator): " << why << "; its batches go to the "
+					<< "others" << std::endl;
+	};
+	auto forget = [](RemoteWorker& w, uint64_t id)
+	{
+		for (size_t j = 0; j < w.inflight.size(); j++)
+		{
+			if (w.inflight[j] != id) continue;
+			w.inflight.erase(w.inflight.begin() + j);
+			w.sent.erase(w.sent.begin() + j);
+			break;
+		}
+	};
+
+	while (left > 0)
+	{
+		Accept();
+
+		double now = now_ms();
+		double average = n_batches ? batch_ms / n_batches : 0.0;
+		double late = std::max((double)REMOTE_STRAGGLER_MIN_MS,
+								REMOTE_STRAGGLER_FACTOR * average);
+
+		// a worker that's still connected but sits on a batch for far longer
+		// than a straggler is given up on
+		double hang = std::max((double)REMOTE_WAIT_MS,
+								REMOTE_HANG_FACTOR * late);
+		for (RemoteWorker& w : workers)
+		{
+			if (!w.sent.empty() &&
+				now - *std::min_element(w.sent.begin(), w.sent.end()) > hang)
+			{
+				drop(w, "a worker stopped answering");
+				hung = true;
+			}
+		}
+
+		// hand out batches to whoever has room, stragglers' once there are
+		// none left to send
+		for (RemoteWorker& w : workers)
+		{
+			while (w.fd >= 0 && (int)w.inflight.size() < REMOTE_INFLIGHT)
+			{
+				int b = -1;
+				while (!queue.empty() && b < 0)
+				{
+					b = queue.front();
+					queue.pop_front();
+					if (answered[b]) b = -1;
+				}
+				for (int s = 0; s < nb && b < 0; s++)
+				{
+					bool mine = std::find(w.inflight.begin(), w.inflight.end(),
+											base + s) != w.inflight.end();
+					if (!answered[s] && !duplicated[s] && !mine &&
+						sent_at[s] > 0.0 && now - sent_at[s] > late)
+					{
+						b = s;
+						duplicated[s] = true;
+					}
+				}
+				if (b < 0) break;
+
+				uint64_t id = base + b;
+				std::vector<char> payload(sizeof(id) +
+											count(b) * sizeof(RemoteTask));
+				memcpy(payload.data(), &id, sizeof(id));
+				memcpy(payload.data() + sizeof(id), &tasks[first(b)],
+						count(b) * sizeof(RemoteTask));
+
+				if (sent_at[b] == 0.0) sent_at[b] = now;
+				w.inflight.push_back(id);
+				w.sent.push_back(now);
+				if (!send_message(w.fd, REMOTE_BATCH, payload))
+				{
+					drop(w, "lost a worker");
+				}
+			}
+		}
+		workers.erase(std::remove_if(workers.begin(), workers.end(),
+									[](const RemoteWorker& w)
+									{ return w.fd < 0; }),
+						workers.end());
+
+		// nobody to do the work: wait a while (once, not every generation,
+		// and not at all once the last worker hung), then leave it to the
+		// caller
+		if (workers.empty())
+		{
+			if (hung || now - alone_since > REMOTE_WAIT_MS)
+			{
+				alone_since = 0.0;
+				std::cout	<< "(coordinator): no workers; simulating "
+							<< std::count(done.begin(), done.end(), false)
+							<< " walkers here" << std::endl;
+				break;
+			}
+		}
+		else
+		{
+			alone_since = now;
+		}
+
+		std::vector<pollfd> fds;
+		for (RemoteWorker& w : workers) fds.push_back({ w.fd, POLLIN, 0 });
+		if (listener >= 0) fds.push_back({ listener, POLLIN, 0 });
+		if (poll(fds.data(), fds.size(), REMOTE_POLL_MS) < 0 && errno != EINTR)
+		{
+			std::cout << "[remote.cpp] poll failed: " << strerror(errno)
+						<< std::endl;
+			break;
+		}
+
+		for (size_t f = 0; f < workers.size(); f++)
+		{
+			RemoteWorker& w = workers[f];
+			if (!fds[f].revents) continue;
+
+			char buffer[1 << 16];
+			ssize_t got = recv(w.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+			if (got <= 0)
+			{
+				if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+				drop(w, "lost a worker");
+				continue;
+			}
+			w.input.insert(w.input.end(), buffer, buffer + got);
+
+			RemoteMessage m;
+			std::vector<char> payload;
+			bool broken = false;
+			while (!broken && take_message(w.input, m, payload, broken))
+			{
+				uint64_t id;
+				if (m.type != REMOTE_RESULTS || payload.size() < sizeof(id))
+				{
+					broken = true;
+					break;
+				}
+				memcpy(&id, payload.data(), sizeof(id));
+				forget(w, id);
+
+				// an answer to an earlier generation's straggler, or to a
+				// batch someone else answered first
+				if (id < base || id >= base + nb || answered[id - base])
+				{
+					continue;
+				}
+				int b = id - base;
+				if (payload.size() != sizeof(id) +
+										count(b) * sizeof(RemoteResult))
+				{
+					broken = true;
+					break;
+				}
+				memcpy(&results[first(b)], payload.data() + sizeof(id),
+						count(b) * sizeof(RemoteResult));
+				for (int i = first(b); i < first(b) + count(b); i++)
+				{
+					done[i] = true;
+				}
+				answered[b] = true;
+				left--;
+				batch_ms += now_ms() - sent_at[b];
+				n_batches++;
+			}
+			if (broken)
+			{
+				std::cout << "[remote.cpp] a worker sent garbage" << std::endl;
+				drop(w, "lost a worker");
+			}
+		}
+		workers.erase(std::remove_if(workers.begin(), workers.end(),
+									[](const RemoteWorker& w)
+									{ return w.fd < 0; }),
+						workers.end());
+	}
+}
+
+void Coordinator::Close()
+{
+	for (RemoteWorker& w : workers)
+	{
+		send_message(w.fd, REMOTE_BYE, std::vector<char>());
+		close(w.fd);
+	}
+	workers.clear();
+
+	if (listener >= 0)
+	{
+		close(listener);
+		listener = -1;
+	}
+
+	// a spawned worker that hung would never leave
+	double deadline = now_ms() + REMOTE_WAIT_MS;
+	for (pid_t pid : spawned)
+	{
+		while (waitpid(pid, nullptr, WNOHANG) == 0)
+		{
+			if (now_ms() > deadline)
+			{
+				kill(pid, SIGKILL);
+				waitpid(pid, nullptr, 0);
+				break;
+			}
+			std::this_thread::sleep_for(
+				std::chrono::milliseconds(REMOTE_POLL_MS));
+		}
+	}
+	spawned.clear();
+}
+
+// connect to HOST:PORT, retrying for REMOTE_WAIT_MS in case the coordinator
+// isn't listening yet; -1 if it couldn't
+static int connect_to(const std::string& address)
+{
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos)
+	{
+		std::cout << "[remote.cpp] " << address << " isn't HOST:PORT"
+					<< std::endl;
+		return -1;
+	}
+	std::string host = address.substr(0, colon);
+	std::string service = address.substr(colon + 1);
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	double start = now_ms();
+	while (true)
+	{
+		addrinfo* found = nullptr;
+		if (getaddrinfo(host.c_str(), service.c_str(), &hints, &found) == 0)
+		{
+			for (addrinfo* a = found; a; a = a->ai_next)
+			{
+				int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+				if (fd < 0) continue;
+				if (connect(fd, a->ai_addr, a->ai_addrlen) == 0)
+				{
+					freeaddrinfo(found);
+					int on = 1;
+					setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+					return fd;
+				}
+				close(fd);
+			}
+			freeaddrinfo(found);
+		}
+
+		if (now_ms() - start > REMOTE_WAIT_MS)
+		{
+			std::cout << "[remote.cpp] could not reach " << address
+						<< std::endl;
+			return -1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+}
+
+bool run_worker(const std::string& address)
+{
+	int fd = connect_to(address);
+	if (fd < 0) return false;
+
+	RemoteMessage m;
+	std::vector<char> payload;
+	if (!read_message(fd, m, payload) || m.type != REMOTE_CONFIG)
+	{
+		std::cout << "[remote.cpp] " << address << " isn't a coordinator"
+					<< std::endl;
+		close(fd);
+		return false;
+	}
+
+	// simulate the way the coordinator does, with this machine's threads
+	nlohmann::json serial = nlohmann::json::parse(payload.begin(),
+													payload.end(), nullptr,
+													false);
+	Config run;
+	if (serial.is_discarded() || !run.Load(serial))
+	{
+		std::cout << "[remote.cpp] the coordinator sent a broken config"
+					<< std::endl;
+		close(fd);
+		return false;
+	}
+	config.Resume(run);
+
+	while (read_message(fd, m, payload))
+	{
+		if (m.type == REMOTE_BYE)
+		{
+			close(fd);
+			return true;
+		}
+
+		uint64_t id;
+		if (m.type != REMOTE_BATCH || payload.size() < sizeof(id) ||
+			(payload.size() - sizeof(id)) % sizeof(RemoteTask) != 0)
+		{
+			break;
+		}
+		memcpy(&id, payload.data(), sizeof(id));
+		int n = (payload.size() - sizeof(id)) / sizeof(RemoteTask);
+		std::vector<RemoteTask> tasks(n);
+		memcpy(tasks.data(), payload.data() + sizeof(id),
+				n * sizeof(RemoteTask));
+
+		std::vector<char> answer(sizeof(id) + n * sizeof(RemoteResult));
+		memcpy(answer.data(), &id, sizeof(id));
+		RemoteResult* results = (RemoteResult*)(answer.data() + sizeof(id));
+
+		// every child in a world of its own (or a batch's lane); how long one
+		// takes depends on what its bodies do, so threads take them one at a
+		// time
+		bool batched = config.backend == BACKEND_BATCH;
+		std::vector<Walker*> walkers(n);
+#pragma omp parallel for num_threads(scheduler_threads()) schedule(dynamic, 1)
+		for (int i = 0; i < n; i++)
+		{
+			const RemoteTask& t = tasks[i];
+			Walker* walker;
+			if (t.has_parent)
+			{
+				WalkerLineage image;
+				image.push_back(unpack_state(t.parent, defaultParameters));
+				walker = new Walker(image);
+			}
+			else
+			{
+				walker = new Walker();
+			}
+			const float* speeds = t.mspeeds;
+			walker->SetMotorSpeeds(speeds[UPPER_LEFT], speeds[UPPER_RIGHT],
+									speeds[LOWER_LEFT], speeds[LOWER_RIGHT]);
+			if (!batched) walker->Simulate();
+			walkers[i] = walker;
+		}
+
+		if (batched)
+		{
+			int n_batches = (n + BATCH_WORLD_SIZE - 1) / BATCH_WORLD_SIZE;
+#pragma omp parallel for num_threads(scheduler_threads()) schedule(dynamic, 1)
+			for (int b = 0; b < n_batches; b++)
+			{
+				int first = b * BATCH_WORLD_SIZE;
+				BatchWorld batch(&walkers[first],
+									std::min(BATCH_WORLD_SIZE, n - first));
+				batch.Simulate();
+			}
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			RemoteResult r;
+			memset(&r, 0, sizeof(r));
+			r.terminated = walkers[i]->terminated;
+			r.state = pack_state(walkers[i]->states.back());
+			memcpy(&results[i], &r, sizeof(r));
+			delete walkers[i];
+		}
+
+		if (!send_message(fd, REMOTE_RESULTS, answer)) break;
+	}
+
+	std::cout << "[remote.cpp] lost the coordinator" << std::endl;
+	close(fd);
+	return false;
+}
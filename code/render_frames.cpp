@@ -0,0 +1,615 @@
+// renders a trajectory to an image sequence on the CPU, for machines that
+// can't build or show the Box2D testbed (see `render`): no GPU, no X server
+//
+// every iteration of the lineage is simulated again from its recorded state,
+// driven by the next state's motor speeds and terminated as the run was, so
+// the frames in between states are the run's own physics and each iteration
+// starts exactly where the recording says (iterations are independent, so
+// they're replayed in parallel); frames are then rasterized in parallel, one
+// per thread at a time, with the camera following the head, and written as
+// binary PPMs or PNGs
+//
+// the run's simulation settings come from the file; trajectories recorded
+// with the batch backend are replayed with Box2D, so their frames in between
+// states only approximate the run's
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <omp.h>
+#include "box2d/box2d.h"
+#include "walker.h"
+#include "scheduler.h"
+#include "termination.h"
+#include "trajectory_file.h"
+#include "trajectory_codec.h"
+#include "config.h"
+
+#define N_BODIES (1 + N_LEG_PARAMS)
+
+struct RenderOptions {
+    std::string out = "frames";
+    bool png = true;
+    int width = 640;
+    int height = 360;
+    float fps = 30.0f;
+    float scale = 0.0f;                     // px/m (0 = fit the walker)
+    uint64_t node = 0;                      // lineage to render (0 = fittest)
+};
+
+static RenderOptions options;
+
+// where every body is at one time step (head first, then legs)
+struct Pose {
+    float x[N_BODIES];
+    float y[N_BODIES];
+    float angle[N_BODIES];
+};
+
+static Pose pose_of(const WalkerSnapshot& s)
+{
+    Pose p;
+    const BodySnapshot* bodies[N_BODIES] = { &s.head, &s.legs[0], &s.legs[1],
+                                             &s.legs[2], &s.legs[3] };
+    for (int b = 0; b < N_BODIES; b++) {
+        p.x[b] = bodies[b]->position.x;
+        p.y[b] = bodies[b]->position.y;
+        p.angle[b] = bodies[b]->angle;
+    }
+    return p;
+}
+
+static Pose pose_of(Walker* w)
+{
+    Pose p;
+    b2Body* bodies[N_BODIES] = { w->head, w->legs[0], w->legs[1], w->legs[2],
+                                 w->legs[3] };
+    for (int b = 0; b < N_BODIES; b++) {
+        p.x[b] = bodies[b]->GetPosition().x - w->origin.x;
+        p.y[b] = bodies[b]->GetPosition().y - w->origin.y;
+        p.angle[b] = bodies[b]->GetAngle();
+    }
+    return p;
+}
+
+// step one iteration as Walker::Simulate() does, recording the pose after
+// every step; a terminated walker stays where it was terminated
+template <int Mask>
+static void replay_steps(Walker* w, b2World* world, Pose* poses, int steps)
+{
+    float dt = config.TimeStep();
+    int i = 0;
+    while (i < steps) {
+        world->Step(dt, config.velocity_iterations, config.position_iterations);
+        poses[i++] = pose_of(w);
+        if (Mask && w->CheckTermination<Mask>()) break;
+    }
+    for (; i < steps; i++) {
+        poses[i] = poses[i - 1];
+    }
+}
+
+// the pose at every time step of the lineage: poses[i * steps] is state i's,
+// and the steps in between are iteration i's
+static std::vector<Pose> replay(const std::vector<WalkerState>& states)
+{
+    typedef void (*Steps)(Walker*, b2World*, Pose*, int);
+    static const Steps table[] = TERMINATION_TABLE(replay_steps);
+    Steps steps_of = table[config.termination & TERMINATE_ALL];
+
+    int steps = config.TimeSteps();
+    int n = states.size();
+    std::vector<Pose> poses((n - 1) * steps + 1);
+    poses[0] = pose_of(states[0].snapshot);
+
+#pragma omp parallel for num_threads(scheduler_threads()) schedule(dynamic, 1)
+    for (int i = 0; i < n - 1; i++) {
+        b2World world(b2Vec2(0.0f, config.gravity));
+        world.SetContactListener(&head_contact_listener);
+
+        Walker* w = new Walker(std::vector<WalkerState>{ states[i] }, &world);
+        const float* speeds = states[i + 1].mspeeds;
+        w->SetMotorSpeeds(speeds[UPPER_LEFT], speeds[UPPER_RIGHT],
+                          speeds[LOWER_LEFT], speeds[LOWER_RIGHT]);
+        steps_of(w, &world, &poses[i * steps + 1], steps);
+        delete w;
+    }
+    return poses;
+}
+
+// an RGB image, rows top to bottom
+struct Image {
+    int width, height;
+    std::vector<uint8_t> rgb;
+
+    Image(int w, int h) : width(w), height(h), rgb(3 * w * h) {}
+
+    void Fill(int x0, int y0, int x1, int y1, const uint8_t color[3])
+    {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, width);
+        y1 = std::min(y1, height);
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                memcpy(&rgb[3 * (y * width + x)], color, 3);
+            }
+        }
+    }
+};
+
+static const uint8_t SKY[3] = { 232, 238, 244 };
+static const uint8_t GROUND[2][3] = { { 120, 100, 80 }, { 136, 116, 94 } };
+static const uint8_t HEAD[3] = { 60, 110, 200 };
+static const uint8_t NEAR_LEG[3] = { 225, 125, 50 };
+static const uint8_t FAR_LEG[3] = { 165, 90, 40 };
+
+// world to pixel coordinates, following (cx, ground)
+struct Camera {
+    float cx, scale;
+    int width, horizon;
+
+    float X(float x) const { return width / 2 + (x - cx) * scale; }
+    float Y(float y) const { return horizon - (y - GROUND_Y) * scale; }
+};
+
+// fill the box of half size (hx, hy) centered at (x, y) and rotated by angle,
+// every pixel whose center lies inside it
+static void draw_box(Image& img, const Camera& cam, float x, float y,
+                     float angle, float hx, float hy, const uint8_t color[3])
+{
+    float px = cam.X(x), py = cam.Y(y);
+    float r = std::sqrt(hx * hx + hy * hy) * cam.scale + 1.0f;
+    int x0 = std::max(0, (int)std::floor(px - r));
+    int x1 = std::min(img.width, (int)std::ceil(px + r));
+    int y0 = std::max(0, (int)std::floor(py - r));
+    int y1 = std::min(img.height, (int)std::ceil(py + r));
+
+    // pixel offsets back to the box's frame (y points down in the image)
+    float c = std::cos(angle) / cam.scale, s = std::sin(angle) / cam.scale;
+    for (int j = y0; j < y1; j++) {
+        float dy = py - (j + 0.5f);
+        for (int i = x0; i < x1; i++) {
+            float dx = (i + 0.5f) - px;
+            float u = c * dx + s * dy;
+            float v = -s * dx + c * dy;
+            if (std::fabs(u) <= hx && std::fabs(v) <= hy) {
+                memcpy(&img.rgb[3 * (j * img.width + i)], color, 3);
+            }
+        }
+    }
+}
+
+static void draw_frame(Image& img, const Pose& p, const WalkerParameters& wp,
+                       float scale)
+{
+    Camera cam;
+    cam.cx = p.x[0];
+    cam.scale = scale;
+    cam.width = img.width;
+    cam.horizon = img.height * 3 / 4;
+
+    img.Fill(0, 0, img.width, cam.horizon, SKY);
+
+    // the ground in 1 m stripes, so that the motion shows with the camera
+    // following the walker
+    for (int i = 0; i < img.width; i++) {
+        float x = cam.cx + (i + 0.5f - img.width / 2) / scale;
+        const uint8_t* color = GROUND[(int)std::floor(x) & 1];
+        img.Fill(i, cam.horizon, i + 1, img.height, color);
+    }
+
+    // the far (right) legs behind the head, the near ones in front
+    const int order[N_BODIES] = { 1 + UPPER_RIGHT, 1 + LOWER_RIGHT, 0,
+                                  1 + UPPER_LEFT, 1 + LOWER_LEFT };
+    for (int b : order) {
+        float hx, hy;
+        const uint8_t* color;
+        if (b == 0) {
+            hx = wp.head_size.x / 2;
+            hy = wp.head_size.y / 2;
+            color = HEAD;
+        } else {
+            int leg = b - 1;
+            const b2Vec2& size = is_upper_leg(leg) ? wp.upper_leg_size
+                                                   : wp.lower_leg_size;
+            hx = size.x / 2;
+            hy = size.y / 2;
+            color = (leg % 2 == UPPER_LEFT) ? NEAR_LEG : FAR_LEG;
+        }
+        draw_box(img, cam, p.x[b], p.y[b], p.angle[b], hx, hy, color);
+    }
+}
+
+static bool write_ppm(const std::string& fname, const Image& img)
+{
+    FILE* f = fopen(fname.c_str(), "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", img.width, img.height);
+    bool ok = fwrite(img.rgb.data(), 1, img.rgb.size(), f) == img.rgb.size();
+    return fclose(f) == 0 && ok;
+}
+
+// deflate (RFC 1951) with the fixed Huffman codes, whose only matches are
+// repeats of the pixel to the left or of the row above; that's all frames of
+// flat colors need to shrink a lot, and it's fast
+class Deflater
+{
+private:
+    std::vector<uint8_t>& out;
+    uint32_t bits;
+    int n_bits;
+
+    void Bits(uint32_t value, int n)
+    {
+        bits |= value << n_bits;
+        n_bits += n;
+        while (n_bits >= 8) {
+            out.push_back(bits & 0xFF);
+            bits >>= 8;
+            n_bits -= 8;
+        }
+    }
+
+    // Huffman codes go most significant bit first
+    void Code(uint32_t code, int n)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < n; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        Bits(reversed, n);
+    }
+
+    void Symbol(int s)
+    {
+        if (s < 144) Code(0x30 + s, 8);
+        else if (s < 256) Code(0x190 + s - 144, 9);
+        else if (s < 280) Code(s - 256, 7);
+        else Code(0xC0 + s - 280, 8);
+    }
+
+    void Match(int length, int distance)
+    {
+        static const int length_base[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43,
+            51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const int length_extra[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4,
+            4, 4, 5, 5, 5, 5, 0 };
+        static const int distance_base[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257,
+            385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+            16385, 24577 };
+
+        int l = 28;
+        while (length_base[l] > length) l--;
+        Symbol(257 + l);
+        Bits(length - length_base[l], length_extra[l]);
+
+        int d = 29;
+        while (distance_base[d] > distance) d--;
+        Code(d, 5);
+        Bits(distance - distance_base[d], d < 4 ? 0 : d / 2 - 1);
+    }
+
+public:
+    Deflater(std::vector<uint8_t>& out) : out(out), bits(0), n_bits(0) {}
+
+    // compress all of data as one final block; `stride` is the row length
+    void Compress(const std::vector<uint8_t>& data, int stride)
+    {
+        Bits(1, 1);                         // final block
+        Bits(1, 2);                         // fixed Huffman codes
+
+        int n = data.size();
+        const int distances[2] = { 3, stride };
+        for (int i = 0; i < n;) {
+            int best = 0, best_distance = 0;
+            for (int distance : distances) {
+                if (distance > i || distance > 32768) continue;
+                int length = 0;
+                while (length < 258 && i + length < n &&
+                       data[i + length] == data[i + length - distance]) {
+                    length++;
+                }
+                if (length > best) {
+                    best = length;
+                    best_distance = distance;
+                }
+            }
+
+            if (best >= 3) {
+                Match(best, best_distance);
+                i += best;
+            } else {
+                Symbol(data[i++]);
+            }
+        }
+
+        Symbol(256);                        // end of block
+        if (n_bits > 0) Bits(0, 8 - n_bits);
+    }
+};
+
+static uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool ready = false;
+#pragma omp critical(render_crc_table)
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_u32(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+static void png_chunk(std::vector<uint8_t>& out, const char* type,
+                      const std::vector<uint8_t>& data)
+{
+    put_u32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32(out, crc32(&out[start], out.size() - start));
+}
+
+static bool write_png(const std::string& fname, const Image& img)
+{
+    // rows, each after a filter type byte (0 = none)
+    int stride = 1 + 3 * img.width;
+    std::vector<uint8_t> raw(stride * img.height);
+    for (int y = 0; y < img.height; y++) {
+        raw[y * stride] = 0;
+        memcpy(&raw[y * stride + 1], &img.rgb[3 * y * img.width],
+               3 * img.width);
+    }
+
+    // zlib stream: header, deflate data, Adler-32 of the raw data
+    std::vector<uint8_t> idat = { 0x78, 0x01 };
+    Deflater(idat).Compress(raw, stride);
+    // (sums of 5552 bytes can't overflow before the modulo)
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); i += 5552) {
+        size_t end = std::min(raw.size(), i + 5552);
+        for (size_t j = i; j < end; j++) {
+            a += raw[j];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    put_u32(idat, (b << 16) | a);
+
+    std::vector<uint8_t> ihdr;
+    put_u32(ihdr, img.width);
+    put_u32(ihdr, img.height);
+    ihdr.push_back(8);                      // bits per channel
+    ihdr.push_back(2);                      // RGB
+    ihdr.push_back(0);                      // deflate
+    ihdr.push_back(0);                      // adaptive filtering
+    ihdr.push_back(0);                      // no interlacing
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n',
+                                          0x1A, '\n' };
+    std::vector<uint8_t> png(signature, signature + 8);
+    png_chunk(png, "IHDR", ihdr);
+    png_chunk(png, "IDAT", idat);
+    png_chunk(png, "IEND", std::vector<uint8_t>());
+
+    FILE* f = fopen(fname.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(png.data(), 1, png.size(), f) == png.size();
+    return fclose(f) == 0 && ok;
+}
+
+static bool ends_with(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// the tip (a state nothing was bred from) that walked farthest, its head's x
+// being its fitness, the latest of equally fit ones; a dumped file has a
+// single tip, its last state
+static uint64_t fittest_tip(const TrajectoryFile& file)
+{
+    uint64_t n = file.Size();
+    std::vector<bool> bred(n + 1, false);
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t parent = file.Record(i).parent;
+        if (parent <= n) bred[parent] = true;
+    }
+
+    uint64_t best = file.Record(n - 1).node;
+    float best_x = -INFINITY;
+    for (uint64_t i = 0; i < n; i++) {
+        const TrajectoryRecord& r = file.Record(i);
+        if (r.node == 0 || r.node > n || bred[r.node]) continue;
+        if (r.head_world_center[0] >= best_x) {
+            best = r.node;
+            best_x = r.head_world_center[0];
+        }
+    }
+    return best;
+}
+
+// the lineage in a .traj or .trajz file, and the settings it was simulated
+// with; for a streamed file, the one leading up to --node (by default, the
+// fittest tip)
+static bool load(const std::string& fname, std::vector<WalkerState>& states)
+{
+    if (ends_with(fname, TRAJECTORY_CODEC_EXTENSION)) {
+        if (options.node != 0) {
+            std::cout   << "[render_frames.cpp] " << fname << " holds a single "
+                        << "lineage, it has no nodes to pick from" << std::endl;
+            return false;
+        }
+        TrajectorySimulation simulation;
+        if (!read_compressed(fname, states, &simulation)) return false;
+        unpack_simulation(simulation, config);
+        return true;
+    }
+
+    TrajectoryFile file;
+    if (!file.Open(fname)) return false;
+    if (file.Size() == 0) {
+        std::cout << "[render_frames.cpp] " << fname << " holds no states"
+                  << std::endl;
+        return false;
+    }
+    if (options.node > file.Size()) {
+        std::cout   << "[render_frames.cpp] " << fname << " has no node "
+                    << options.node << " (1 to " << file.Size() << ")"
+                    << std::endl;
+        return false;
+    }
+    unpack_simulation(file.simulation, config);
+
+    uint64_t node = options.node ? options.node : fittest_tip(file);
+    states = file.Lineage(node);
+    std::cout   << "Rendering the lineage of node " << node << std::endl;
+    return !states.empty();
+}
+
+// [USAGE] ./render_frames TRAJECTORY [--out DIR] [--format png|ppm]
+//                         [--size WIDTHxHEIGHT] [--fps N] [--scale PX_PER_M]
+//                         [--threads N] [--node N]
+int main(int argc, char *argv[])
+{
+    std::string fname;
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        bool ok = true;
+
+        if (arg == "--out" && has_value) {
+            options.out = argv[++a];
+        } else if (arg == "--format" && has_value) {
+            std::string format = argv[++a];
+            options.png = format == "png";
+            ok = options.png || format == "ppm";
+        } else if (arg == "--size" && has_value) {
+            ok = sscanf(argv[++a], "%dx%d", &options.width,
+                        &options.height) == 2 &&
+                 options.width > 0 && options.height > 0;
+        } else if (arg == "--fps" && has_value) {
+            options.fps = atof(argv[++a]);
+            ok = options.fps > 0.0f;
+        } else if (arg == "--scale" && has_value) {
+            options.scale = atof(argv[++a]);
+            ok = options.scale > 0.0f;
+        } else if (arg == "--node" && has_value) {
+            options.node = strtoull(argv[++a], nullptr, 10);
+            ok = options.node > 0;
+        } else if (arg == "--threads" && has_value) {
+            config.threads = atoi(argv[++a]);
+            ok = config.threads >= 0;
+        } else if (fname.empty() && arg.compare(0, 2, "--") != 0) {
+            fname = arg;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cout   << "[render_frames.cpp] invalid argument " << arg
+                        << std::endl;
+            return 1;
+        }
+    }
+    if (fname.empty()) fname = DEFAULT_DUMP_FNAME;
+
+    std::vector<WalkerState> states;
+    if (!load(fname, states)) return 1;
+    scheduler_init(config.threads, false);
+
+    double t0 = omp_get_wtime();
+    std::vector<Pose> poses = replay(states);
+    double t1 = omp_get_wtime();
+
+    // by default, the walker standing on the ground takes up half the height
+    const WalkerParameters& wp = states[0].wp;
+    float scale = options.scale;
+    if (scale == 0.0f) {
+        float height = wp.head_size.y + wp.upper_leg_size.y +
+                       wp.lower_leg_size.y;
+        scale = options.height / (2.0f * height);
+    }
+
+    if (mkdir(options.out.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cout   << "[render_frames.cpp] could not create " << options.out
+                    << std::endl;
+        return 1;
+    }
+
+    // frame f shows time f / fps, at the last step taken by then
+    int steps = config.TimeSteps();
+    float duration = (states.size() - 1) * config.iteration_time;
+    int n_frames = (int)std::floor(duration * options.fps) + 1;
+    int failed = 0;
+
+#pragma omp parallel num_threads(scheduler_threads()) reduction(+:failed)
+    {
+        Image img(options.width, options.height);
+
+#pragma omp for schedule(dynamic, 1)
+        for (int f = 0; f < n_frames; f++) {
+            float t = f / options.fps;
+            int iteration = std::min((int)(t / config.iteration_time),
+                                     (int)states.size() - 1);
+            float within = t - iteration * config.iteration_time;
+            int step = iteration * steps +
+                       std::min(steps, (int)(within * config.hertz));
+            step = std::min(step, (int)poses.size() - 1);
+
+            draw_frame(img, poses[step], wp, scale);
+
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%06d.%s", f,
+                     options.png ? "png" : "ppm");
+            std::string path = options.out + name;
+            if (!(options.png ? write_png(path, img) : write_ppm(path, img))) {
+                failed++;
+            }
+        }
+    }
+    double t2 = omp_get_wtime();
+
+    if (failed > 0) {
+        std::cout   << "[render_frames.cpp] could not write " << failed
+                    << " frame(s) to " << options.out << std::endl;
+        return 1;
+    }
+    std::cout   << "Rendered " << n_frames << " " << options.width << "x"
+                << options.height << " frames of " << states.size()
+                << " states to " << options.out << " in "
+                << 1000.0 * (t2 - t0) << "ms (replay " << 1000.0 * (t1 - t0)
+                << "ms) on " << scheduler_threads() << " threads" << std::endl;
+    return 0;
+}
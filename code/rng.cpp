@@ -0,0 +1,107 @@
+#include <cmath>
+#include <random>
+#include "rng.h"
+
+// Philox4x32 round multipliers and Weyl key increments
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+#define TWO_PI 6.28318530718f
+
+Rng::Rng(uint64_t seed, uint32_t generation, uint32_t index)
+{
+	key[0] = (uint32_t)seed;
+	key[1] = (uint32_t)(seed >> 32);
+
+	// the low words count blocks, the high words select the stream
+	counter[0] = 0;
+	counter[1] = 0;
+	counter[2] = generation;
+	counter[3] = index;
+
+	used = 4;
+	has_spare = false;
+	spare = 0.0f;
+}
+
+// encrypt the counter into the next block of 4 random words
+void Rng::Next()
+{
+	uint32_t c[4] = { counter[0], counter[1], counter[2], counter[3] };
+	uint32_t k[2] = { key[0], key[1] };
+
+	for (int r = 0; r < PHILOX_ROUNDS; r++)
+	{
+		uint64_t p0 = (uint64_t)PHILOX_M0 * c[0];
+		uint64_t p1 = (uint64_t)PHILOX_M1 * c[2];
+		uint32_t hi0 = p0 >> 32, lo0 = (uint32_t)p0;
+		uint32_t hi1 = p1 >> 32, lo1 = (uint32_t)p1;
+
+		c[0] = hi1 ^ c[1] ^ k[0];
+		c[1] = lo1;
+		c[2] = hi0 ^ c[3] ^ k[1];
+		c[3] = lo0;
+
+		k[0] += PHILOX_W0;
+		k[1] += PHILOX_W1;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		block[i] = c[i];
+	}
+	used = 0;
+
+	if (++counter[0] == 0)
+	{
+		counter[1]++;
+	}
+}
+
+uint32_t Rng::Uint()
+{
+	if (used == 4)
+	{
+		Next();
+	}
+	return block[used++];
+}
+
+// top 24 bits, i.e. every float in [0, 1) the mantissa can represent evenly
+float Rng::Uniform()
+{
+	return (Uint() >> 8) * (1.0f / 16777216.0f);
+}
+
+// Box-Muller transform
+float Rng::Normal(float mean, float stdev)
+{
+	if (has_spare)
+	{
+		has_spare = false;
+		return mean + stdev * spare;
+	}
+
+	// (0, 1] so the log is finite
+	float u1 = ((Uint() >> 8) + 1) * (1.0f / 16777216.0f);
+	float u2 = Uniform();
+	float r = std::sqrt(-2.0f * std::log(u1));
+
+	spare = r * std::sin(TWO_PI * u2);
+	has_spare = true;
+	return mean + stdev * r * std::cos(TWO_PI * u2);
+}
+
+int Rng::Index(int n)
+{
+	return (int)(((uint64_t)Uint() * n) >> 32);
+}
+
+uint64_t random_seed()
+{
+	std::random_device rd;
+	return ((uint64_t)rd() << 32) | rd();
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <vector>
+#include <sched.h>
+#include <omp.h>
+#include "scheduler.h"
+#include "statics.h"
+
+static int n_threads = 1;
+static bool pinned = false;
+
+void scheduler_init(int threads, bool pin)
+{
+	// the cores this process may run on (e.g. restricted by taskset)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+	{
+		CPU_ZERO(&allowed);
+		for (int c = 0; c < omp_get_num_procs() && c < CPU_SETSIZE; c++)
+		{
+			CPU_SET(c, &allowed);
+		}
+	}
+
+	std::vector<int> cores;
+	for (int c = 0; c < CPU_SETSIZE; c++)
+	{
+		if (CPU_ISSET(c, &allowed)) cores.push_back(c);
+	}
+	if (cores.empty()) cores.push_back(0);
+
+	n_threads = threads > 0 ? threads : (int)cores.size();
+	omp_set_num_threads(n_threads);
+
+	if (!pin) return;
+
+	// OpenMP keeps the same worker threads around between parallel regions
+	// of the same size, so binding them once is enough
+	int failed = 0;
+#pragma omp parallel num_threads(n_threads) reduction(+:failed)
+	{
+		cpu_set_t one;
+		CPU_ZERO(&one);
+		CPU_SET(cores[omp_get_thread_num() % cores.size()], &one);
+		if (sched_setaffinity(0, sizeof(one), &one) != 0) failed++;
+	}
+
+	pinned = failed == 0;
+	if (!pinned)
+	{
+		std::cout	<< "[scheduler.cpp] could not pin " << failed << " of "
+					<< n_threads << " threads" << std::endl;
+	}
+}
+
+int scheduler_threads()
+{
+	return n_threads;
+}
+
+bool scheduler_pinned()
+{
+	return pinned;
+}
+
+int scheduler_grain(int n, int multiple)
+{
+	if (multiple < 1) multiple = 1;
+
+	int grain = n / (n_threads * SCHEDULER_CHUNKS_PER_THREAD);
+	grain = (grain / multiple) * multiple;
+	return grain > multiple ? grain : multiple;
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cmath>
+#include "selection.h"
+#include "statics.h"
+#include "rng.h"
+#include "scheduler.h"
+
+TopK::TopK(int k, const float* fitness)
+{
+	this->k = k;
+	fitter.fitness = fitness;
+	heap.reserve(k);
+}
+
+// the order is total, so the k kept don't depend on the order of the pushes
+void TopK::Push(int i)
+{
+	if ((int)heap.size() < k)
+	{
+		heap.push_back(i);
+		std::push_heap(heap.begin(), heap.end(), fitter);
+	}
+	else if (k > 0 && fitter(i, heap.front()))
+	{
+		std::pop_heap(heap.begin(), heap.end(), fitter);
+		heap.back() = i;
+		std::push_heap(heap.begin(), heap.end(), fitter);
+	}
+}
+
+void TopK::Merge(const TopK& other)
+{
+	for (int i : other.heap)
+	{
+		Push(i);
+	}
+}
+
+std::vector<int> TopK::Sorted() const
+{
+	std::vector<int> sorted = heap;
+	std::sort(sorted.begin(), sorted.end(), fitter);
+	return sorted;
+}
+
+bool parse_selection(const std::string& name, SelectionMode& mode)
+{
+	if (name == "topk") mode = SELECT_TOP_K;
+	else if (name == "tournament") mode = SELECT_TOURNAMENT;
+	else if (name == "sus") mode = SELECT_SUS;
+	else return false;
+	return true;
+}
+
+const char* selection_name(SelectionMode mode)
+{
+	switch (mode)
+	{
+		case SELECT_TOURNAMENT: return "tournament";
+		case SELECT_SUS: return "sus";
+		default: return "topk";
+	}
+}
+
+// each block of SELECTION_BLOCK walkers is partitioned down to its own k
+// fittest in parallel, then the survivors of all blocks are partitioned once
+// more; both passes are nth_element, so the whole thing is O(n)
+std::vector<int> select_top_k(const std::vector<float>& fitness, int k)
+{
+	int n = fitness.size();
+	k = std::min(k, n);
+	if (k <= 0) return std::vector<int>();
+
+	FitterThan fitter = { fitness.data() };
+	int n_blocks = (n + SELECTION_BLOCK - 1) / SELECTION_BLOCK;
+	std::vector<std::vector<int> > candidates(n_blocks);
+
+#pragma omp parallel for num_threads(scheduler_threads())
+	for (int b = 0; b < n_blocks; b++)
+	{
+		int first = b * SELECTION_BLOCK;
+		int last = std::min(n, first + SELECTION_BLOCK);
+		std::vector<int>& c = candidates[b];
+
+		c.resize(last - first);
+		for (int i = first; i < last; i++)
+		{
+			c[i - first] = i;
+		}
+		if (k < (int)c.size())
+		{
+			std::nth_element(c.begin(), c.begin() + k, c.end(), fitter);
+			c.resize(k);
+		}
+	}
+
+	std::vector<int> selected;
+	for (int b = 0; b < n_blocks; b++)
+	{
+		selected.insert(selected.end(), candidates[b].begin(),
+						candidates[b].end());
+	}
+	std::nth_element(selected.begin(), selected.begin() + k - 1,
+						selected.end(), fitter);
+	selected.resize(k);
+	std::sort(selected.begin(), selected.end(), fitter);
+
+	return selected;
+}
+
+// each of the k survivors is the fittest of TOURNAMENT_SIZE walkers drawn
+// (with replacement) from the whole population; O(k * TOURNAMENT_SIZE)
+std::vector<int> select_tournament(const std::vector<float>& fitness, int k,
+									uint64_t seed, int generation)
+{
+	int n = fitness.size();
+	if (n == 0 || k <= 0) return std::vector<int>();
+
+	FitterThan fitter = { fitness.data() };
+	std::vector<int> selected(k);
+
+#pragma omp parallel for num_threads(scheduler_threads())
+	for (int t = 0; t < k; t++)
+	{
+		Rng rng(seed, generation, RNG_GENERATION_STREAM | t);
+		int winner = rng.Index(n);
+		for (int r = 1; r < TOURNAMENT_SIZE; r++)
+		{
+			int challenger = rng.Index(n);
+			if (fitter(challenger, winner)) winner = challenger;
+		}
+		selected[t] = winner;
+	}
+
+	std::sort(selected.begin(), selected.end(), fitter);
+	return selected;
+}
+
+// k equally spaced pointers with a single random offset over the walkers laid
+// end to end, each taking up room proportional to its fitness; fitness is the
+// distance walked and can be negative, so it's shifted to start at 0 first
+std::vector<int> select_sus(const std::vector<float>& fitness, int k,
+									uint64_t seed, int generation)
+{
+	int n = fitness.size();
+	if (n == 0 || k <= 0) return std::vector<int>();
+
+	// a walker that blew up (non-finite fitness) takes up no room, and is left
+	// out of the lowest fitness and the total
+	float lowest = INFINITY;
+	int live = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (std::isfinite(fitness[i]))
+		{
+			lowest = std::min(lowest, fitness[i]);
+			live++;
+		}
+	}
+	std::vector<double> width(n, 0.0);
+	double total = 0.0;
+	for (int i = 0; i < n; i++)
+	{
+		if (std::isfinite(fitness[i]))
+		{
+			width[i] = fitness[i] - lowest;
+			total += width[i];
+		}
+	}
+
+	// everyone walked the same distance: all walkers take up the same room
+	// (all of them only if none has a finite fitness)
+	if (!(total > 0.0))
+	{
+		for (int i = 0; i < n; i++)
+		{
+			width[i] = (live == 0 || std::isfinite(fitness[i])) ? 1.0 : 0.0;
+		}
+		total = live > 0 ? live : n;
+	}
+
+	// rounding can carry the last pointer past the end: it goes to the last
+	// walker with room
+	int last = n - 1;
+	while (last > 0 && width[last] == 0.0) last--;
+
+	Rng rng(seed, generation, RNG_GENERATION_STREAM);
+	double step = total / k;
+	double pointer = rng.Uniform() * step;
+
+	std::vector<int> selected(k);
+	double end = 0.0;
+	int i = -1;
+	for (int s = 0; s < k; s++)
+	{
+		while (end <= pointer && i < last)
+		{
+			i++;
+			end += width[i];
+		}
+		selected[s] = i;
+		pointer += step;
+	}
+
+	FitterThan fitter = { fitness.data() };
+	std::sort(selected.begin(), selected.end(), fitter);
+	return selected;
+}
+
+std::vector<int> select(SelectionMode mode, const std::vector<float>& fitness,
+									int k, uint64_t seed, int generation)
+{
+	switch (mode)
+	{
+		case SELECT_TOURNAMENT:
+			return select_tournament(fitness, k, seed, generation);
+		case SELECT_SUS:
+			return select_sus(fitness, k, seed, generation);
+		default:
+			return select_top_k(fitness, k);
+	}
+}
@@ -0,0 +1,63 @@
+#include <sstream>
+#include "termination.h"
+#include "walker.h"
+
+HeadContactListener head_contact_listener;
+
+static const char* names[] = { "contact", "height", "sleep", "stall" };
+#define N_PREDICATES 4
+
+bool parse_termination(const std::string& list, int& mask)
+{
+	mask = 0;
+	if (list == "none") return true;
+
+	std::stringstream ss(list);
+	std::string name;
+	while (std::getline(ss, name, ','))
+	{
+		int bit = -1;
+		for (int i = 0; i < N_PREDICATES; i++)
+		{
+			if (name == names[i]) bit = i;
+		}
+		if (bit < 0) return false;
+		mask |= 1 << bit;
+	}
+	return true;
+}
+
+std::string termination_names(int mask)
+{
+	std::string list;
+	for (int i = 0; i < N_PREDICATES; i++)
+	{
+		if (!(mask & (1 << i))) continue;
+		if (!list.empty()) list.append(",");
+		list.append(names[i]);
+	}
+	return list.empty() ? "none" : list;
+}
+
+// a Walker's own parts collide with each other (see Walker::Filter()), so only
+// the ground, and anything else static, counts
+bool HeadContactListener::Ground(b2Fixture* other)
+{
+	return (other->GetFilterData().categoryBits & GROUND_CATEGORY) ||
+			other->GetBody()->GetType() == b2_staticBody;
+}
+
+// heads carry a pointer to their Walker as user data (see Walker::Build_Head())
+void HeadContactListener::BeginContact(b2Contact* contact)
+{
+	b2Fixture* fixtures[2] = { contact->GetFixtureA(), contact->GetFixtureB() };
+	for (int i = 0; i < 2; i++)
+	{
+		b2Body* body = fixtures[i]->GetBody();
+		Walker* w = (Walker*)body->GetUserData().pointer;
+		if (w && body == w->head && Ground(fixtures[1 - i]))
+		{
+			w->head_contact = true;
+		}
+	}
+}
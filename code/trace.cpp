@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "trace.h"
+
+#ifdef WALKER_TRACE
+
+namespace
+{
+
+// one thread's events; only its thread writes to it
+struct TraceBuffer
+{
+	int tid;
+	uint64_t count = 0;						// events ever recorded
+	std::vector<TraceEvent> events;
+
+	TraceBuffer(int tid) : tid(tid), events(TRACE_BUFFER_EVENTS) {}
+
+	void Record(const TraceEvent& e)
+	{
+		events[count % TRACE_BUFFER_EVENTS] = e;
+		count++;
+	}
+};
+
+bool recording = false;
+std::chrono::steady_clock::time_point epoch;
+
+// every thread's buffer, in the order threads first recorded; only touched
+// when a thread records for the first time, and by trace_write()
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+thread_local TraceBuffer* local = nullptr;
+
+uint64_t now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - epoch).count();
+}
+
+TraceBuffer* local_buffer()
+{
+	if (!local)
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		local = new TraceBuffer(buffers.size());
+		buffers.emplace_back(local);
+	}
+	return local;
+}
+
+}
+
+TraceScope::TraceScope(const char* name, int64_t arg)
+	: name(name), arg(arg), start(recording ? now() : 0)
+{
+}
+
+TraceScope::~TraceScope()
+{
+	if (!recording) return;
+
+	TraceEvent e;
+	e.name = name;
+	e.start = start;
+	e.duration = now() - start;
+	e.arg = arg;
+	local_buffer()->Record(e);
+}
+
+bool trace_start()
+{
+	epoch = std::chrono::steady_clock::now();
+	recording = true;
+	return true;
+}
+
+bool trace_write(const std::string& fname)
+{
+	FILE* out = fopen(fname.c_str(), "w");
+	if (!out)
+	{
+		std::cout << "[trace.cpp] could not open " << fname << std::endl;
+		return false;
+	}
+
+	// complete ("X") events in microseconds, plus a name for each thread's row
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const std::unique_ptr<TraceBuffer>& b : buffers)
+	{
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+				"\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+				first ? "" : ",\n", b->tid, b->tid);
+		first = false;
+
+		uint64_t n = std::min<uint64_t>(b->count, TRACE_BUFFER_EVENTS);
+		for (uint64_t i = b->count - n; i < b->count; i++)
+		{
+			const TraceEvent& e = b->events[i % TRACE_BUFFER_EVENTS];
+			fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+					"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", e.name, b->tid,
+					e.start / 1e3, e.duration / 1e3);
+			if (e.arg >= 0)
+			{
+				fprintf(out, ",\"args\":{\"n\":%lld}", (long long)e.arg);
+			}
+			fprintf(out, "}");
+		}
+
+		if (b->count > TRACE_BUFFER_EVENTS)
+		{
+			std::cout << "[trace.cpp] thread " << b->tid << " dropped its "
+						<< b->count - TRACE_BUFFER_EVENTS << " oldest events"
+						<< std::endl;
+		}
+	}
+	fprintf(out, "\n]}\n");
+
+	if (fclose(out) != 0)
+	{
+		std::cout << "[trace.cpp] could not write " << fname << std::endl;
+		return false;
+	}
+	return true;
+}
+
+#else
+
+bool trace_start()
+{
+	std::cout << "[trace.cpp] tracing isn't compiled in (build with "
+				<< "`make TRACE=1`)" << std::endl;
+	return false;
+}
+
+bool trace_write(const std::string&)
+{
+	return false;
+}
+
+#endif
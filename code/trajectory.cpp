@@ -1,41 +1,52 @@
-#include <fstream>
 #include <vector>
 #include "test.h"
 #include "settings.h"
-#include "nlohmann/json.hpp"
 #include "walker.h"
 #include "statics.h"
+#include "trajectory_file.h"
+#include "config.h"
 
-#define WALKER_FILE "/team17/trajectory.json"
-
-using json = nlohmann::json;
+#define WALKER_FILE "/team17/trajectory.traj"
 
 class WalkerTrajectory : public Test
 {
 public:
 	Walker* walky;
-	json dump;
+	TrajectoryFile dump;
 	int state_i;
 
 	WalkerTrajectory()
 	{
-		// re-create the initial Walker based on the set walker dump file
-		std::ifstream inf(WALKER_FILE);
-		dump = json::parse(inf);
-		std::vector<WalkerState> dump0 = { dump.at(0) };
-		walky = new Walker(dump0, m_world);
-
+		// re-create the initial Walker based on the set walker dump file; the
+		// file is mapped, and states are read in place as they're needed; it
+		// is simulated with the run's settings, which the file keeps
+		walky = nullptr;
 		state_i = 0;
+		if (dump.Open(WALKER_FILE) && dump.Size() > 0)
+		{
+			unpack_simulation(dump.simulation, config);
+			std::vector<WalkerState> dump0 = { dump.State(0) };
+			walky = new Walker(dump0, m_world);
+		}
 	}
 
 	void Step(Settings& settings) override
 	{
-		settings.m_hertz = SIM_HERTZ;
-		settings.m_positionIterations = SIM_POS_ITER;
-		settings.m_velocityIterations = SIM_VEL_ITER;
+		settings.m_hertz = config.hertz;
+		settings.m_positionIterations = config.position_iterations;
+		settings.m_velocityIterations = config.velocity_iterations;
+
+		if (!walky)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "Could not read %s",
+									WALKER_FILE);
+			m_textLine += m_textIncrement;
+			Test::Step(settings);
+			return;
+		}
 
 		// clock
-		float time_estimate = m_stepCount * (1.0f / SIM_HERTZ);
+		float time_estimate = m_stepCount * config.TimeStep();
 		g_debugDraw.DrawString(5, m_textLine, "Simulation time = %f", 
 								time_estimate);
 		m_textLine += m_textIncrement;
@@ -49,18 +60,21 @@ public:
 		g_debugDraw.DrawString(5, m_textLine, "State # = %d", state_i);
 		m_textLine += m_textIncrement;
 
-		// update Walker motors as often as Walker->Simulate()
-		if (m_stepCount % N_ITER_TIMESTEPS == 0)
+		// update Walker motors as often as Walker->Simulate(); a state holds the
+		// motor speeds of the iteration that led up to it, so iteration i is
+		// driven by those of state i + 1 (state 0 has none)
+		if (m_stepCount % config.TimeSteps() == 0)
 		{
-			if (state_i < dump.size())
+			if (state_i + 1 < (int)dump.Size())
 			{
-				// WalkerState dump_state = dump.at(state_i);
+				// WalkerState dump_state = dump.State(state_i);
 				// dump_state.Diff(WalkerState(walky)).Print();
 				
-				walky->SetMotorSpeeds(	(float) dump.at(state_i)["mspeeds"][0],
-										(float) dump.at(state_i)["mspeeds"][1],
-										(float) dump.at(state_i)["mspeeds"][2],
-										(float) dump.at(state_i)["mspeeds"][3]);
+				const TrajectoryRecord& record = dump.Record(state_i + 1);
+				walky->SetMotorSpeeds(	record.mspeeds[UPPER_LEFT],
+										record.mspeeds[UPPER_RIGHT],
+										record.mspeeds[LOWER_LEFT],
+										record.mspeeds[LOWER_RIGHT]);
 
 				state_i++;
 			}
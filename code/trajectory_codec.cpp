@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "trajectory_codec.h"
+#include "config.h"
+
+// the part of a TrajectoryRecord that's encoded: every field from state_index
+// on is 4 bytes wide, so a record is treated as an array of 32-bit words
+#define CODEC_FIRST_WORD offsetof(TrajectoryRecord, state_index)
+#define CODEC_N_FIELDS ((sizeof(TrajectoryRecord) - CODEC_FIRST_WORD) / 4)
+
+// quantized values are kept below this (in steps), so that deltas and their
+// zigzag encoding fit in CODEC_MAX_WIDTH bits
+#define CODEC_QUANT_LIMIT 1073741824.0		// 2^30
+#define CODEC_MAX_WIDTH 33
+#define CODEC_EXACT_FLAG 0x80
+
+static_assert((sizeof(TrajectoryRecord) - CODEC_FIRST_WORD) % 4 == 0,
+				"trajectory records aren't made of 32-bit fields");
+
+enum FieldKind { KIND_EXACT, KIND_POSITION, KIND_ANGLE, KIND_VELOCITY,
+					KIND_SPEED };
+
+static void set_kind(std::vector<int>& kinds, size_t offset, size_t size,
+						int kind)
+{
+	for (size_t i = 0; i < size / 4; i++)
+	{
+		kinds[(offset - CODEC_FIRST_WORD) / 4 + i] = kind;
+	}
+}
+
+static void set_body_kinds(std::vector<int>& kinds, size_t offset)
+{
+	set_kind(kinds, offset + offsetof(TrajectoryBody, position),
+				2 * sizeof(float), KIND_POSITION);
+	set_kind(kinds, offset + offsetof(TrajectoryBody, angle),
+				sizeof(float), KIND_ANGLE);
+	set_kind(kinds, offset + offsetof(TrajectoryBody, linear_velocity),
+				3 * sizeof(float), KIND_VELOCITY);
+}
+
+// the kind of every field, i.e. which quantization step it gets
+static std::vector<int> field_kinds()
+{
+	std::vector<int> kinds(CODEC_N_FIELDS, KIND_EXACT);
+	set_kind(kinds, offsetof(TrajectoryRecord, head_world_center),
+				sizeof(TrajectoryRecord::head_world_center), KIND_POSITION);
+	set_kind(kinds, offsetof(TrajectoryRecord, head_angle),
+				sizeof(TrajectoryRecord::head_angle), KIND_ANGLE);
+	set_kind(kinds, offsetof(TrajectoryRecord, legs_world_center),
+				sizeof(TrajectoryRecord::legs_world_center), KIND_POSITION);
+	set_kind(kinds, offsetof(TrajectoryRecord, legs_angle),
+				sizeof(TrajectoryRecord::legs_angle), KIND_ANGLE);
+	set_kind(kinds, offsetof(TrajectoryRecord, mspeeds),
+				sizeof(TrajectoryRecord::mspeeds), KIND_SPEED);
+	set_kind(kinds, offsetof(TrajectoryRecord, jspeeds),
+				sizeof(TrajectoryRecord::jspeeds), KIND_VELOCITY);
+	set_kind(kinds, offsetof(TrajectoryRecord, jangles),
+				sizeof(TrajectoryRecord::jangles), KIND_ANGLE);
+	set_body_kinds(kinds, offsetof(TrajectoryRecord, head));
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		set_body_kinds(kinds, offsetof(TrajectoryRecord, legs)
+								+ i * sizeof(TrajectoryBody));
+	}
+	// state_index, max_torque and awake stay exact
+	return kinds;
+}
+
+static std::vector<float> field_steps(const TrajectoryQuantization& q)
+{
+	std::vector<int> kinds = field_kinds();
+	std::vector<float> steps(kinds.size());
+	for (size_t f = 0; f < kinds.size(); f++)
+	{
+		switch (kinds[f])
+		{
+			case KIND_POSITION: steps[f] = q.position; break;
+			case KIND_ANGLE: steps[f] = q.angle; break;
+			case KIND_VELOCITY: steps[f] = q.velocity; break;
+			case KIND_SPEED: steps[f] = q.speed; break;
+			default: steps[f] = 0.0f;
+		}
+	}
+	return steps;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static int bit_width(uint64_t v)
+{
+	int width = 0;
+	while (v)
+	{
+		width++;
+		v >>= 1;
+	}
+	return width;
+}
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+// appends values of up to CODEC_MAX_WIDTH bits, least significant bit first
+class BitWriter
+{
+private:
+	std::vector<uint8_t>& out;
+	uint64_t acc;
+	int bits;
+
+public:
+	BitWriter(std::vector<uint8_t>& o) : out(o), acc(0), bits(0) {}
+
+	void Put(uint64_t v, int width)
+	{
+		acc |= v << bits;
+		bits += width;
+		while (bits >= 8)
+		{
+			out.push_back((uint8_t)acc);
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+
+	void Align()
+	{
+		if (bits > 0)
+		{
+			out.push_back((uint8_t)acc);
+		}
+		acc = 0;
+		bits = 0;
+	}
+};
+
+// reads what BitWriter wrote; every read is bounds checked, and a reader that
+// ran past the end stays failed
+class BitReader
+{
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t pos;
+	uint64_t acc;
+	int bits;
+
+public:
+	bool failed;
+
+	BitReader(const uint8_t* d, size_t s)
+		: data(d), size(s), pos(0), acc(0), bits(0), failed(false) {}
+
+	uint64_t Get(int width)
+	{
+		while (bits < width)
+		{
+			if (pos >= size)
+			{
+				failed = true;
+				return 0;
+			}
+			acc |= (uint64_t)data[pos++] << bits;
+			bits += 8;
+		}
+		uint64_t v = width ? acc & (~0ull >> (64 - width)) : 0;
+		acc = width < 64 ? acc >> width : 0;
+		bits -= width;
+		return v;
+	}
+
+	void Align()
+	{
+		acc = 0;
+		bits = 0;
+	}
+
+	uint8_t Byte()
+	{
+		Align();
+		return (uint8_t)Get(8);
+	}
+
+	uint64_t Varint()
+	{
+		uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t b = Byte();
+			v |= (uint64_t)(b & 0x7F) << shift;
+			if (!(b & 0x80) || failed) return v;
+		}
+		failed = true;
+		return 0;
+	}
+};
+
+std::vector<uint8_t> encode_trajectory(const std::vector<WalkerState>& states,
+										const TrajectoryQuantization& q)
+{
+	const size_t n_fields = CODEC_N_FIELDS;
+	std::vector<float> steps = field_steps(q);
+
+	// records, field by field, so that a field's values within a block are
+	// next to each other
+	size_t n = states.size();
+	std::vector<uint32_t> words(n_fields * n);
+	for (size_t i = 0; i < n; i++)
+	{
+		TrajectoryRecord r = pack_state(states[i]);
+		uint32_t w[CODEC_N_FIELDS];
+		memcpy(w, (const char*)&r + CODEC_FIRST_WORD, sizeof(w));
+		for (size_t f = 0; f < n_fields; f++)
+		{
+			words[f * n + i] = w[f];
+		}
+	}
+
+	TrajectoryCodecHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = TRAJECTORY_CODEC_MAGIC;
+	h.version = TRAJECTORY_CODEC_VERSION;
+	h.header_size = sizeof(TrajectoryCodecHeader);
+	h.n_fields = n_fields;
+	h.n_states = n;
+	h.steps = q;
+	if (n > 0)
+	{
+		const WalkerParameters& wp = states[0].wp;
+		h.head_size[0] = wp.head_size.x;
+		h.head_size[1] = wp.head_size.y;
+		h.upper_leg_size[0] = wp.upper_leg_size.x;
+		h.upper_leg_size[1] = wp.upper_leg_size.y;
+		h.lower_leg_size[0] = wp.lower_leg_size.x;
+		h.lower_leg_size[1] = wp.lower_leg_size.y;
+		h.mass_density = wp.mass_density;
+		h.max_torque = wp.max_torque;
+	}
+	h.simulation = pack_simulation(config);
+
+	std::vector<uint8_t> out(sizeof(h));
+	BitWriter bits(out);
+	int64_t values[TRAJECTORY_CODEC_BLOCK];
+
+	for (size_t first = 0; first < n; first += TRAJECTORY_CODEC_BLOCK)
+	{
+		size_t count = std::min((size_t)TRAJECTORY_CODEC_BLOCK, n - first);
+		for (size_t f = 0; f < n_fields; f++)
+		{
+			const uint32_t* w = &words[f * n + first];
+
+			bool exact = steps[f] <= 0.0f;
+			for (size_t i = 0; i < count && !exact; i++)
+			{
+				float x;
+				memcpy(&x, &w[i], sizeof(x));
+				double d = (double)x / steps[f];
+				if (!(std::fabs(d) <= CODEC_QUANT_LIMIT))
+				{
+					exact = true;
+					break;
+				}
+				values[i] = std::llround(d);
+			}
+			if (exact)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					values[i] = (int32_t)w[i];
+				}
+			}
+
+			uint64_t widest = 0;
+			for (size_t i = 1; i < count; i++)
+			{
+				widest |= zigzag(values[i] - values[i - 1]);
+			}
+			int width = bit_width(widest);
+
+			out.push_back((exact ? CODEC_EXACT_FLAG : 0) | width);
+			put_varint(out, zigzag(values[0]));
+			for (size_t i = 1; i < count; i++)
+			{
+				bits.Put(zigzag(values[i] - values[i - 1]), width);
+			}
+			bits.Align();
+		}
+	}
+
+	h.payload_size = out.size() - sizeof(h);
+	memcpy(out.data(), &h, sizeof(h));
+	return out;
+}
+
+bool decode_trajectory(const uint8_t* data, size_t size,
+						std::vector<WalkerState>& states,
+						TrajectorySimulation* simulation)
+{
+	const size_t n_fields = CODEC_N_FIELDS;
+
+	TrajectoryCodecHeader h;
+	if (size < sizeof(h))
+	{
+		return false;
+	}
+	memcpy(&h, data, sizeof(h));
+	if (h.magic != TRAJECTORY_CODEC_MAGIC ||
+		h.version != TRAJECTORY_CODEC_VERSION ||
+		h.header_size != sizeof(h) || h.n_fields != n_fields ||
+		h.payload_size != size - sizeof(h))
+	{
+		return false;
+	}
+
+	// every field of every block takes at least 2 bytes (its mode and first
+	// value), so a count larger than that is corrupt (and would allocate too
+	// much)
+	size_t n = h.n_states;
+	uint64_t n_blocks = (h.n_states + TRAJECTORY_CODEC_BLOCK - 1)
+							/ TRAJECTORY_CODEC_BLOCK;
+	if (h.n_states / TRAJECTORY_CODEC_BLOCK > h.payload_size ||
+		n_blocks * 2 * n_fields > h.payload_size)
+	{
+		return false;
+	}
+
+	WalkerParameters wp;
+	wp.head_size.Set(h.head_size[0], h.head_size[1]);
+	wp.upper_leg_size.Set(h.upper_leg_size[0], h.upper_leg_size[1]);
+	wp.lower_leg_size.Set(h.lower_leg_size[0], h.lower_leg_size[1]);
+	wp.mass_density = h.mass_density;
+	wp.max_torque = h.max_torque;
+
+	std::vector<float> steps = field_steps(h.steps);
+	std::vector<uint32_t> words(n_fields * n);
+	BitReader bits(data + sizeof(h), h.payload_size);
+
+	for (size_t first = 0; first < n; first += TRAJECTORY_CODEC_BLOCK)
+	{
+		size_t count = std::min((size_t)TRAJECTORY_CODEC_BLOCK, n - first);
+		for (size_t f = 0; f < n_fields; f++)
+		{
+			uint32_t* w = &words[f * n + first];
+
+			uint8_t mode = bits.Byte();
+			bool exact = (mode & CODEC_EXACT_FLAG) || steps[f] <= 0.0f;
+			int width = mode & ~CODEC_EXACT_FLAG;
+			if (width > CODEC_MAX_WIDTH)
+			{
+				return false;
+			}
+
+			// wrapping arithmetic, so corrupt deltas can't overflow
+			uint64_t v = (uint64_t)unzigzag(bits.Varint());
+			bits.Align();
+			for (size_t i = 0; i < count; i++)
+			{
+				if (i > 0)
+				{
+					v += (uint64_t)unzigzag(bits.Get(width));
+				}
+				if (exact)
+				{
+					w[i] = (uint32_t)v;
+				}
+				else
+				{
+					float x = (float)((double)(int64_t)v * steps[f]);
+					memcpy(&w[i], &x, sizeof(x));
+				}
+			}
+			bits.Align();
+			if (bits.failed)
+			{
+				return false;
+			}
+		}
+	}
+
+	states.clear();
+	states.reserve(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t w[CODEC_N_FIELDS];
+		for (size_t f = 0; f < n_fields; f++)
+		{
+			w[f] = words[f * n + i];
+		}
+		TrajectoryRecord r;
+		memset(&r, 0, sizeof(r));
+		memcpy((char*)&r + CODEC_FIRST_WORD, w, sizeof(w));
+		states.push_back(unpack_state(r, wp));
+	}
+	if (simulation) *simulation = h.simulation;
+	return true;
+}
+
+bool write_compressed(const std::string& fname,
+						const std::vector<WalkerState>& states,
+						const TrajectoryQuantization& q)
+{
+	std::vector<uint8_t> data = encode_trajectory(states, q);
+	std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		std::cout << "[trajectory_codec.cpp] can't open " << fname
+					<< std::endl;
+		return false;
+	}
+	out.write((const char*)data.data(), data.size());
+	return (bool)out;
+}
+
+bool read_compressed(const std::string& fname,
+						std::vector<WalkerState>& states,
+						TrajectorySimulation* simulation)
+{
+	std::ifstream in(fname, std::ios::binary | std::ios::ate);
+	if (!in)
+	{
+		std::cout << "[trajectory_codec.cpp] can't open " << fname
+					<< std::endl;
+		return false;
+	}
+	std::vector<uint8_t> data((size_t)in.tellg());
+	in.seekg(0);
+	in.read((char*)data.data(), data.size());
+
+	if (!in || !decode_trajectory(data.data(), data.size(), states,
+									simulation))
+	{
+		std::cout << "[trajectory_codec.cpp] " << fname
+					<< " is not a valid compressed trajectory" << std::endl;
+		return false;
+	}
+	return true;
+}
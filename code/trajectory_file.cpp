@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "trajectory_file.h"
+#include "config.h"
+
+// records and the index are used in place, so they have to stay aligned
+static_assert(sizeof(TrajectoryHeader) % 8 == 0, "misaligned records");
+static_assert(sizeof(TrajectoryRecord) % 8 == 0, "misaligned index");
+
+static void pack_body(TrajectoryBody& out, const BodySnapshot& body)
+{
+	out.position[0] = body.position.x;
+	out.position[1] = body.position.y;
+	out.angle = body.angle;
+	out.linear_velocity[0] = body.linearVelocity.x;
+	out.linear_velocity[1] = body.linearVelocity.y;
+	out.angular_velocity = body.angularVelocity;
+}
+
+static void unpack_body(BodySnapshot& out, const TrajectoryBody& body)
+{
+	out.position.Set(body.position[0], body.position[1]);
+	out.angle = body.angle;
+	out.linearVelocity.Set(body.linear_velocity[0], body.linear_velocity[1]);
+	out.angularVelocity = body.angular_velocity;
+}
+
+TrajectoryRecord pack_state(const WalkerState& state)
+{
+	TrajectoryRecord r;
+	r.node = 0;
+	r.parent = 0;
+	r.state_index = state.state_index;
+	r.head_world_center[0] = state.headWorldCenter.x;
+	r.head_world_center[1] = state.headWorldCenter.y;
+	r.head_angle = state.headAngle;
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		r.legs_world_center[i][0] = state.legsWorldCenter[i].x;
+		r.legs_world_center[i][1] = state.legsWorldCenter[i].y;
+		r.legs_angle[i] = state.legsAngle[i];
+		r.mspeeds[i] = state.mspeeds[i];
+		r.jspeeds[i] = state.jspeeds[i];
+		r.jangles[i] = state.jangles[i];
+		pack_body(r.legs[i], state.snapshot.legs[i]);
+	}
+	pack_body(r.head, state.snapshot.head);
+	r.max_torque = state.snapshot.max_torque;
+	r.awake = state.snapshot.awake;
+	return r;
+}
+
+WalkerState unpack_state(const TrajectoryRecord& r, const WalkerParameters& wp)
+{
+	WalkerState state;
+	state.wp = wp;
+	state.state_index = r.state_index;
+	state.headWorldCenter.Set(r.head_world_center[0], r.head_world_center[1]);
+	state.headAngle = r.head_angle;
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		state.legsWorldCenter[i].Set(r.legs_world_center[i][0],
+										r.legs_world_center[i][1]);
+		state.legsAngle[i] = r.legs_angle[i];
+		state.mspeeds[i] = r.mspeeds[i];
+		state.jspeeds[i] = r.jspeeds[i];
+		state.jangles[i] = r.jangles[i];
+		unpack_body(state.snapshot.legs[i], r.legs[i]);
+		state.snapshot.mspeeds[i] = r.mspeeds[i];
+	}
+	unpack_body(state.snapshot.head, r.head);
+	state.snapshot.max_torque = r.max_torque;
+	state.snapshot.awake = r.awake != 0;
+	return state;
+}
+
+TrajectorySimulation pack_simulation(const Config& c)
+{
+	TrajectorySimulation s;
+	s.hertz = c.hertz;
+	s.velocity_iterations = c.velocity_iterations;
+	s.position_iterations = c.position_iterations;
+	s.iteration_time = c.iteration_time;
+	s.gravity = c.gravity;
+	s.friction = c.friction;
+	s.termination = c.termination;
+	s.backend = c.backend;
+	return s;
+}
+
+void unpack_simulation(const TrajectorySimulation& s, Config& c)
+{
+	c.hertz = s.hertz;
+	c.velocity_iterations = s.velocity_iterations;
+	c.position_iterations = s.position_iterations;
+	c.iteration_time = s.iteration_time;
+	c.gravity = s.gravity;
+	c.friction = s.friction;
+	c.termination = s.termination;
+	c.backend = (PhysicsBackend)s.backend;
+}
+
+bool TrajectoryWriter::Open(const std::string& fname,
+							const WalkerParameters& wp)
+{
+	out.open(fname, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		std::cout 	<< "[trajectory_file.cpp] could not open " << fname
+					<< std::endl;
+		return false;
+	}
+
+	TrajectoryHeader h;
+	h.magic = TRAJECTORY_MAGIC;
+	h.version = TRAJECTORY_VERSION;
+	h.header_size = sizeof(TrajectoryHeader);
+	h.record_size = sizeof(TrajectoryRecord);
+	h.head_size[0] = wp.head_size.x;
+	h.head_size[1] = wp.head_size.y;
+	h.upper_leg_size[0] = wp.upper_leg_size.x;
+	h.upper_leg_size[1] = wp.upper_leg_size.y;
+	h.lower_leg_size[0] = wp.lower_leg_size.x;
+	h.lower_leg_size[1] = wp.lower_leg_size.y;
+	h.mass_density = wp.mass_density;
+	h.max_torque = wp.max_torque;
+	h.simulation = pack_simulation(config);
+	out.write((const char*)&h, sizeof(h));
+
+	n_records = 0;
+	return true;
+}
+
+void TrajectoryWriter::Write(const WalkerState& state)
+{
+	TrajectoryRecord r = pack_state(state);
+	r.node = n_records + 1;
+	r.parent = n_records;
+	Write(r);
+}
+
+void TrajectoryWriter::Write(const TrajectoryRecord& record)
+{
+	out.write((const char*)&record, sizeof(record));
+	n_records++;
+}
+
+void TrajectoryWriter::Flush()
+{
+	out.flush();
+}
+
+bool TrajectoryWriter::Close()
+{
+	TrajectoryTrailer t;
+	t.index_offset = sizeof(TrajectoryHeader) +
+						n_records * sizeof(TrajectoryRecord);
+	t.n_records = n_records;
+	t.version = TRAJECTORY_VERSION;
+	t.magic = TRAJECTORY_END_MAGIC;
+
+	// the index is written a chunk at a time, so it never has to be in memory
+	uint64_t chunk[1024];
+	for (uint64_t i = 0; i < n_records; )
+	{
+		int n = 0;
+		for (; n < 1024 && i < n_records; n++, i++)
+		{
+			chunk[n] = sizeof(TrajectoryHeader) + i * sizeof(TrajectoryRecord);
+		}
+		out.write((const char*)chunk, n * sizeof(uint64_t));
+	}
+	out.write((const char*)&t, sizeof(t));
+	out.close();
+
+	bool ok = !out.fail();
+	if (!ok)
+	{
+		std::cout << "[trajectory_file.cpp] failed to write trajectory" << std::endl;
+	}
+	return ok;
+}
+
+TrajectoryFile::TrajectoryFile()
+{
+	map = nullptr;
+	map_size = 0;
+	header = nullptr;
+	index = nullptr;
+	n_records = 0;
+	wp = defaultParameters;
+	simulation = pack_simulation(Config());
+}
+
+TrajectoryFile::~TrajectoryFile()
+{
+	Close();
+}
+
+bool TrajectoryFile::Open(const std::string& fname)
+{
+	Close();
+
+	int fd = open(fname.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cout << "[trajectory_file.cpp] could not open " << fname << std::endl;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 ||
+		st.st_size < (off_t)sizeof(TrajectoryHeader))
+	{
+		std::cout << "[trajectory_file.cpp] " << fname << " is too short" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	map_size = st.st_size;
+	map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		std::cout << "[trajectory_file.cpp] could not map " << fname << std::endl;
+		map = nullptr;
+		return false;
+	}
+
+	const char* base = (const char*)map;
+	header = (const TrajectoryHeader*)base;
+
+	// a truncated file can end anywhere, so don't read the trailer in place
+	TrajectoryTrailer t;
+	std::memset(&t, 0, sizeof(t));
+	if (map_size >= sizeof(TrajectoryHeader) + sizeof(t))
+	{
+		std::memcpy(&t, base + map_size - sizeof(t), sizeof(t));
+	}
+	const TrajectoryTrailer* trailer = &t;
+
+	bool ok = 	header->magic == TRAJECTORY_MAGIC &&
+				header->version == TRAJECTORY_VERSION &&
+				header->header_size == sizeof(TrajectoryHeader) &&
+				header->record_size == sizeof(TrajectoryRecord);
+	if (!ok)
+	{
+		std::cout 	<< "[trajectory_file.cpp] " << fname << " is not a version "
+					<< TRAJECTORY_VERSION << " trajectory" << std::endl;
+		Close();
+		return false;
+	}
+
+	bool finished = trailer->magic == TRAJECTORY_END_MAGIC &&
+					trailer->index_offset + trailer->n_records * sizeof(uint64_t)
+						+ sizeof(TrajectoryTrailer) == map_size;
+	if (finished)
+	{
+		index = (const uint64_t*)(base + trailer->index_offset);
+		n_records = trailer->n_records;
+		for (uint64_t i = 0; i < n_records; i++)
+		{
+			if (index[i] < sizeof(TrajectoryHeader) ||
+				index[i] + sizeof(TrajectoryRecord) > trailer->index_offset)
+			{
+				std::cout 	<< "[trajectory_file.cpp] " << fname
+							<< " has a broken index" << std::endl;
+				Close();
+				return false;
+			}
+		}
+	}
+	else
+	{
+		// no index: the records are back to back after the header
+		n_records = (map_size - sizeof(TrajectoryHeader)) /
+					sizeof(TrajectoryRecord);
+		std::cout 	<< "[trajectory_file.cpp] " << fname << " was not finished;"
+					<< " recovered " << n_records << " records" << std::endl;
+	}
+
+	wp.head_size.Set(header->head_size[0], header->head_size[1]);
+	wp.upper_leg_size.Set(header->upper_leg_size[0], header->upper_leg_size[1]);
+	wp.lower_leg_size.Set(header->lower_leg_size[0], header->lower_leg_size[1]);
+	wp.mass_density = header->mass_density;
+	wp.max_torque = header->max_torque;
+	simulation = header->simulation;
+
+	return true;
+}
+
+void TrajectoryFile::Close()
+{
+	if (map)
+	{
+		munmap(map, map_size);
+	}
+	map = nullptr;
+	map_size = 0;
+	header = nullptr;
+	index = nullptr;
+	n_records = 0;
+}
+
+size_t TrajectoryFile::Size() const
+{
+	return n_records;
+}
+
+const TrajectoryRecord& TrajectoryFile::Record(size_t i) const
+{
+	uint64_t offset = index ? index[i] :
+						sizeof(TrajectoryHeader) + i * sizeof(TrajectoryRecord);
+	return *(const TrajectoryRecord*)((const char*)map + offset);
+}
+
+WalkerState TrajectoryFile::State(size_t i) const
+{
+	return unpack_state(Record(i), wp);
+}
+
+std::vector<WalkerState> TrajectoryFile::States() const
+{
+	std::vector<WalkerState> states;
+	states.reserve(n_records);
+	for (size_t i = 0; i < n_records; i++)
+	{
+		states.push_back(State(i));
+	}
+	return states;
+}
+
+std::vector<WalkerState> TrajectoryFile::Lineage(uint64_t node) const
+{
+	std::vector<WalkerState> lineage;
+	while (node > 0 && node <= n_records)
+	{
+		const TrajectoryRecord& r = Record(node - 1);
+		if (r.node != node || r.parent >= node)
+		{
+			std::cout 	<< "[trajectory_file.cpp] broken lineage at node "
+						<< node << std::endl;
+			break;
+		}
+		lineage.push_back(unpack_state(r, wp));
+		node = r.parent;
+	}
+	std::reverse(lineage.begin(), lineage.end());
+	return lineage;
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "trajectory_stream.h"
+#include "trace.h"
+
+TrajectoryStream::TrajectoryStream() : stalled(false), closing(false)
+{
+	next_id = 1;
+}
+
+TrajectoryStream::~TrajectoryStream()
+{
+	Close();
+}
+
+bool TrajectoryStream::Open(const std::string& fname,
+							const WalkerParameters& wp)
+{
+	this->fname = fname;
+	if (!writer.Open(fname, wp))
+	{
+		return false;
+	}
+
+	closing = false;
+	io = std::thread(&TrajectoryStream::Run, this);
+	return true;
+}
+
+// the I/O thread: write whatever is queued, flushing whenever the queue runs
+// dry so that a crash loses as little as possible
+void TrajectoryStream::Run()
+{
+	TrajectoryRecord record;
+	bool dirty = false;
+	while (true)
+	{
+		if (queue.TryPop(record))
+		{
+			writer.Write(record);
+			dirty = true;
+			continue;
+		}
+
+		// Close() may have queued its backlog after the pop above failed, but
+		// all of it is in the queue by the time `closing` is set, so drain the
+		// queue once more before stopping
+		bool last = closing;
+		while (last && queue.TryPop(record))
+		{
+			writer.Write(record);
+			dirty = true;
+		}
+
+		if (dirty)
+		{
+			TRACE_SCOPE("stream flush");
+			writer.Flush();
+			dirty = false;
+		}
+		if (last) break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// move as much of the backlog to the queue as fits
+void TrajectoryStream::Drain()
+{
+	while (!backlog.empty() && queue.TryPush(backlog.front()))
+	{
+		backlog.pop_front();
+	}
+}
+
+// records are queued in the order they were appended, so a parent is always
+// written before its children
+void TrajectoryStream::Push(const TrajectoryRecord& record)
+{
+	if (backlog.empty() && queue.TryPush(record)) return;
+
+	// the disk can't keep up: rather than growing the backlog without bounds,
+	// wait for the I/O thread to make room
+	if (backlog.size() >= TRAJECTORY_STREAM_BACKLOG)
+	{
+		TRACE_SCOPE("stream wait");
+		if (!stalled)
+		{
+			std::cout	<< "[trajectory_stream.cpp] " << fname << " can't be "
+						<< "written as fast as the run goes; waiting for it"
+						<< std::endl;
+			stalled = true;
+		}
+		Drain();
+		while (backlog.size() >= TRAJECTORY_STREAM_BACKLOG)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			Drain();
+		}
+	}
+	backlog.push_back(record);
+}
+
+uint64_t TrajectoryStream::Append(const WalkerLineage& lineage)
+{
+	// retry what didn't fit last time first
+	Drain();
+
+	// the states that haven't been streamed are the most recent ones
+	std::vector<const LineageNode*> fresh;
+	const LineageNode* node = lineage.Tip();
+	while (node && node->id == 0)
+	{
+		fresh.push_back(node);
+		node = node->parent.get();
+	}
+
+	for (int i = (int)fresh.size() - 1; i >= 0; i--)
+	{
+		const LineageNode* n = fresh[i];
+		TrajectoryRecord record = pack_state(n->state);
+		n->id = next_id++;
+		record.node = n->id;
+		record.parent = n->parent ? n->parent->id : 0;
+		Push(record);
+	}
+
+	return lineage.Tip() ? lineage.Tip()->id : 0;
+}
+
+bool TrajectoryStream::Close()
+{
+	if (!io.joinable()) return true;
+
+	// the backlog belongs to this thread, so hand it over before stopping
+	Drain();
+	while (!backlog.empty())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		Drain();
+	}
+
+	closing = true;
+	io.join();
+	return writer.Close();
+}
+
+uint64_t TrajectoryStream::Records()
+{
+	return next_id - 1;
+}
@@ -0,0 +1,544 @@
+// automated checks that walkers are simulated reproducibly, the guard to run
+// before trusting anything that caches, restores or recycles walkers instead
+// of simulating them afresh:
+//
+//   restore   a walker rebuilt from a WalkerState image (Walker(std::vector<
+//             WalkerState>)) is exactly in the image's state, and a recycled
+//             one (Walker::Reset()) goes on to simulate exactly like it
+//   replay    replaying a lineage's motor speeds from its first state, the way
+//             the testbed does (tests/trajectory.cpp), stays close to the
+//             recorded states; only reported, since replays aren't restored
+//             from snapshots
+//   backend   every iteration of those lineages simulated again from the
+//             same state with the batch backend (see batch_world.h) stays
+//             close to Box2D's; only reported, since the batch backend
+//             solves contacts differently and leaves out a walker's contacts
+//             with itself
+//   threads   whole runs give bitwise identical survivors no matter the
+//             number of threads
+//   contact   a walker's head touching one of its own legs doesn't count as
+//             touching the ground (TERMINATE_CONTACT)
+//   selection stochastic universal sampling never picks a walker that blew up
+//             (a non-finite fitness), and still picks the others
+//   remote    a run of ./main with --spawn-workers writes the same trajectory
+//             as a local one with worlds of their own (shard size 0); runs
+//             the ./main next to ./verify, each in a directory of its own
+//
+// lineages are --walkers random walkers --intervals iterations long, each
+// iteration simulated by a child built from its parent's image as the GA does
+// with worlds of their own, and never terminated early, since the testbed
+// doesn't terminate the replays they're compared to; divergences are
+// WalkerState::Diff()s, reported as each field's max and mean; exits with 1 if
+// a check that has to be exact isn't
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "walker.h"
+#include "walker_pool.h"
+#include "arena.h"
+#include "rng.h"
+#include "scheduler.h"
+#include "eval_cache.h"
+#include "batch_world.h"
+#include "termination.h"
+#include "config.h"
+#include "ga.h"
+#include "selection.h"
+
+struct VerifyOptions {
+    int walkers = 64;
+    int intervals = 20;
+    int population = 200;
+    int generations = 20;
+    int workers = 2;
+    std::vector<int> threads;
+    std::string config;
+};
+
+static VerifyOptions options;
+
+// the fields of a WalkerState::Diff(), the largest component of each
+enum DiffField {
+    FIELD_HEAD_POSITION,
+    FIELD_HEAD_ANGLE,
+    FIELD_LEG_POSITIONS,
+    FIELD_LEG_ANGLES,
+    FIELD_MOTOR_SPEEDS,
+    FIELD_JOINT_SPEEDS,
+    FIELD_JOINT_ANGLES,
+    N_DIFF_FIELDS
+};
+
+static const char* field_names[N_DIFF_FIELDS] = {
+    "head position [m]", "head angle [rad]", "leg positions [m]",
+    "leg angles [rad]", "motor speeds [rad/s]", "joint speeds [rad/s]",
+    "joint angles [rad]"
+};
+
+// a component of a Diff(); a NaN counts as the largest divergence there is
+// (std::max() would drop it)
+static float component(float d)
+{
+    return (d == d) ? d : INFINITY;
+}
+
+// max and mean of every field over a number of Diff()s
+struct Divergence {
+    double max[N_DIFF_FIELDS] = {};
+    double sum[N_DIFF_FIELDS] = {};
+    long count = 0;
+
+    void Add(const WalkerState& diff)
+    {
+        float v[N_DIFF_FIELDS];
+        v[FIELD_HEAD_POSITION] = std::max(component(diff.headWorldCenter.x),
+                                          component(diff.headWorldCenter.y));
+        v[FIELD_HEAD_ANGLE] = component(diff.headAngle);
+        v[FIELD_LEG_POSITIONS] = v[FIELD_LEG_ANGLES] = 0.0f;
+        v[FIELD_MOTOR_SPEEDS] = v[FIELD_JOINT_SPEEDS] = 0.0f;
+        v[FIELD_JOINT_ANGLES] = 0.0f;
+        for (int i = 0; i < N_LEG_PARAMS; i++) {
+            v[FIELD_LEG_POSITIONS] = std::max({ v[FIELD_LEG_POSITIONS],
+                                        component(diff.legsWorldCenter[i].x),
+                                        component(diff.legsWorldCenter[i].y) });
+            v[FIELD_LEG_ANGLES] = std::max(v[FIELD_LEG_ANGLES],
+                                           component(diff.legsAngle[i]));
+            v[FIELD_MOTOR_SPEEDS] = std::max(v[FIELD_MOTOR_SPEEDS],
+                                             component(diff.mspeeds[i]));
+            v[FIELD_JOINT_SPEEDS] = std::max(v[FIELD_JOINT_SPEEDS],
+                                             component(diff.jspeeds[i]));
+            v[FIELD_JOINT_ANGLES] = std::max(v[FIELD_JOINT_ANGLES],
+                                             component(diff.jangles[i]));
+        }
+
+        for (int f = 0; f < N_DIFF_FIELDS; f++) {
+            max[f] = std::max(max[f], (double)v[f]);
+            sum[f] += v[f];
+        }
+        count++;
+    }
+
+    void Merge(const Divergence& other)
+    {
+        for (int f = 0; f < N_DIFF_FIELDS; f++) {
+            max[f] = std::max(max[f], other.max[f]);
+            sum[f] += other.sum[f];
+        }
+        count += other.count;
+    }
+
+    bool Zero() const
+    {
+        for (int f = 0; f < N_DIFF_FIELDS; f++) {
+            if (max[f] != 0.0) return false;
+        }
+        return true;
+    }
+
+    void Print() const
+    {
+        for (int f = 0; f < N_DIFF_FIELDS; f++) {
+            std::cout   << "    " << field_names[f] << ": max " << max[f]
+                        << ", mean " << (count ? sum[f] / count : 0.0)
+                        << std::endl;
+        }
+    }
+};
+
+// whether two states are the same bit for bit (as far as simulating on from
+// them and everything recorded about them goes)
+static bool identical(const WalkerState& a, const WalkerState& b)
+{
+    const WalkerSnapshot& x = a.snapshot;
+    const WalkerSnapshot& y = b.snapshot;
+    return memcmp(&x.head, &y.head, sizeof(x.head)) == 0 &&
+           memcmp(x.legs, y.legs, sizeof(x.legs)) == 0 &&
+           memcmp(x.mspeeds, y.mspeeds, sizeof(x.mspeeds)) == 0 &&
+           memcmp(&x.max_torque, &y.max_torque, sizeof(x.max_torque)) == 0 &&
+           x.awake == y.awake &&
+           memcmp(&a.headWorldCenter, &b.headWorldCenter,
+                  sizeof(a.headWorldCenter)) == 0 &&
+           memcmp(&a.headAngle, &b.headAngle, sizeof(a.headAngle)) == 0 &&
+           memcmp(a.legsWorldCenter, b.legsWorldCenter,
+                  sizeof(a.legsWorldCenter)) == 0 &&
+           memcmp(a.legsAngle, b.legsAngle, sizeof(a.legsAngle)) == 0 &&
+           memcmp(a.jspeeds, b.jspeeds, sizeof(a.jspeeds)) == 0 &&
+           memcmp(a.jangles, b.jangles, sizeof(a.jangles)) == 0;
+}
+
+static void set_speeds(Walker* w, const float speeds[N_LEG_PARAMS])
+{
+    w->SetMotorSpeeds(speeds[UPPER_LEFT], speeds[UPPER_RIGHT],
+                      speeds[LOWER_LEFT], speeds[LOWER_RIGHT]);
+}
+
+// the lineage of random walker `index`, checking every rebuild along the way:
+// each iteration's child is built from its parent's image, which it has to
+// match exactly (`restored`), and a recycled walker Reset() to the same image
+// has to simulate the iteration exactly like it (`recycled` counts those that
+// don't)
+static WalkerLineage random_lineage(int index, Divergence& restored,
+                                    int& recycled)
+{
+    Walker* child = new Walker();
+    Walker* twin = new Walker();
+    WalkerLineage lineage;
+
+    for (int i = 0; i < options.intervals; i++) {
+        if (i > 0) {
+            std::vector<WalkerState> image = lineage.Unroll();
+            child = new Walker(image);
+            restored.Add(WalkerState(child).Diff(image.back()));
+            twin->Reset(lineage);
+        }
+
+        Rng rng(config.seed, i, index);
+        float speeds[N_LEG_PARAMS];
+        for (int j = 0; j < N_LEG_PARAMS; j++) {
+            speeds[j] = config.min_motor_speed + rng.Uniform() *
+                        (config.max_motor_speed - config.min_motor_speed);
+        }
+        set_speeds(child, speeds);
+        child->Simulate();
+
+        if (i > 0) {
+            set_speeds(twin, speeds);
+            twin->Simulate();
+            if (!identical(twin->states.back(), child->states.back())) {
+                recycled++;
+            }
+        }
+
+        lineage = child->states;
+        delete child;
+    }
+
+    delete twin;
+    return lineage;
+}
+
+// replay a lineage the way tests/trajectory.cpp does: a walker built from its
+// first state only, driven by each later state's motor speeds in turn (a state
+// holds those of the iteration leading up to it)
+static void replay(const WalkerLineage& lineage, Divergence& divergence)
+{
+    std::vector<WalkerState> states = lineage.Unroll();
+    Walker* w = new Walker(std::vector<WalkerState>{ states[0] });
+    for (int i = 0; i + 1 < (int)states.size(); i++) {
+        set_speeds(w, states[i + 1].mspeeds);
+        w->Simulate();
+        divergence.Add(w->states.back().Diff(states[i + 1]));
+    }
+    delete w;
+}
+
+// simulate every iteration of a (Box2D) lineage again with the batch backend,
+// from the same state and with the same motor speeds
+static void batch_iterations(const WalkerLineage& lineage,
+                             Divergence& divergence)
+{
+    std::vector<WalkerState> states = lineage.Unroll();
+    for (int i = 0; i + 1 < (int)states.size(); i++) {
+        std::vector<WalkerState> image(states.begin(), states.begin() + i + 1);
+        Walker* w = new Walker(image);
+        set_speeds(w, states[i + 1].mspeeds);
+        BatchWorld batch(&w, 1);
+        batch.Simulate();
+        divergence.Add(w->states.back().Diff(states[i + 1]));
+        delete w;
+    }
+}
+
+// a whole run on `threads` threads, set up the way main.cpp does; its own
+// output is dropped, and its survivors' lineages are returned fittest first
+static std::vector<std::vector<WalkerState>> run(int threads)
+{
+    scheduler_init(threads, config.pin);
+    Arena::enabled = true;
+    pool = new WalkerPool(options.population, config.shard_size);
+    cache = config.Caching() ? new EvalCache() : nullptr;
+
+    std::ostringstream dropped;
+    std::streambuf* out = std::cout.rdbuf(dropped.rdbuf());
+    std::vector<Walker*> survivors = run_genetic_algorithm(
+        options.population, options.generations, config.fit_ratio);
+    std::cout.rdbuf(out);
+
+    std::vector<std::vector<WalkerState>> lineages;
+    for (Walker* w : survivors) {
+        lineages.push_back(w->states.Unroll());
+    }
+
+    delete cache;
+    cache = nullptr;
+    delete pool;
+    pool = nullptr;
+    Arena::ResetAll();
+    Arena::enabled = false;
+    return lineages;
+}
+
+static bool same_runs(const std::vector<std::vector<WalkerState>>& a,
+                      const std::vector<std::vector<WalkerState>>& b)
+{
+    if (a.size() != b.size()) return false;
+    for (int i = 0; i < (int)a.size(); i++) {
+        if (a[i].size() != b[i].size()) return false;
+        for (int s = 0; s < (int)a[i].size(); s++) {
+            if (!identical(a[i][s], b[i][s])) return false;
+        }
+    }
+    return true;
+}
+
+// lay a walker's lower leg across its head and step: the head touches its own
+// leg, which mustn't flag it; the listener has to tell that leg from the ground
+static bool self_contact()
+{
+    b2World world(b2Vec2(0.0f, config.gravity));
+    world.SetContactListener(&head_contact_listener);
+    Walker* w = new Walker(defaultParameters, &world);
+    b2Body* leg = w->legs[LOWER_LEFT];
+    leg->SetTransform(w->head->GetPosition(), 0.5f * b2_pi);
+    for (int i = 0; i < 2; i++) {
+        world.Step(config.TimeStep(), config.velocity_iterations,
+                   config.position_iterations);
+    }
+
+    bool ok = !w->head_contact &&
+              !HeadContactListener::Ground(leg->GetFixtureList());
+    for (b2Body* b = world.GetBodyList(); b; b = b->GetNext()) {
+        if (b->GetType() == b2_staticBody) {
+            ok = ok && HeadContactListener::Ground(b->GetFixtureList());
+        }
+    }
+    delete w;
+    return ok;
+}
+
+// walkers that blew up next to ones that walked, some of them the same
+// distance: sus must pick among the finite ones only, however the pointers fall
+static bool sus_finite()
+{
+    std::vector<float> fitness = {1.0f, -INFINITY, 3.0f, NAN, 1.0f, INFINITY,
+                                  2.0f, -INFINITY};
+    std::vector<float> flat = {2.0f, -INFINITY, 2.0f, NAN};
+    for (int generation = 0; generation < 100; generation++) {
+        for (const std::vector<float>* f : {&fitness, &flat}) {
+            std::vector<int> picks = select_sus(*f, 3, config.seed,
+                                                generation);
+            for (int i : picks) {
+                if (!std::isfinite((*f)[i])) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// run main in a directory of its own and read back its trajectory.traj
+// (empty if it failed)
+static std::string run_main(const std::string& main, const std::string& args)
+{
+    char dir[] = "/tmp/verify-XXXXXX";
+    if (!mkdtemp(dir)) return "";
+
+    std::string command = "cd " + std::string(dir) + " && " + main + " " +
+                          args + " > /dev/null 2>&1";
+    std::string traj;
+    if (system(command.c_str()) == 0) {
+        std::ifstream in(std::string(dir) + "/" + DEFAULT_DUMP_FNAME,
+                         std::ios::binary);
+        traj.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+    }
+
+    system(("rm -rf " + std::string(dir)).c_str());
+    return traj;
+}
+
+// the same seeded run with --spawn-workers (and the default shard size, which
+// the coordinator has to ignore) and locally with worlds of their own
+static bool distributed(const std::string& main)
+{
+    std::ostringstream args;
+    args    << options.population << " " << options.generations << " "
+            << config.fit_ratio;
+    std::ostringstream flags;
+    flags   << " --seed " << config.seed << " --threads "
+            << std::max(2, scheduler_threads());
+    if (!options.config.empty()) flags << " --config " << options.config;
+
+    std::string remote = run_main(main, args.str() + flags.str() +
+                                  " --spawn-workers " +
+                                  std::to_string(options.workers));
+    std::string local = run_main(main, args.str() + " 0" + flags.str());
+    return !remote.empty() && remote == local;
+}
+
+static bool parse_list(const char* arg, std::vector<int>& list)
+{
+    list.clear();
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int v = atoi(item.c_str());
+        if (v < 1) return false;
+        list.push_back(v);
+    }
+    return !list.empty();
+}
+
+// [USAGE] ./verify [--walkers N] [--intervals N] [--population N]
+//                  [--generations N] [--threads N,N,...] [--workers N]
+//                  [--config FILE]
+int main(int argc, char *argv[])
+{
+    config.seed = 1;
+    config.seeded = true;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        bool ok = true;
+
+        if (arg == "--walkers" && has_value) {
+            options.walkers = atoi(argv[++a]);
+            ok = options.walkers > 0;
+        } else if (arg == "--intervals" && has_value) {
+            options.intervals = atoi(argv[++a]);
+            ok = options.intervals > 1;
+        } else if (arg == "--population" && has_value) {
+            options.population = atoi(argv[++a]);
+            ok = options.population > 0;
+        } else if (arg == "--generations" && has_value) {
+            options.generations = atoi(argv[++a]);
+            ok = options.generations > 0;
+        } else if (arg == "--threads" && has_value) {
+            ok = parse_list(argv[++a], options.threads);
+        } else if (arg == "--workers" && has_value) {
+            options.workers = atoi(argv[++a]);
+            ok = options.workers > 0;
+        } else if (arg == "--config" && has_value) {
+            options.config = argv[++a];
+            ok = config.Load(options.config) && config.Valid();
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cout << "[verify.cpp] invalid argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // by default, one thread against all cores
+    scheduler_init(0, false);
+    if (options.threads.empty()) {
+        options.threads = { 1, std::max(2, scheduler_threads()) };
+    }
+    int n_threads = scheduler_threads();
+    int failures = 0;
+
+    // restore: walkers are independent, so threads take one at a time and
+    // their results are merged in order; the testbed never terminates
+    // walkers, so neither do the lineages its replays are compared to
+    int termination = config.termination;
+    config.termination = 0;
+    std::vector<WalkerLineage> lineages(options.walkers);
+    std::vector<Divergence> restored(options.walkers);
+    int recycled = 0;
+#pragma omp parallel for num_threads(n_threads) schedule(dynamic, 1) \
+                         reduction(+:recycled)
+    for (int i = 0; i < options.walkers; i++) {
+        lineages[i] = random_lineage(i, restored[i], recycled);
+    }
+    for (int i = 1; i < options.walkers; i++) {
+        restored[0].Merge(restored[i]);
+    }
+
+    int rebuilds = options.walkers * (options.intervals - 1);
+    bool restore_ok = restored[0].Zero() && recycled == 0;
+    std::cout   << "restore: " << options.walkers << " walkers x "
+                << options.intervals << " iterations; " << rebuilds
+                << " rebuilds from images, "
+                << recycled << " recycled walker(s) diverged: "
+                << (restore_ok ? "OK" : "FAILED") << std::endl;
+    restored[0].Print();
+    if (!restore_ok) failures++;
+
+    // replay
+    std::vector<Divergence> replayed(options.walkers);
+#pragma omp parallel for num_threads(n_threads) schedule(dynamic, 1)
+    for (int i = 0; i < options.walkers; i++) {
+        replay(lineages[i], replayed[i]);
+    }
+    for (int i = 1; i < options.walkers; i++) {
+        replayed[0].Merge(replayed[i]);
+    }
+
+    std::cout   << "replay: " << replayed[0].count << " iterations replayed "
+                << "from the first state" << std::endl;
+    replayed[0].Print();
+
+    // backend
+    std::vector<Divergence> batched(options.walkers);
+#pragma omp parallel for num_threads(n_threads) schedule(dynamic, 1)
+    for (int i = 0; i < options.walkers; i++) {
+        batch_iterations(lineages[i], batched[i]);
+    }
+    config.termination = termination;
+    for (int i = 1; i < options.walkers; i++) {
+        batched[0].Merge(batched[i]);
+    }
+
+    std::cout   << "backend: " << batched[0].count << " iterations simulated "
+                << "with the batch backend from Box2D's states" << std::endl;
+    batched[0].Print();
+
+    // threads: every run against the first
+    std::vector<std::vector<WalkerState>> first = run(options.threads[0]);
+    for (int i = 1; i < (int)options.threads.size(); i++) {
+        bool same = same_runs(first, run(options.threads[i]));
+        std::cout   << "threads: " << options.population << " walkers x "
+                    << options.generations << " generations on "
+                    << options.threads[0] << " vs " << options.threads[i]
+                    << " thread(s): " << (same ? "OK" : "FAILED")
+                    << std::endl;
+        if (!same) failures++;
+    }
+
+    bool contact_ok = self_contact();
+    std::cout   << "contact: head against its own lower leg: "
+                << (contact_ok ? "OK" : "FAILED") << std::endl;
+    if (!contact_ok) failures++;
+
+    bool selection_ok = sus_finite();
+    std::cout   << "selection: sus with non-finite fitness: "
+                << (selection_ok ? "OK" : "FAILED") << std::endl;
+    if (!selection_ok) failures++;
+
+    // remote: ./main sits next to ./verify (by absolute path, since the runs
+    // happen in directories of their own)
+    char* self = realpath(argv[0], nullptr);
+    std::string main_path = self ? self : argv[0];
+    free(self);
+    main_path = main_path.substr(0, main_path.rfind('/') + 1) + "main";
+    bool remote_ok = distributed(main_path);
+    std::cout   << "remote: " << options.population << " walkers x "
+                << options.generations << " generations on "
+                << options.workers << " spawned worker(s) vs locally: "
+                << (remote_ok ? "OK" : "FAILED") << std::endl;
+    if (!remote_ok) failures++;
+
+    std::cout   << (failures ? "FAILED" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -5,20 +5,31 @@
 #include "box2d/box2d.h"
 #include "nlohmann/json.hpp"
 #include "walker.h"
+#include "walker_world.h"
+#include "arena.h"
+#include "termination.h"
+#include "config.h"
+#include "trajectory_file.h"
 
 using json = nlohmann::json;
 
 // initialize/set the Box2D world and add the ground
 void Walker::Exist(b2World *w)
 {
+	shard = nullptr;
+	owns_world = !w;
+	lane = 0;
+	origin = b2Vec2(0.0f, 0.0f);
+
 	if (!w)
 	{
-		world = new b2World(b2Vec2(0.0f, GRAVITY_Y));
+		world = arena_new<b2World>(b2Vec2(0.0f, config.gravity));
+		world->SetContactListener(&head_contact_listener);
 	}
 	else
 	{
 		world = w;
-		world->SetGravity(b2Vec2(0.0f, GRAVITY_Y));
+		world->SetGravity(b2Vec2(0.0f, config.gravity));
 	}
 
 	// define the ground as a static body
@@ -30,6 +41,31 @@ void Walker::Exist(b2World *w)
 	groundBody->CreateFixture(&groundShape, 0.0f);
 }
 
+// join a shared world; the shard owns the b2World and the ground, and this
+// Walker is placed in its own lane
+void Walker::Exist(WalkerWorld *s)
+{
+	shard = s;
+	owns_world = false;
+	world = s->world;
+	groundBody = s->groundBody;
+	lane = s->Claim(this);
+	origin = s->LaneOrigin(lane);
+}
+
+// Walkers only collide with the ground; the positive group index shared by all
+// of a Walker's fixtures keeps its own parts colliding with each other as they
+// would in a world of their own (which ground is its lane's is up to
+// LaneContactFilter, by the lane + 1 every fixture carries as user data)
+b2Filter Walker::Filter()
+{
+	b2Filter filter;
+	filter.categoryBits = WALKER_CATEGORY;
+	filter.maskBits = GROUND_CATEGORY;
+	filter.groupIndex = lane + 1;
+	return filter;
+}
+
 void Walker::Build_Head(WalkerParameters wp)
 {
 	// [ASSUME] both legs are the same lengths
@@ -38,12 +74,15 @@ void Walker::Build_Head(WalkerParameters wp)
 					+ wp.lower_leg_size.y;
 
 	headDef.type = b2_dynamicBody;
-	headDef.position.Set(0.0f, GROUND_Y + height);
+	headDef.position.Set(origin.x, origin.y + GROUND_Y + height);
+	headDef.userData.pointer = (uintptr_t)this;
 	head = world->CreateBody(&headDef);
 	headShape.SetAsBox(wp.head_size.x / 2, wp.head_size.y / 2);
 	headFixDef.shape = &headShape;
 	headFixDef.density = wp.mass_density;
-	headFixDef.friction = FRICTION_COEFF;
+	headFixDef.friction = config.friction;
+	headFixDef.filter = Filter();
+	headFixDef.userData.pointer = lane + 1;
 	head->CreateFixture(&headFixDef);
 
 	// [TODO] redundant? if any of the Build() functions are called separately,
@@ -89,7 +128,9 @@ void Walker::Build_Legs(WalkerParameters wp)
 
 		legsFixDef[i].shape = &legsShape[i];
 		legsFixDef[i].density = wp.mass_density;
-		legsFixDef[i].friction = FRICTION_COEFF;
+		legsFixDef[i].friction = config.friction;
+		legsFixDef[i].filter = Filter();
+		legsFixDef[i].userData.pointer = lane + 1;
 		legs[i]->CreateFixture(&legsFixDef[i]);
 	}
 
@@ -166,6 +207,8 @@ void Walker::Build(WalkerParameters wp)
 
 	// set the 0th WalkerState
 	states.push_back(WalkerState(this));
+
+	ClearTermination();
 }
 
 Walker::Walker(WalkerParameters wp, b2World *w0)
@@ -174,11 +217,34 @@ Walker::Walker(WalkerParameters wp, b2World *w0)
 	Build(wp);
 }
 
+Walker::Walker(WalkerWorld* s, WalkerParameters wp)
+{
+	Exist(s);
+	Build(wp);
+}
+
 Walker::Walker(std::vector<WalkerState> image, b2World* w0)
 {
 	Exist(w0);
+	Build(WalkerLineage(image));
+}
+
+Walker::Walker(WalkerLineage image, b2World* w0)
+{
+	Exist(w0);
+	Build(image);
+}
+
+Walker::Walker(WalkerLineage image, WalkerWorld* s)
+{
+	Exist(s);
+	Build(image);
+}
 
-	if (image.size() > 0)
+// build this Walker in the image of the most recent state of another
+void Walker::Build(WalkerLineage image)
+{
+	if (!image.empty())
 	{
 		WalkerState current = image.back();
 
@@ -187,48 +253,23 @@ Walker::Walker(std::vector<WalkerState> image, b2World* w0)
 		params = current.wp;
 		Build_Head(params);
 		Build_Legs(params);
-
-		// apply transforms to put this new Walker in the same orientation as the
-		// most recent image state
-		head->SetTransform(current.headWorldCenter, current.headAngle);
-
-		// note that joint speeds are measured (bodyB ang. vel.) - (bodyA ang. vel.)
-		// [ASSUME] the ang. vel. of the head is 0
-		float angVelocities[N_LEG_PARAMS];
-		angVelocities[0] = current.jspeeds[0];
-		angVelocities[1] = current.jspeeds[1];
-		angVelocities[2] = angVelocities[0] + current.jspeeds[2];
-		angVelocities[3] = angVelocities[1] + current.jspeeds[3];
-
-		// destroy the built legs and reconstruct them with the above angular 
-		// velocities; the previous Walker::Build_Legs() call defines most of 
-		// the legsDef member, so only angular velocities needs to be specified
-		for (int i = 0; i < N_LEG_PARAMS; i++) 
-		{
-			world->DestroyBody(legs[i]);
-
-			legsDef[i].angularVelocity = angVelocities[i];
-			legs[i] = world->CreateBody(&legsDef[i]);
-			legs[i]->CreateFixture(&legsFixDef[i]);
-
-			// orient legs to match the most recent image state
-			legs[i]->SetTransform(current.legsWorldCenter[i], current.legsAngle[i]);
-		}
-
-		// note that all the legs must be reconstructed in order to reconstruct
-		// their joints, so this part is separate from the above
 		Build_Joints(params);
-		SetMotorSpeeds(	current.mspeeds[0], current.mspeeds[1], 
-						current.mspeeds[2], current.mspeeds[3]);
+
+		// put the new Walker in the exact pose, velocities and motor speeds of
+		// the most recent image state in one pass
+		current.snapshot.Restore(this);
 
 		// [DEBUG]
 		// current.Diff(WalkerState(this)).Print();
 
 		// inherit the previous states of the parent but replace the most recent
-		// with the new Walker's current state
+		// with the new Walker's current state; the parent's history is shared,
+		// not copied
 		states = image;
 		states.pop_back();
 		states.push_back(WalkerState(this));
+
+		ClearTermination();
 	}
 	else
 	{
@@ -237,11 +278,77 @@ Walker::Walker(std::vector<WalkerState> image, b2World* w0)
 	}
 }
 
+// recycle this Walker by putting its existing bodies in the image of the most
+// recent state of another, as if it had just been built from it; unlike
+// Walker::Build() nothing is destroyed and recreated besides the joints
+void Walker::Reset(WalkerLineage image)
+{
+	if (!image.empty())
+	{
+		WalkerState current = image.back();
+
+		// [ASSUME] WalkerParameters are the same for every Walker in a pool, so
+		// the existing fixtures already have the right shapes
+		params = current.wp;
+
+		// disabling a body drops its contacts, so the recycled Walker doesn't
+		// warm start from contacts of its previous life
+		head->SetEnabled(false);
+		for (int i = 0; i < N_LEG_PARAMS; i++)
+		{
+			legs[i]->SetEnabled(false);
+		}
+
+		// joints keep their accumulated impulses for warm starting and Box2D
+		// has no way to clear them; joints are cheap to rebuild (no fixtures, no
+		// broadphase proxies), so do that rather than let them carry over
+		for (int i = 0; i < N_LEG_PARAMS; i++)
+		{
+			world->DestroyJoint(joints[i]);
+		}
+		Build_Joints(params);
+
+		current.snapshot.Restore(this);
+
+		head->SetEnabled(true);
+		for (int i = 0; i < N_LEG_PARAMS; i++)
+		{
+			legs[i]->SetEnabled(true);
+		}
+
+		states = image;
+		states.pop_back();
+		states.push_back(WalkerState(this));
+
+		ClearTermination();
+	}
+	else
+	{
+		std::cout 	<< "[walker.cpp] image w/o any states was passed to "
+					<< "Walker::Reset()" << std::endl;
+	}
+}
+
 Walker::~Walker()
 {
-	if (world)
+	if (shard)
+	{
+		// the shard owns the world, so only give back this Walker's lane
+		shard->Release(this);
+	}
+	else if (owns_world)
 	{
-		delete world;
+		arena_delete(world);
+	}
+	else if (world)
+	{
+		// someone else's world (e.g. the testbed's); clean up after ourselves
+		world->DestroyBody(head);
+		for (int i = 0; i < N_LEG_PARAMS; i++)
+		{
+			world->DestroyBody(legs[i]);
+		}
+		world->DestroyBody(groundBody);
 	}
 }
 
@@ -265,28 +372,93 @@ void Walker::SetMotorSpeeds(float mUpperLeft, float mUpperRight, float mLowerLef
 	}
 }
 
+// step until the iteration is over or a predicate in Mask fires
+template <int Mask>
+void Walker::SimulateSteps()
+{
+	int steps = config.TimeSteps();
+	float dt = config.TimeStep();
+	ArenaBypass step_allocations;
+	for (int i = 0; i < steps && !terminated; i++)
+	{
+		world->Step(dt, config.velocity_iterations, config.position_iterations);
+
+		if (Mask && CheckTermination<Mask>())
+		{
+			Terminate();
+		}
+	}
+}
+
 void Walker::Simulate()
 {
-	// run simulation
-	for (int i = 0; i < N_ITER_TIMESTEPS; i++)
+	// nothing to do for a Walker that takes its state from elsewhere
+	if (adopted) return;
+
+	// run simulation, until a termination predicate fires
+	typedef void (Walker::*Steps)();
+	static const Steps steps[] = TERMINATION_TABLE(Walker::SimulateSteps);
+	(this->*steps[config.termination & TERMINATE_ALL])();
+
+	Record();
+}
+
+void Walker::ClearTermination()
+{
+	terminated = false;
+	adopted = false;
+	head_contact = false;
+	stall_x = head->GetPosition().x;
+	stall_steps = 0;
+}
+
+// stop simulating this Walker for the rest of the iteration; disabled bodies
+// keep their transforms and velocities but are left out of every step, so the
+// state recorded at the end of the iteration is the one it had now
+void Walker::Terminate()
+{
+	terminated = true;
+
+	head->SetEnabled(false);
+	for (int i = 0; i < N_LEG_PARAMS; i++)
 	{
-		world->Step(SIM_TIMESTEP, SIM_VEL_ITER, SIM_POS_ITER);
+		legs[i]->SetEnabled(false);
 	}
+}
 
-	// record state
+// take this iteration's outcome from an identical simulation (see
+// eval_cache.h) instead of simulating: Park() the Walker until the result is
+// known, then Adopt() it, which puts the bodies in the resulting state and
+// records it as if this Walker had been simulated
+void Walker::Park()
+{
+	Terminate();
+	adopted = true;
+}
+
+void Walker::Adopt(const WalkerState& result)
+{
+	Park();
+	result.snapshot.Restore(this);
+	states.push_back(result);
+}
+
+// record the current state
+void Walker::Record()
+{
 	states.push_back(WalkerState(this));
 }
 
 float Walker::GetPositionX()
 {
 	b2Vec2 headWorldCenter = head->GetWorldCenter();
-	return headWorldCenter.x;
+	return headWorldCenter.x - origin.x;
 }
 
 float Walker::GetPositionY()
 {
 	b2Vec2 headWorldCenter = head->GetWorldCenter();
-	return headWorldCenter.y;
+	return headWorldCenter.y - origin.y;
 }
 
 float Walker::GetVelocityX()
@@ -316,17 +488,46 @@ void Walker::Dump(bool use_default_fname)
 		std::mt19937 gen(rd());
 		fname.append("trajectory-");
 		fname.append(std::to_string(gen()));
-		fname.append(".json");
+		fname.append(TRAJECTORY_EXTENSION);
 	}
 
+	Dump(fname);
+}
+
+void Walker::Dump(const std::string& fname)
+{
+	std::string json_ext = ".json";
+	if (fname.size() >= json_ext.size() &&
+		fname.compare(fname.size() - json_ext.size(), json_ext.size(), json_ext) == 0)
+	{
+		DumpJSON(fname);
+		return;
+	}
+
+	TrajectoryWriter writer;
+	if (writer.Open(fname, params))
+	{
+		std::vector<WalkerState> lineage = states.Unroll();
+		for (int i = 0; i < (int)lineage.size(); i++)
+		{
+			writer.Write(lineage[i]);
+		}
+		writer.Close();
+	}
+}
+
+// JSON export, one object per state
+void Walker::DumpJSON(const std::string& fname)
+{
 	std::ofstream outfile;
 	outfile.open(fname);
 	if (outfile)
 	{
 		json array = json::array();
-		for (int i = 0; i < (int)states.size(); i++) 
+		std::vector<WalkerState> lineage = states.Unroll();
+		for (int i = 0; i < (int)lineage.size(); i++) 
 		{
-			array.push_back(states[i].Serialize());
+			array.push_back(lineage[i].Serialize());
 		}
 
 		outfile << array << std::endl;
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <vector>
+#include "walker.h"
+
+LineageNode::LineageNode(const WalkerState& s,
+							std::shared_ptr<const LineageNode> p)
+	: state(s), parent(p)
+{
+	id = 0;
+}
+
+// a lineage is as long as the run, and letting shared_ptr free a chain node by
+// node recursively overflows the stack after enough generations; unlink the
+// ancestors only this node was keeping alive one at a time instead
+LineageNode::~LineageNode()
+{
+	std::shared_ptr<const LineageNode> p = std::move(parent);
+	while (p && p.use_count() == 1)
+	{
+		std::shared_ptr<const LineageNode> next = std::move(p->parent);
+		p.reset();
+		p = std::move(next);
+	}
+}
+
+WalkerLineage::WalkerLineage()
+{
+}
+
+WalkerLineage::WalkerLineage(const std::vector<WalkerState>& image)
+{
+	for (const WalkerState& s : image)
+	{
+		push_back(s);
+	}
+}
+
+void WalkerLineage::push_back(const WalkerState& s)
+{
+	tip = std::make_shared<const LineageNode>(s, tip);
+}
+
+void WalkerLineage::pop_back()
+{
+	if (tip)
+	{
+		tip = tip->parent;
+	}
+}
+
+const WalkerState& WalkerLineage::back() const
+{
+	return tip->state;
+}
+
+// counted rather than kept in the nodes, since Truncate() cuts lineages that
+// share a node all at once
+size_t WalkerLineage::size() const
+{
+	size_t n = 0;
+	for (const LineageNode* node = tip.get(); node; node = node->parent.get())
+	{
+		n++;
+	}
+	return n;
+}
+
+bool WalkerLineage::empty() const
+{
+	return !tip;
+}
+
+void WalkerLineage::clear()
+{
+	tip.reset();
+}
+
+std::vector<WalkerState> WalkerLineage::Unroll() const
+{
+	std::vector<WalkerState> unrolled;
+	for (const LineageNode* node = tip.get(); node; node = node->parent.get())
+	{
+		unrolled.push_back(node->state);
+	}
+	std::reverse(unrolled.begin(), unrolled.end());
+	return unrolled;
+}
+
+const LineageNode* WalkerLineage::Tip() const
+{
+	return tip.get();
+}
+
+// note that nodes are shared, so this truncates every lineage running through
+// the cut
+void WalkerLineage::Truncate(size_t keep)
+{
+	const LineageNode* node = tip.get();
+	for (size_t i = 1; node && i < keep; i++)
+	{
+		node = node->parent.get();
+	}
+	if (node && keep > 0)
+	{
+		node->parent.reset();
+	}
+}
@@ -0,0 +1,100 @@
+#include "walker.h"
+#include "walker_world.h"
+#include "walker_pool.h"
+
+WalkerPool::WalkerPool(int num_walkers, int shard_size)
+{
+	this->shard_size = shard_size;
+
+	for (int b = 0; b < 2; b++)
+	{
+		slots[b].assign(num_walkers, nullptr);
+
+		// walker i lives in shard i / shard_size; shards are created by the
+		// thread acquiring their first walker, so their memory comes from that
+		// thread's Arena
+		if (shard_size > 0)
+		{
+			shards[b].assign((num_walkers + shard_size - 1) / shard_size, nullptr);
+		}
+	}
+}
+
+WalkerPool::~WalkerPool()
+{
+	for (int b = 0; b < 2; b++)
+	{
+		if (shards[b].empty())
+		{
+			for (Walker* walky : slots[b])
+			{
+				delete walky;
+			}
+		}
+		else
+		{
+			// deleting a shard deletes the walkers living in it
+			for (WalkerWorld* shard : shards[b])
+			{
+				if (shard) delete shard;
+			}
+		}
+	}
+}
+
+Walker* WalkerPool::Acquire(int generation, int i,
+							WalkerLineage image)
+{
+	int b = generation % 2;
+	Walker* &slot = slots[b][i];
+
+	if (slot && !image.empty())
+	{
+		slot->Reset(image);
+		return slot;
+	}
+
+	// only the first two generations should get here; fresh walkers are only
+	// asked for once, so there's nothing to gain from recycling them
+	if (slot)
+	{
+		delete slot;
+	}
+
+	WalkerWorld* shard = nullptr;
+	if (!shards[b].empty())
+	{
+		WalkerWorld* &s = shards[b][i / shard_size];
+		if (!s)
+		{
+			s = new WalkerWorld(shard_size);
+		}
+		shard = s;
+	}
+	if (!image.empty())
+	{
+		slot = shard ? new Walker(image, shard) : new Walker(image);
+	}
+	else
+	{
+		slot = shard ? new Walker(shard) : new Walker();
+	}
+
+	return slot;
+}
+
+std::vector<WalkerWorld*>& WalkerPool::Shards(int generation)
+{
+	return shards[generation % 2];
+}
+
+WalkerWorld* WalkerPool::Shard(int generation, int i)
+{
+	std::vector<WalkerWorld*>& s = shards[generation % 2];
+	return s.empty() ? nullptr : s[i / shard_size];
+}
+
+int WalkerPool::Chunk()
+{
+	return shard_size > 0 ? shard_size : 1;
+}
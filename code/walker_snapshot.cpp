@@ -0,0 +1,120 @@
+#include "box2d/box2d.h"
+#include "nlohmann/json.hpp"
+#include "walker.h"
+
+using json = nlohmann::json;
+
+static BodySnapshot capture(b2Body* body, b2Vec2 origin)
+{
+	BodySnapshot snap;
+	snap.position = body->GetPosition() - origin;
+	snap.angle = body->GetAngle();
+	snap.linearVelocity = body->GetLinearVelocity();
+	snap.angularVelocity = body->GetAngularVelocity();
+	return snap;
+}
+
+// note that putting a body to sleep zeroes its velocities, and setting a
+// non-zero velocity wakes it up, so the order here matters
+static void restore(b2Body* body, const BodySnapshot& snap, b2Vec2 origin,
+					bool awake)
+{
+	body->SetTransform(origin + snap.position, snap.angle);
+	body->SetAwake(awake);
+	body->SetLinearVelocity(snap.linearVelocity);
+	body->SetAngularVelocity(snap.angularVelocity);
+}
+
+static json serialize(const BodySnapshot& snap)
+{
+	return {
+		{ "position", { { "x", snap.position.x }, { "y", snap.position.y } } },
+		{ "angle", snap.angle },
+		{ "linearVelocity", {	{ "x", snap.linearVelocity.x },
+								{ "y", snap.linearVelocity.y } } },
+		{ "angularVelocity", snap.angularVelocity }
+	};
+}
+
+static BodySnapshot deserialize(json serial)
+{
+	BodySnapshot snap;
+	snap.position.x = serial["position"]["x"];
+	snap.position.y = serial["position"]["y"];
+	snap.angle = serial["angle"];
+	snap.linearVelocity.x = serial["linearVelocity"]["x"];
+	snap.linearVelocity.y = serial["linearVelocity"]["y"];
+	snap.angularVelocity = serial["angularVelocity"];
+	return snap;
+}
+
+WalkerSnapshot::WalkerSnapshot()
+{
+	BodySnapshot rest = { b2Vec2(0.0f, 0.0f), 0.0f, b2Vec2(0.0f, 0.0f), 0.0f };
+	head = rest;
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		legs[i] = rest;
+		mspeeds[i] = 0.0f;
+	}
+	max_torque = MAX_MOTOR_TORQUE;
+	awake = true;
+}
+
+// WalkerSnapshot of an existing Walker
+WalkerSnapshot::WalkerSnapshot(Walker* base)
+{
+	head = capture(base->head, base->origin);
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		legs[i] = capture(base->legs[i], base->origin);
+		mspeeds[i] = base->joints[i]->GetMotorSpeed();
+	}
+	max_torque = base->joints[0]->GetMaxMotorTorque();
+	awake = base->head->IsAwake();
+}
+
+// JSON --> WalkerSnapshot
+WalkerSnapshot::WalkerSnapshot(json serial)
+{
+	head = deserialize(serial["head"]);
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		legs[i] = deserialize(serial["legs"].at(i));
+		mspeeds[i] = serial["mspeeds"][i];
+	}
+	max_torque = serial["max_torque"];
+	awake = serial["awake"];
+}
+
+// put target's bodies and motors in this snapshot's state; target's bodies
+// must already exist (see Walker::Build())
+void WalkerSnapshot::Restore(Walker* target) const
+{
+	restore(target->head, head, target->origin, awake);
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		restore(target->legs[i], legs[i], target->origin, awake);
+		target->joints[i]->SetMaxMotorTorque(max_torque);
+		target->joints[i]->SetMotorSpeed(mspeeds[i]);
+		target->mspeeds[i] = mspeeds[i];
+	}
+}
+
+// WalkerSnapshot --> JSON
+json WalkerSnapshot::Serialize()
+{
+	json ser = json({});
+	ser["head"] = serialize(head);
+	ser["legs"] = json::array();
+	ser["mspeeds"] = json::array();
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		ser["legs"].push_back(serialize(legs[i]));
+		ser["mspeeds"].push_back(mspeeds[i]);
+	}
+	ser["max_torque"] = max_torque;
+	ser["awake"] = awake;
+
+	return ser;
+}
@@ -1,13 +1,39 @@
+#include <cmath>
 #include <iostream>
 #include "nlohmann/json.hpp"
 #include "box2d/box2d.h"
 #include "walker.h"
 
-#define ABS(x) x < 0 ? (-1*x) : x
-#define PCTDIFF(x, y) (100 * (ABS(x-y))) / ((x+y)/2)
-
 using json = nlohmann::json;
 
+// states recorded before snapshots existed get one derived from their other
+// fields, the way Walkers used to be rebuilt from them
+static WalkerSnapshot derive_snapshot(WalkerState& state)
+{
+	WalkerSnapshot snap;
+	snap.head.position = state.headWorldCenter;
+	snap.head.angle = state.headAngle;
+
+	// note that joint speeds are measured (bodyB ang. vel.) - (bodyA ang. vel.)
+	// [ASSUME] the ang. vel. of the head and all linear velocities are 0
+	float angVelocities[N_LEG_PARAMS];
+	angVelocities[0] = state.jspeeds[0];
+	angVelocities[1] = state.jspeeds[1];
+	angVelocities[2] = angVelocities[0] + state.jspeeds[2];
+	angVelocities[3] = angVelocities[1] + state.jspeeds[3];
+
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		snap.legs[i].position = state.legsWorldCenter[i];
+		snap.legs[i].angle = state.legsAngle[i];
+		snap.legs[i].angularVelocity = angVelocities[i];
+		snap.mspeeds[i] = state.mspeeds[i];
+	}
+	snap.max_torque = state.wp.max_torque;
+
+	return snap;
+}
+
 WalkerState::WalkerState()
 {
 	wp = defaultParameters;
@@ -28,17 +54,18 @@ WalkerState::WalkerState()
 WalkerState::WalkerState(Walker *base)
 {
 	wp = base->params;
-	headWorldCenter = base->head->GetWorldCenter();
+	headWorldCenter = base->head->GetWorldCenter() - base->origin;
 	headAngle = base->head->GetAngle();
 
 	for (int i = 0; i < N_LEG_PARAMS; i++)
 	{
-		legsWorldCenter[i] = base->legs[i]->GetWorldCenter();
+		legsWorldCenter[i] = base->legs[i]->GetWorldCenter() - base->origin;
 		legsAngle[i] = base->legs[i]->GetAngle();
 		mspeeds[i] = base->joints[i]->GetMotorSpeed();
 		jspeeds[i] = base->joints[i]->GetJointSpeed();
 		jangles[i] = base->joints[i]->GetJointAngle();
 	}
+	snapshot = WalkerSnapshot(base);
 
 	// [TODO]
 	state_index = 0;
@@ -68,6 +95,15 @@ WalkerState::WalkerState(json serial)
 		jangles[i] = serial["jangles"][i];
 	}
 
+	if (serial.find("snapshot") != serial.end())
+	{
+		snapshot = WalkerSnapshot(serial["snapshot"]);
+	}
+	else
+	{
+		snapshot = derive_snapshot(*this);
+	}
+
 	// [TODO]
 	state_index = 0;
 }
@@ -97,33 +133,35 @@ json WalkerState::Serialize()
 		ser["jspeeds"].push_back(jspeeds[i]);
 		ser["jangles"].push_back(jangles[i]);
 	}
+	ser["snapshot"] = snapshot.Serialize();
 
 	return ser;
 }
 
-// return a WalkerState containing the % differences between the two states
-// [TODO] this isn't commutative??
-WalkerState WalkerState::Diff(WalkerState cmp)
+// return a WalkerState containing the absolute differences between the two
+// states, field by field; |x - y| is exactly |y - x|, so a.Diff(b) and
+// b.Diff(a) are the same (percentages weren't, and blew up around 0)
+WalkerState WalkerState::Diff(const WalkerState& cmp) const
 {
 	// struct members wp and state_index are left at WalkerState
 	// default values
 	WalkerState diff;
 
 	diff.headWorldCenter = b2Vec2(
-							PCTDIFF(headWorldCenter.x, cmp.headWorldCenter.x),
-							PCTDIFF(headWorldCenter.y, cmp.headWorldCenter.y));
-	diff.headAngle = PCTDIFF(headAngle, cmp.headAngle);
+							std::fabs(headWorldCenter.x - cmp.headWorldCenter.x),
+							std::fabs(headWorldCenter.y - cmp.headWorldCenter.y));
+	diff.headAngle = std::fabs(headAngle - cmp.headAngle);
 	for (int i = 0; i < N_LEG_PARAMS; i++) 
 	{
 		diff.legsWorldCenter[i] = b2Vec2(
-									PCTDIFF(legsWorldCenter[i].x,
-											cmp.legsWorldCenter[i].x),
-									PCTDIFF(legsWorldCenter[i].y,
-											cmp.legsWorldCenter[i].y));
-		diff.legsAngle[i] = PCTDIFF(legsAngle[i], cmp.legsAngle[i]);
-		diff.mspeeds[i] = PCTDIFF(mspeeds[i], cmp.mspeeds[i]);
-		diff.jspeeds[i] = PCTDIFF(jspeeds[i], cmp.jspeeds[i]);
-		diff.jangles[i] = PCTDIFF(jangles[i], cmp.jangles[i]);
+									std::fabs(legsWorldCenter[i].x -
+												cmp.legsWorldCenter[i].x),
+									std::fabs(legsWorldCenter[i].y -
+												cmp.legsWorldCenter[i].y));
+		diff.legsAngle[i] = std::fabs(legsAngle[i] - cmp.legsAngle[i]);
+		diff.mspeeds[i] = std::fabs(mspeeds[i] - cmp.mspeeds[i]);
+		diff.jspeeds[i] = std::fabs(jspeeds[i] - cmp.jspeeds[i]);
+		diff.jangles[i] = std::fabs(jangles[i] - cmp.jangles[i]);
 	}
 
 	return diff;
@@ -0,0 +1,190 @@
+#include <iostream>
+#include "box2d/box2d.h"
+#include "walker.h"
+#include "walker_world.h"
+#include "arena.h"
+#include "termination.h"
+#include "config.h"
+
+// b2Filter::groupIndex is an int16, and each lane uses its own positive group
+#define MAX_SHARD_SIZE 32767
+
+LaneContactFilter lane_contact_filter;
+
+bool LaneContactFilter::ShouldCollide(b2Fixture* a, b2Fixture* b)
+{
+	uintptr_t lane_a = a->GetUserData().pointer;
+	uintptr_t lane_b = b->GetUserData().pointer;
+	if (lane_a && lane_b && lane_a != lane_b) return false;
+
+	return b2ContactFilter::ShouldCollide(a, b);
+}
+
+WalkerWorld::WalkerWorld(int capacity)
+{
+	if (capacity > MAX_SHARD_SIZE)
+	{
+		std::cout 	<< "[walker_world.cpp] shard size " << capacity
+					<< " is too large, using " << MAX_SHARD_SIZE << std::endl;
+		capacity = MAX_SHARD_SIZE;
+	}
+	lanes.assign(capacity, nullptr);
+
+	world = arena_new<b2World>(b2Vec2(0.0f, config.gravity));
+	world->SetContactListener(&head_contact_listener);
+	world->SetContactFilter(&lane_contact_filter);
+
+	// one static ground body with one fixture per lane
+	b2BodyDef groundBodyDef;
+	groundBodyDef.position.Set(0.0f, 0.0f);
+	groundBody = world->CreateBody(&groundBodyDef);
+	for (int i = 0; i < capacity; i++)
+	{
+		b2Vec2 o = LaneOrigin(i);
+		b2PolygonShape groundShape;
+		groundShape.SetAsBox(GROUND_SIZE_X / 2, GROUND_SIZE_Y / 2,
+								b2Vec2(o.x, o.y + GROUND_Y - GROUND_SIZE_Y / 2),
+								0.0f);
+		b2FixtureDef groundFixDef;
+		groundFixDef.shape = &groundShape;
+		groundFixDef.density = 0.0f;
+		groundFixDef.filter.categoryBits = GROUND_CATEGORY;
+		groundFixDef.userData.pointer = i + 1;
+		groundBody->CreateFixture(&groundFixDef);
+	}
+}
+
+WalkerWorld::~WalkerWorld()
+{
+	// the whole world is about to go, so there's no need for the remaining
+	// Walkers to destroy their bodies one at a time
+	for (int i = 0; i < (int)lanes.size(); i++)
+	{
+		if (lanes[i])
+		{
+			lanes[i]->shard = nullptr;
+			lanes[i]->world = nullptr;
+			delete lanes[i];
+		}
+	}
+
+	arena_delete(world);
+}
+
+// reserve the first free lane for w; returns -1 if the shard is full
+int WalkerWorld::Claim(Walker* w)
+{
+	for (int i = 0; i < (int)lanes.size(); i++)
+	{
+		if (!lanes[i])
+		{
+			lanes[i] = w;
+			return i;
+		}
+	}
+
+	std::cout << "[walker_world.cpp] no free lane left in shard" << std::endl;
+	return -1;
+}
+
+// destroy w's bodies (and with them its joints) and free its lane
+void WalkerWorld::Release(Walker* w)
+{
+	world->DestroyBody(w->head);
+	for (int i = 0; i < N_LEG_PARAMS; i++)
+	{
+		world->DestroyBody(w->legs[i]);
+	}
+
+	if (w->lane >= 0 && lanes[w->lane] == w)
+	{
+		lanes[w->lane] = nullptr;
+	}
+}
+
+// lanes are centered around y = 0 to keep coordinates (and float error) small;
+// still, the outermost ones are WORLD_LANE_SPACING * size / 2 away (640 m for
+// WORLD_SHARD_SIZE), where floats are ~6e-5 m apart rather than ~5e-7 m at a
+// walker's height in a world of its own, so a walker's rounding depends on
+// its lane: shards are reproducible, but don't simulate bitwise like walkers
+// with worlds of their own (shard_size 0)
+b2Vec2 WalkerWorld::LaneOrigin(int lane)
+{
+	int center = lanes.size() / 2;
+	return b2Vec2(0.0f, (lane - center) * WORLD_LANE_SPACING);
+}
+
+int WalkerWorld::Size()
+{
+	int n = 0;
+	for (int i = 0; i < (int)lanes.size(); i++)
+	{
+		if (lanes[i]) n++;
+	}
+	return n;
+}
+
+int WalkerWorld::Running()
+{
+	int n = 0;
+	for (int i = 0; i < (int)lanes.size(); i++)
+	{
+		if (lanes[i] && !lanes[i]->terminated) n++;
+	}
+	return n;
+}
+
+// terminate the Walkers whose predicates in Mask fired in the last step;
+// returns the number of Walkers still running
+template <int Mask>
+int WalkerWorld::Terminate()
+{
+	int running = 0;
+	for (int i = 0; i < (int)lanes.size(); i++)
+	{
+		Walker* w = lanes[i];
+		if (!w || w->terminated) continue;
+
+		if (w->CheckTermination<Mask>())
+		{
+			w->Terminate();
+		}
+		else
+		{
+			running++;
+		}
+	}
+	return running;
+}
+
+// step until the iteration is over or every Walker has been terminated
+template <int Mask>
+void WalkerWorld::SimulateSteps()
+{
+	int steps = config.TimeSteps();
+	float dt = config.TimeStep();
+	ArenaBypass step_allocations;
+	int running = Running();
+	for (int i = 0; i < steps && running > 0; i++)
+	{
+		world->Step(dt, config.velocity_iterations, config.position_iterations);
+
+		if (Mask) running = Terminate<Mask>();
+	}
+}
+
+void WalkerWorld::Simulate()
+{
+	// run simulation; Walkers drop out as termination predicates fire, and the
+	// shard stops early once none are left (Walkers that adopt cached results
+	// are never stepped at all)
+	typedef void (WalkerWorld::*Steps)();
+	static const Steps steps[] = TERMINATION_TABLE(WalkerWorld::SimulateSteps);
+	(this->*steps[config.termination & TERMINATE_ALL])();
+
+	// record states
+	for (int i = 0; i < (int)lanes.size(); i++)
+	{
+		if (lanes[i] && !lanes[i]->adopted) lanes[i]->Record();
+	}
+}
@@ -23,6 +23,32 @@ src='
 	src/walker.cpp
 	src/walker_state.cpp
 	src/walker_parameters.cpp
+	src/walker_world.cpp
+	src/walker_pool.cpp
+	src/arena.cpp
+	src/walker_lineage.cpp
+	src/walker_snapshot.cpp
+	src/rng.cpp
+	src/genome.cpp
+	src/selection.cpp
+	src/scheduler.cpp
+	src/termination.cpp
+	src/eval_cache.cpp
+	src/trajectory_file.cpp
+	src/trajectory_stream.cpp
+	src/trajectory_codec.cpp
+	src/bench_codec.cpp
+	src/checkpoint.cpp
+	src/config.cpp
+	src/config_io.cpp
+	src/ga.cpp
+	src/trace.cpp
+	src/island.cpp
+	src/remote.cpp
+	src/batch_world.cpp
+	src/bench.cpp
+	src/verify.cpp
+	src/render_frames.cpp
 	src/render
 	src/CMakeLists.txt
 	src/trajectory.cpp
@@ -31,6 +57,26 @@ src='
 include='
 	src/include/statics.h
 	src/include/walker.h
+	src/include/walker_world.h
+	src/include/walker_pool.h
+	src/include/arena.h
+	src/include/b2_user_settings.h
+	src/include/rng.h
+	src/include/genome.h
+	src/include/selection.h
+	src/include/scheduler.h
+	src/include/termination.h
+	src/include/eval_cache.h
+	src/include/trajectory_file.h
+	src/include/trajectory_stream.h
+	src/include/trajectory_codec.h
+	src/include/checkpoint.h
+	src/include/config.h
+	src/include/ga.h
+	src/include/trace.h
+	src/include/island.h
+	src/include/remote.h
+	src/include/batch_world.h
 '
 
 clean() {